@@ -1,4 +1,12 @@
 #include "Accelerator.h"
+#include "BVH.h"
+#include "Grid.h"
+#include "KdTree.h"
+#include "LazyBVH.h"
+#include "WideBVH.h"
+#include "../Intersections/Intersection.h"
+#include "../Rays/Ray.h"
+#include "../Rays/RayPacket.h"
 
 Accelerator::Accelerator()
 {
@@ -9,3 +17,57 @@ Accelerator::~Accelerator()
 {
 
 }
+
+Accelerator *Accelerator::make(AcceleratorType type, const std::vector<Shape*> &shapes)
+{
+	switch (type)
+	{
+	case AcceleratorType::WideBVH:
+		return new WideBVH(shapes);
+	case AcceleratorType::Grid:
+		return new Grid(shapes);
+	case AcceleratorType::KdTree:
+		return new KdTree(shapes);
+	case AcceleratorType::LazyBVH:
+		return new LazyBVH(shapes);
+	default:
+		return new BVH(shapes);
+	}
+}
+
+std::string Accelerator::getTypeName(AcceleratorType type)
+{
+	switch (type)
+	{
+	case AcceleratorType::WideBVH:
+		return "wide BVH";
+	case AcceleratorType::Grid:
+		return "grid";
+	case AcceleratorType::KdTree:
+		return "kd-tree";
+	case AcceleratorType::LazyBVH:
+		return "lazy BVH";
+	default:
+		return "binary BVH";
+	}
+}
+
+void Accelerator::nearestHits(const RayPacket &packet, Intersection *intersections) const
+{
+	for (int i = 0; i < packet.getSize(); i++)
+	{
+		intersections[i] = this->nearestHit(packet.getRay(i));
+	}
+}
+
+bool Accelerator::refit(const std::vector<const Shape*> &movedShapes)
+{
+	(void)movedShapes;
+	return false;
+}
+
+bool Accelerator::optimize(double seconds)
+{
+	(void)seconds;
+	return false;
+}
\ No newline at end of file
@@ -1,13 +1,47 @@
 #ifndef ACCELERATOR_H
 #define ACCELERATOR_H
 
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The kinds of accelerator a world can build its shapes into.
+enum class AcceleratorType { BinaryBVH, WideBVH, Grid, KdTree, LazyBVH };
+
 class Accelerator
 {
 public:
 	Accelerator();
 	virtual ~Accelerator();
 
+	// Builds a new accelerator of the given type over the shapes.
+	static Accelerator *make(AcceleratorType type, const std::vector<class Shape*> &shapes);
+	static std::string getTypeName(AcceleratorType type);
+
+	// Finds the nearest hit within the ray's T interval, skipping any part of the
+	// accelerator the interval doesn't reach.
 	virtual class Intersection nearestHit(const class Ray &ray) const = 0;
+
+	// Finds the nearest hit of each ray in the packet, writing one intersection per
+	// ray. By default, the rays are traced one at a time.
+	virtual void nearestHits(const class RayPacket &packet,
+		class Intersection *intersections) const;
+
+	// Returns whether the ray hits any shape closer than its max T. It stops at the
+	// first hit it finds, so it's cheaper than "nearestHit" for shadow rays.
+	virtual bool occluded(const class Ray &ray) const = 0;
+
+	// Updates the accelerator for shapes that were moved since it was built. Returns
+	// false if it can't be updated in place and should be rebuilt instead.
+	virtual bool refit(const std::vector<const class Shape*> &movedShapes);
+
+	// Spends up to the given time improving the parts of the accelerator that refits
+	// have made worse. Returns whether anything changed. By default there's nothing
+	// to improve.
+	virtual bool optimize(double seconds);
+
+	// The bytes used by the accelerator's own nodes and shape lists.
+	virtual size_t getMemoryUsage() const = 0;
 };
 
 #endif
\ No newline at end of file
@@ -1,12 +1,34 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <omp.h>
+#include <xmmintrin.h>
+
 #include "BVH.h"
 #include "BVHBuildEntry.h"
+#include "BVHBuildTask.h"
 #include "BVHFlatNode.h"
+#include "BVHNodeLayout.h"
+#include "BVHRay.h"
+#include "BVHSplit.h"
 #include "BVHTraversal.h"
+#include "LinearBVHBuilder.h"
+#include "SplitBVHBuilder.h"
 #include "../Intersections/Intersection.h"
 #include "../Rays/Ray.h"
+#include "../Rays/RayPacket.h"
 #include "../Shapes/Shape.h"
 
-BVH::BVH(const std::vector<Shape*> &shapes)
+const BVHBuildMethod BVH::DEFAULT_BUILD_METHOD = BVHBuildMethod::Midpoint;
+const double BVH::SAH_TRAVERSAL_COST = 1.0;
+const double BVH::SAH_INTERSECTION_COST = 1.0;
+const double BVH::MAX_REFIT_COST_RATIO = 1.5;
+const double BVH::MIN_ROTATION_GAIN = 0.01;
+
+BVH::BVH(const std::vector<Shape*> &shapes, BVHBuildMethod buildMethod, int binCount,
+	int threadCount)
 	: Accelerator()
 {
 	int shapeCount = static_cast<int>(shapes.size());
@@ -16,254 +38,1556 @@ BVH::BVH(const std::vector<Shape*> &shapes)
 		this->shapePtrs[i] = const_cast<const Shape**>(&shapes[i]);
 	}
 
-	this->flatTree = std::vector<BVHFlatNode>(shapePtrs.size() * 2);
+	this->flatTree = BVHFlatNodeArray();
 
+	this->buildMethod = buildMethod;
+	// Copied, since "std::min" takes references, which in-class constants don't have.
+	const int maxBinCount = BVH::MAX_BIN_COUNT;
+	this->binCount = std::max(2, std::min(binCount, maxBinCount));
+	this->threadCount = std::max(threadCount, 1);
 	this->numNodes = 0;
 	this->numLeaves = 0;
 	this->leafCapacity = BVH::DEFAULT_LEAF_CAPACITY;
+	this->weightedArea = 0.0;
+	this->builtCost = 0.0;
+	this->hasRefitData = false;
+	this->sampledRays = 0;
+	this->sampledNodeVisits = 0;
+	this->sampledPrimitiveTests = 0;
+	this->peakBuildMemory = 0;
 
-	std::vector<BVHBuildEntry> workArray =
-		std::vector<BVHBuildEntry>(BVH::MAX_BVH_BUILD_TO_DO);
+	// An empty world has nothing to subdivide.
+	if (shapeCount == 0)
+	{
+		return;
+	}
 
-	// Put the root shape into the bounding volume hierarchy.
-	workArray[0] = BVHBuildEntry(BVH::ROOT_START_INDEX, shapeCount, BVH::ROOT_PARENT_INDEX);
+	// Small scenes aren't worth the overhead of spreading out over several threads.
+	// Spatial splits are only built on the calling thread, and linear builds have
+	// their own parallel steps.
+	if (this->buildMethod == BVHBuildMethod::SpatialSAH)
+	{
+		this->buildSpatial(shapes);
+	}
+	else if (this->buildMethod == BVHBuildMethod::Linear)
+	{
+		this->buildLinear(shapes);
+	}
+	else if ((this->threadCount > 1) && (shapeCount >= BVH::PARALLEL_BUILD_THRESHOLD))
+	{
+		this->buildParallel();
+	}
+	else
+	{
+		this->buildSerial();
+	}
 
-	// The build node index of the flat tree. Identical to the C "build_nodes_index".
-	// Instead of using a pointer to the flat tree, just index the flat tree itself.
-	int flatTreeIndex = 0;
+	// The layout makes a second copy of the tree, with one padding node, while the
+	// first is still alive.
+	this->notePeakBuildMemory((this->flatTree.size() * 2 + 1) * sizeof(BVHFlatNode));
+	this->flatTree = BVHNodeLayout::clusterTreelets(this->flatTree);
+	this->numNodes = static_cast<int>(this->flatTree.size());
+	this->orderShapesByLeaf();
+	this->copyPrimitives();
+	this->notePeakBuildMemory(this->getMemoryUsage());
+}
 
-	BVHFlatNode flatNode = BVHFlatNode();
+BVH::BVH(const std::vector<Shape*> &shapes)
+	: BVH(shapes, BVH::DEFAULT_BUILD_METHOD, BVH::DEFAULT_BIN_COUNT,
+	omp_get_max_threads()) { }
 
-	int stackIndex = 1;
-	while (stackIndex > 0)
+BVH::BVH(const std::vector<Shape*> &shapes, const BVHFlatNode *nodes, int nodeCount,
+	const uint *shapeOrder, int numLeaves)
+	: Accelerator()
+{
+	int shapeCount = static_cast<int>(shapes.size());
+	this->shapePtrs = std::vector<const Shape**>(shapeCount);
+	for (int i = 0; i < shapeCount; i++)
 	{
-		stackIndex--;
-		const BVHBuildEntry &buildNode = workArray[stackIndex];
+		this->shapePtrs[i] = const_cast<const Shape**>(&shapes[shapeOrder[i]]);
+	}
 
-		this->numNodes++;
+	// One copy of the whole tree, with no per-node work.
+	this->flatTree = BVHFlatNodeArray(nodes, nodes + nodeCount);
 
-		flatNode.setStartIndex(buildNode.getStartIndex());
-		flatNode.setNumPrimitives(buildNode.getEndIndex() - buildNode.getStartIndex());
-		flatNode.setRightOffset(BVH::UNTOUCHED);
+	this->buildMethod = BVH::DEFAULT_BUILD_METHOD;
+	this->binCount = BVH::DEFAULT_BIN_COUNT;
+	this->threadCount = omp_get_max_threads();
+	this->numNodes = nodeCount;
+	this->numLeaves = numLeaves;
+	this->leafCapacity = BVH::DEFAULT_LEAF_CAPACITY;
+	this->weightedArea = 0.0;
+	this->builtCost = 0.0;
+	this->hasRefitData = false;
+	this->sampledRays = 0;
+	this->sampledNodeVisits = 0;
+	this->sampledPrimitiveTests = 0;
+	this->peakBuildMemory = 0;
+	this->copyPrimitives();
+}
 
-		// Calculate the bounding box for this flat node.
-		BoundingBox nodeBox = (*this->shapePtrs[buildNode.getStartIndex()])->getBoundingBox();
-		BoundingBox nodeCentroidBox = BoundingBox(
-			(*this->shapePtrs[buildNode.getStartIndex()])->getCentroid(),
-			(*this->shapePtrs[buildNode.getStartIndex()])->getCentroid());
+void BVH::computeBounds(int start, int end, bool parallel, BoundingBox *nodeBox,
+	BoundingBox *centroidBox) const
+{
+	if (!parallel)
+	{
+		*nodeBox = BoundingBox();
+		*centroidBox = BoundingBox();
 
-		// Expand the current build node's box to surround all relevant children.
-		for (int i = (buildNode.getStartIndex() + 1); i < buildNode.getEndIndex(); i++)
+		// Expand the boxes to surround all shapes in the range.
+		for (int i = start; i < end; i++)
 		{
 			const Shape &selectedShape = *(*this->shapePtrs[i]);
-			BoundingBox selectedShapeBox = selectedShape.getBoundingBox();
-			nodeBox.expandToInclude(selectedShapeBox);
-			nodeCentroidBox.expandToInclude(selectedShape.getCentroid());
+			nodeBox->expandToInclude(selectedShape.getBoundingBox());
+			centroidBox->expandToInclude(selectedShape.getCentroid());
 		}
 
-		// Assign the newly expanded bounding box to the selected flat node.
-		flatNode.setBoundingBox(nodeBox);
+		return;
+	}
+
+	// Each thread bounds one contiguous chunk, and the chunks are merged afterwards.
+	const int chunkCount = this->threadCount;
+	const int chunkSize = ((end - start) + chunkCount - 1) / chunkCount;
+	std::vector<BoundingBox> chunkBoxes = std::vector<BoundingBox>(chunkCount);
+	std::vector<BoundingBox> chunkCentroidBoxes = std::vector<BoundingBox>(chunkCount);
+
+#pragma omp parallel for num_threads(this->threadCount)
+	for (int chunk = 0; chunk < chunkCount; chunk++)
+	{
+		int chunkStart = std::min(start + (chunk * chunkSize), end);
+		int chunkEnd = std::min(chunkStart + chunkSize, end);
+		this->computeBounds(chunkStart, chunkEnd, false, &chunkBoxes[chunk],
+			&chunkCentroidBoxes[chunk]);
+	}
+
+	*nodeBox = BoundingBox();
+	*centroidBox = BoundingBox();
+	for (int chunk = 0; chunk < chunkCount; chunk++)
+	{
+		nodeBox->expandToInclude(chunkBoxes[chunk]);
+		centroidBox->expandToInclude(chunkCentroidBoxes[chunk]);
+	}
+}
+
+void BVH::binShapes(int start, int end, const double *axisMins, const double *binScales,
+	int *binCounts, BoundingBox *binBoxes) const
+{
+	// Drop each shape into the bin containing its centroid, on all three axes at once.
+	for (int i = start; i < end; i++)
+	{
+		const Shape &shape = *(*this->shapePtrs[i]);
+		const Vector3 &centroid = shape.getCentroid();
+		const BoundingBox shapeBox = shape.getBoundingBox();
 
-		// If the number of shapes in this node is less than or equal to the "leaf capacity",
-		// then this node will become a leaf. This is signified by its right offset of zero.
-		if (flatNode.getNumPrimitives() <= this->leafCapacity)
+		for (int axis = 0; axis < 3; axis++)
 		{
-			flatNode.setRightOffset(BVH::LEAF_NODE_RIGHT_OFFSET);
-			this->numLeaves++;
+			int bin = BVHSplit::binIndex(centroid.getComponent(static_cast<Axis>(axis)),
+				axisMins[axis], binScales[axis], this->binCount);
+			int binIndex = (axis * this->binCount) + bin;
+			binCounts[binIndex]++;
+			binBoxes[binIndex].expandToInclude(shapeBox);
 		}
+	}
+}
 
-		// Add the flat node to the flat tree.
-		this->flatTree[flatTreeIndex] = flatNode;
-		flatTreeIndex++;
+BVHSplit BVH::chooseSplit(int start, int end, const BoundingBox &nodeBox,
+	const BoundingBox &centroidBox, bool parallel) const
+{
+	return (this->buildMethod == BVHBuildMethod::BinnedSAH) ?
+		this->chooseBinnedSAHSplit(start, end, nodeBox, centroidBox, parallel) :
+		this->chooseMidpointSplit(start, end, centroidBox);
+}
+
+BVHSplit BVH::chooseMidpointSplit(int start, int end, const BoundingBox &centroidBox) const
+{
+	// If the number of shapes in this node is less than or equal to the "leaf capacity",
+	// then this node will become a leaf.
+	if ((end - start) <= this->leafCapacity)
+	{
+		return BVHSplit::leaf();
+	}
+
+	// Otherwise, split at the middle of the longest axis, which is the same as
+	// putting the centroids into two bins.
+	Axis splitAxis = centroidBox.getLongestAxis();
+	double axisMin = centroidBox.getMin().getComponent(splitAxis);
+	double axisExtent = centroidBox.getExtent().getComponent(splitAxis);
+
+	// If a bad split would occur, then choose the center index.
+	if (axisExtent <= 0.0)
+	{
+		return BVHSplit::median();
+	}
+
+	return BVHSplit(splitAxis, axisMin, 2.0 / axisExtent, 2, 0);
+}
+
+BVHSplit BVH::chooseBinnedSAHSplit(int start, int end, const BoundingBox &nodeBox,
+	const BoundingBox &centroidBox, bool parallel) const
+{
+	// Splitting nodes as small as a midpoint leaf saves a few shape tests, but costs
+	// more node visits than that on the built-in worlds.
+	const int count = end - start;
+	if (count <= this->leafCapacity)
+	{
+		return BVHSplit::leaf();
+	}
+
+	double axisMins[3];
+	double binScales[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// An axis where every centroid lies on the same plane puts them all in one bin.
+		double axisExtent = centroidBox.getExtent().getComponent(static_cast<Axis>(axis));
+		axisMins[axis] = centroidBox.getMin().getComponent(static_cast<Axis>(axis));
+		binScales[axis] = (axisExtent > 0.0) ?
+			(static_cast<double>(this->binCount) / axisExtent) : 0.0;
+	}
+
+	int binCounts[3 * BVH::MAX_BIN_COUNT];
+	BoundingBox binBoxes[3 * BVH::MAX_BIN_COUNT];
+	std::fill(binCounts, binCounts + (3 * this->binCount), 0);
+
+	if (!parallel)
+	{
+		this->binShapes(start, end, axisMins, binScales, binCounts, binBoxes);
+	}
+	else
+	{
+		// Each thread bins one contiguous chunk into its own bins, then they're merged.
+		const int chunkCount = this->threadCount;
+		const int chunkSize = (count + chunkCount - 1) / chunkCount;
+		const int binsPerChunk = 3 * this->binCount;
+		std::vector<int> chunkCounts = std::vector<int>(chunkCount * binsPerChunk, 0);
+		std::vector<BoundingBox> chunkBoxes =
+			std::vector<BoundingBox>(chunkCount * binsPerChunk);
 
-		// If the child node touches a parent node, and the parent node is not the root node,
-		// subtract one from the parent's right offset.
-		if (buildNode.getParentIndex() != BVH::ROOT_PARENT_INDEX)
+#pragma omp parallel for num_threads(this->threadCount)
+		for (int chunk = 0; chunk < chunkCount; chunk++)
 		{
-			this->flatTree[buildNode.getParentIndex()].setRightOffset(
-				this->flatTree[buildNode.getParentIndex()].getRightOffset() - 1);
+			int chunkStart = std::min(start + (chunk * chunkSize), end);
+			int chunkEnd = std::min(chunkStart + chunkSize, end);
+			this->binShapes(chunkStart, chunkEnd, axisMins, binScales,
+				&chunkCounts[chunk * binsPerChunk], &chunkBoxes[chunk * binsPerChunk]);
+		}
 
-			// If this is the second touch, the current node is the right child, and it will
-			// set up the offset for the flattened tree.
-			if (this->flatTree[buildNode.getParentIndex()].getRightOffset() == BVH::TOUCHED_TWICE)
+		for (int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			for (int bin = 0; bin < binsPerChunk; bin++)
 			{
-				this->flatTree[buildNode.getParentIndex()].setRightOffset(
-					this->numNodes - 1 - buildNode.getParentIndex());
+				binCounts[bin] += chunkCounts[(chunk * binsPerChunk) + bin];
+				binBoxes[bin].expandToInclude(chunkBoxes[(chunk * binsPerChunk) + bin]);
 			}
 		}
+	}
 
-		// If the current node is a leaf, it is not subdivided.
-		if (flatNode.getRightOffset() == BVH::LEAF_NODE_RIGHT_OFFSET)
+	// Making a leaf costs one intersection per shape. Any split must beat that.
+	const double leafCost = static_cast<double>(count) * BVH::SAH_INTERSECTION_COST;
+	const double nodeAreaRecip = 1.0 / std::max(nodeBox.getSurfaceArea(), Utility::EPSILON);
+
+	double bestCost = std::numeric_limits<double>::max();
+	int bestAxis = 0;
+	int bestBin = -1;
+
+	BoundingBox rightBoxes[BVH::MAX_BIN_COUNT];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (binScales[axis] <= 0.0)
 		{
 			continue;
 		}
 
-		// Otherwise, set up the split dimensions for partitioning on the longest axis.
-		// Note: the split coordinate calculation depends on Vector3s being made up of
-		// three doubles, in the order "x, y, z".
-		Axis splitAxis = nodeCentroidBox.getLongestAxis();
-		double splitCoordinate = 0.5 *
-			(reinterpret_cast<const double*>(&nodeCentroidBox.getMin())[static_cast<int>(splitAxis)] +
-			reinterpret_cast<const double*>(&nodeCentroidBox.getMax())[static_cast<int>(splitAxis)]);
+		const int *axisCounts = &binCounts[axis * this->binCount];
+		const BoundingBox *axisBoxes = &binBoxes[axis * this->binCount];
 
-		// Partition the array of objects on this particular split.
-		int middle = buildNode.getStartIndex();
-		for (int i = middle; i < buildNode.getEndIndex(); i++)
+		// Sweep from the right to get the box of everything right of each plane.
+		BoundingBox rightBox = BoundingBox();
+		for (int bin = this->binCount - 1; bin > 0; bin--)
 		{
-			// Check the point coordinate of the selected shape with the split coordinate.
-			double shapeSplitCoordinate = reinterpret_cast<const double*>(
-				&(*this->shapePtrs[i])->getCentroid())[static_cast<int>(splitAxis)];
-			if (shapeSplitCoordinate < splitCoordinate)
-			{
-				// Swap the selected shape with the middle shape.
-				const Shape **temp = this->shapePtrs[i];
-				this->shapePtrs[i] = this->shapePtrs[middle];
-				this->shapePtrs[middle] = temp;
-				middle++;
-			}
+			rightBox.expandToInclude(axisBoxes[bin]);
+			rightBoxes[bin] = rightBox;
 		}
 
-		// If a bad split occurs, then choose the center index.
-		if ((middle == buildNode.getStartIndex()) || (middle == buildNode.getEndIndex()))
+		// Then sweep from the left, evaluating the plane after each bin.
+		BoundingBox leftBox = BoundingBox();
+		int leftCount = 0;
+		for (int bin = 0; bin < (this->binCount - 1); bin++)
 		{
-			middle = buildNode.getStartIndex() +
-				((buildNode.getEndIndex() - buildNode.getStartIndex()) / 2);
-		}
+			leftBox.expandToInclude(axisBoxes[bin]);
+			leftCount += axisCounts[bin];
+			int rightCount = count - leftCount;
 
-		// Push the right and left child nodes onto the work stack.
-		int start = buildNode.getStartIndex();
-		int end = buildNode.getEndIndex();
-		workArray[stackIndex] = BVHBuildEntry(middle, end, this->numNodes - 1);
-		stackIndex++;
-		workArray[stackIndex] = BVHBuildEntry(start, middle, this->numNodes - 1);
-		stackIndex++;
+			if ((leftCount == 0) || (rightCount == 0))
+			{
+				continue;
+			}
+
+			double cost = BVH::SAH_TRAVERSAL_COST + (BVH::SAH_INTERSECTION_COST *
+				((leftBox.getSurfaceArea() * static_cast<double>(leftCount)) +
+				(rightBoxes[bin + 1].getSurfaceArea() * static_cast<double>(rightCount))) *
+				nodeAreaRecip);
+
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+			}
+		}
 	}
-}
 
-Intersection BVH::nearestHit(const Ray &ray) const
-{
-	// Intersection data, just like a naive "Ray::closestShape" implementation.
-	double nearestT = Intersection::T_MAX;
-	Vector3 nearestPoint;
-	Vector3 nearestNormal;
-	const Shape *nearestShape = nullptr;
+	// Stop here if splitting doesn't pay for itself, as long as the leaf stays small.
+	if ((bestCost >= leafCost) && (count <= BVH::MAX_SAH_LEAF_SIZE))
+	{
+		return BVHSplit::leaf();
+	}
 
-	// T values for the current pairs of bounding box near/far hits.
-	std::vector<double> boundingBoxHits = std::vector<double>(4);
-	int closerNode;
-	int otherNode;
+	// If no plane could separate the centroids, then choose the center index.
+	if (bestBin < 0)
+	{
+		return BVHSplit::median();
+	}
 
-	// The working set of traversal nodes.
-	std::vector<BVHTraversal> workArray =
-		std::vector<BVHTraversal>(BVH::MAX_BVH_TRAVERSAL_TO_DO);
+	return BVHSplit(static_cast<Axis>(bestAxis), axisMins[bestAxis], binScales[bestAxis],
+		this->binCount, bestBin);
+}
 
-	// Push the root node onto the working set. Be careful that the negative
-	// intersection T max does not underflow.
-	workArray[0] = BVHTraversal(0, -Intersection::T_MAX);
+int BVH::partition(int start, int end, const BVHSplit &split, bool parallel)
+{
+	int middle = start;
 
-	// Begin processing node hits.
-	int stackIndex = 0;
-	while (stackIndex >= 0)
+	if (split.isMedian())
 	{
-		// Pop the next work node off the work array. This node holds the "nodeNumber"
-		// and "nearT" values.
-		BVHTraversal workNode = workArray[stackIndex];
-		stackIndex--;
+		return start + ((end - start) / 2);
+	}
+	else if (!parallel)
+	{
+		// Swap each shape that belongs on the left with the middle shape.
+		for (int i = start; i < end; i++)
+		{
+			if (split.isLeft((*this->shapePtrs[i])->getCentroid()))
+			{
+				std::swap(this->shapePtrs[i], this->shapePtrs[middle]);
+				middle++;
+			}
+		}
+	}
+	else
+	{
+		// Count the left shapes per chunk, so each chunk knows where its left and
+		// right shapes go, then scatter them into a copy and move it back.
+		const int chunkCount = this->threadCount;
+		const int chunkSize = ((end - start) + chunkCount - 1) / chunkCount;
+		std::vector<int> leftCounts = std::vector<int>(chunkCount, 0);
 
-		// Obtain a pointer to the current node in the BVH flat tree.
-		const BVHFlatNode &flatNode = this->flatTree[workNode.getIndex()];
+#pragma omp parallel for num_threads(this->threadCount)
+		for (int chunk = 0; chunk < chunkCount; chunk++)
+		{
+			int chunkStart = std::min(start + (chunk * chunkSize), end);
+			int chunkEnd = std::min(chunkStart + chunkSize, end);
+			for (int i = chunkStart; i < chunkEnd; i++)
+			{
+				leftCounts[chunk] += split.isLeft((*this->shapePtrs[i])->getCentroid()) ? 1 : 0;
+			}
+		}
 
-		// If the current closest intersection is closer than this node, continue.
-		if (nearestT < workNode.getMinT())
+		int totalLeft = 0;
+		for (int chunk = 0; chunk < chunkCount; chunk++)
 		{
-			continue;
+			totalLeft += leftCounts[chunk];
 		}
 
-		// If this node is a leaf node, try to intersect it with the ray, like any
-		// other shape. This part is analogous to the "Ray::closestHit" method, only
-		// now it's the BVH version.
-		if (flatNode.getRightOffset() == BVH::LEAF_NODE_RIGHT_OFFSET)
+		std::vector<const Shape**> scattered = std::vector<const Shape**>(end - start);
+
+#pragma omp parallel for num_threads(this->threadCount)
+		for (int chunk = 0; chunk < chunkCount; chunk++)
 		{
-			for (int i = 0; i < flatNode.getNumPrimitives(); i++)
-			{
-				const Shape &selectedShape =
-					*(*this->shapePtrs[flatNode.getStartIndex() + i]);
+			int chunkStart = std::min(start + (chunk * chunkSize), end);
+			int chunkEnd = std::min(chunkStart + chunkSize, end);
 
-				Intersection currentTry = selectedShape.hit(ray);
+			int leftIndex = 0;
+			int rightIndex = totalLeft;
+			for (int previous = 0; previous < chunk; previous++)
+			{
+				int previousStart = std::min(start + (previous * chunkSize), end);
+				int previousEnd = std::min(previousStart + chunkSize, end);
+				leftIndex += leftCounts[previous];
+				rightIndex += (previousEnd - previousStart) - leftCounts[previous];
+			}
 
-				if (currentTry.getT() < nearestT)
+			for (int i = chunkStart; i < chunkEnd; i++)
+			{
+				if (split.isLeft((*this->shapePtrs[i])->getCentroid()))
 				{
-					// A closer intersection was found. Overwrite the most recent one.
-					nearestT = currentTry.getT();
-					nearestPoint = currentTry.getPoint();
-					nearestNormal = currentTry.getNormal();
-					nearestShape = currentTry.getShape();
+					scattered[leftIndex] = this->shapePtrs[i];
+					leftIndex++;
+				}
+				else
+				{
+					scattered[rightIndex] = this->shapePtrs[i];
+					rightIndex++;
 				}
 			}
 		}
 
-		// Otherwise, if this node is an internal node, check its children to see if
-		// they will need to be pushed onto the work stack.
-		else
+		std::copy(scattered.begin(), scattered.end(), this->shapePtrs.begin() + start);
+		middle = start + totalLeft;
+	}
+
+	// If a bad split occurs, then choose the center index.
+	if ((middle == start) || (middle == end))
+	{
+		middle = start + ((end - start) / 2);
+	}
+
+	return middle;
+}
+
+int BVH::buildSubtree(int start, int end, int depth, BVHFlatNodeArray &nodes)
+{
+	// The work stack grows as needed, since its size depends on the tree's shape
+	// rather than on a fixed limit.
+	std::vector<BVHBuildEntry> workArray = std::vector<BVHBuildEntry>();
+
+	// Put the subtree's root into the bounding volume hierarchy. Parent indices are
+	// relative to the first node of the subtree.
+	const int firstNodeIndex = static_cast<int>(nodes.size());
+	workArray.push_back(BVHBuildEntry(start, end, BVH::ROOT_PARENT_INDEX, depth));
+
+	int leafCount = 0;
+
+	while (!workArray.empty())
+	{
+		const BVHBuildEntry buildNode = workArray.back();
+		workArray.pop_back();
+		const int nodeIndex = static_cast<int>(nodes.size()) - firstNodeIndex;
+
+		// Calculate the bounding box for this flat node.
+		BoundingBox nodeBox, nodeCentroidBox;
+		this->computeBounds(buildNode.getStartIndex(), buildNode.getEndIndex(), false,
+			&nodeBox, &nodeCentroidBox);
+
+		// Let the build method decide where to split the node, if at all.
+		BVHSplit split = this->chooseSplit(buildNode.getStartIndex(),
+			buildNode.getEndIndex(), nodeBox, nodeCentroidBox, false);
+		split = this->limitSplitDepth(split, buildNode.getDepth(),
+			buildNode.getEndIndex() - buildNode.getStartIndex());
+
+		// If the node isn't worth splitting, then it will become a leaf. This is
+		// signified by its right offset of zero. Internal nodes get their right
+		// offset once their right child is added.
+		if (split.isLeaf())
 		{
-			// See if the ray intersects either of the children bounding boxes.
-			bool hitChild0 = this->flatTree[workNode.getIndex() + 1]
-				.getBoundingBox().intersects(ray, &boundingBoxHits[0], &boundingBoxHits[1]);
-			bool hitChild1 = this->flatTree[workNode.getIndex() + flatNode.getRightOffset()]
-				.getBoundingBox().intersects(ray, &boundingBoxHits[2], &boundingBoxHits[3]);
+			leafCount++;
+		}
 
-			// If both child nodes were hit, assume the left child is closer.
-			if (hitChild0 && hitChild1)
-			{
-				closerNode = workNode.getIndex() + 1;
-				otherNode = workNode.getIndex() + flatNode.getRightOffset();
+		// Add the flat node to the flat tree.
+		nodes.push_back(BVHFlatNode(nodeBox, buildNode.getStartIndex(),
+			buildNode.getEndIndex() - buildNode.getStartIndex(),
+			split.isLeaf() ? BVH::LEAF_NODE_CHILD_OFFSET : BVH::UNSET_CHILD_OFFSET));
 
-				// Check if the right child actually was closer.
-				if (boundingBoxHits[2] < boundingBoxHits[0])
-				{
-					// Swap the T and index values.
-					double tempT = boundingBoxHits[0];
-					boundingBoxHits[0] = boundingBoxHits[2];
-					boundingBoxHits[2] = tempT;
-
-					tempT = boundingBoxHits[1];
-					boundingBoxHits[1] = boundingBoxHits[3];
-					boundingBoxHits[3] = tempT;
-
-					int tempIndex = closerNode;
-					closerNode = otherNode;
-					otherNode = tempIndex;
-				}
+		// The left child always directly follows its parent, so a child anywhere else
+		// is the right child, and it sets up the parent's offset.
+		const int parentIndex = buildNode.getParentIndex();
+		if ((parentIndex != BVH::ROOT_PARENT_INDEX) && (nodeIndex != (parentIndex + 1)))
+		{
+			nodes[firstNodeIndex + parentIndex].setChildOffset(nodeIndex - parentIndex);
+		}
 
-				// It's possible that the nearest hit shape is still in the other node.
+		// If the current node is a leaf, it is not subdivided.
+		if (split.isLeaf())
+		{
+			continue;
+		}
 
-				// Push the farther node into the work stack first.
-				stackIndex++;
-				workArray[stackIndex] = BVHTraversal(otherNode, boundingBoxHits[2]);
+		// Partition the shapes in place, so the node's range of shapes stays the same.
+		int nodeStart = buildNode.getStartIndex();
+		int nodeEnd = buildNode.getEndIndex();
+		int middle = this->partition(nodeStart, nodeEnd, split, false);
 
-				// And now push the closer node.
-				stackIndex++;
-				workArray[stackIndex] = BVHTraversal(closerNode, boundingBoxHits[0]);
-			}
+		// Push the right and left child nodes onto the work stack.
+		const int childDepth = buildNode.getDepth() + 1;
+		workArray.push_back(BVHBuildEntry(middle, nodeEnd, nodeIndex, childDepth));
+		workArray.push_back(BVHBuildEntry(nodeStart, middle, nodeIndex, childDepth));
+	}
 
-			// Else if only the left child was hit, push that one.
-			else if (hitChild0)
-			{
-				stackIndex++;
-				workArray[stackIndex] = BVHTraversal(workNode.getIndex() + 1, boundingBoxHits[0]);
-			}
+	return leafCount;
+}
 
-			// Else if only the right child was hit, push that one.
-			else if (hitChild1)
-			{
-				stackIndex++;
-				workArray[stackIndex] = BVHTraversal(
-					workNode.getIndex() + flatNode.getRightOffset(), boundingBoxHits[2]);
-			}
+BVHSplit BVH::limitSplitDepth(const BVHSplit &split, int depth, int count) const
+{
+	if (split.isLeaf() || (depth < BVH::MAX_SPLIT_DEPTH))
+	{
+		return split;
+	}
+
+	const int maxSAHLeafSize = BVH::MAX_SAH_LEAF_SIZE;
+	return (count <= std::max(this->leafCapacity, maxSAHLeafSize)) ?
+		BVHSplit::leaf() : BVHSplit::median();
+}
+
+int BVH::planTopLevels(int start, int end, int depth, int maxDepth,
+	std::vector<BVHBuildTask> &tasks)
+{
+	const int taskIndex = static_cast<int>(tasks.size());
+
+	// Once there are enough subtrees, or this one is small, it's handed to a worker.
+	if ((depth >= maxDepth) || ((end - start) < BVH::PARALLEL_NODE_THRESHOLD))
+	{
+		tasks.push_back(BVHBuildTask(start, end, depth));
+		return taskIndex;
+	}
+
+	BoundingBox nodeBox, nodeCentroidBox;
+	this->computeBounds(start, end, true, &nodeBox, &nodeCentroidBox);
+
+	BVHSplit split = this->chooseSplit(start, end, nodeBox, nodeCentroidBox, true);
+	if (split.isLeaf())
+	{
+		tasks.push_back(BVHBuildTask(start, end, depth));
+		return taskIndex;
+	}
+
+	int middle = this->partition(start, end, split, true);
+
+	tasks.push_back(BVHBuildTask(nodeBox, start, end, depth, taskIndex, taskIndex));
+	int leftTask = this->planTopLevels(start, middle, depth + 1, maxDepth, tasks);
+	int rightTask = this->planTopLevels(middle, end, depth + 1, maxDepth, tasks);
+	tasks[taskIndex].setChildren(leftTask, rightTask);
+	return taskIndex;
+}
+
+void BVH::emitTask(int taskIndex, const std::vector<BVHBuildTask> &tasks,
+	std::vector<BVHFlatNodeArray> &subtrees)
+{
+	const BVHBuildTask &task = tasks[taskIndex];
+
+	// Subtrees only use relative right offsets, so they can be copied as they are.
+	// Each one is freed once copied, so the whole tree is never held twice.
+	if (task.isSubtree())
+	{
+		BVHFlatNodeArray &subtree = subtrees[taskIndex];
+		this->flatTree.insert(this->flatTree.end(), subtree.begin(), subtree.end());
+		BVHFlatNodeArray().swap(subtree);
+		return;
+	}
+
+	// The left child directly follows this node, and the right child follows the
+	// whole left subtree.
+	const int nodeIndex = static_cast<int>(this->flatTree.size());
+	this->flatTree.push_back(BVHFlatNode(task.getBoundingBox(), task.getStartIndex(),
+		task.getEndIndex() - task.getStartIndex(), BVH::UNSET_CHILD_OFFSET));
+	this->emitTask(task.getLeftTask(), tasks, subtrees);
+	this->flatTree[nodeIndex].setChildOffset(
+		static_cast<int>(this->flatTree.size()) - nodeIndex);
+	this->emitTask(task.getRightTask(), tasks, subtrees);
+}
+
+void BVH::buildSerial()
+{
+	// A binary tree with one shape or more per leaf has at most 2n - 1 nodes.
+	const int shapeCount = static_cast<int>(this->shapePtrs.size());
+	this->flatTree.reserve((2 * shapeCount) - 1);
+	this->numLeaves = this->buildSubtree(BVH::ROOT_START_INDEX, shapeCount, 0,
+		this->flatTree);
+	this->notePeakBuildMemory(this->flatTree.capacity() * sizeof(BVHFlatNode));
+}
+
+void BVH::buildSpatial(const std::vector<Shape*> &shapes)
+{
+	SplitBVHBuilder builder = SplitBVHBuilder(shapes, this->binCount);
+	builder.build();
+
+	this->setShapeOrder(shapes, builder.getShapeOrder());
+	this->flatTree = builder.getNodes();
+	this->numLeaves = builder.getNumLeaves();
+	this->notePeakBuildMemory(builder.getPeakMemory() +
+		(this->flatTree.capacity() * sizeof(BVHFlatNode)) +
+		(this->shapePtrs.capacity() * sizeof(const Shape**)));
+}
+
+void BVH::buildLinear(const std::vector<Shape*> &shapes)
+{
+	LinearBVHBuilder builder = LinearBVHBuilder(shapes, this->threadCount);
+	builder.build();
+
+	this->setShapeOrder(shapes, builder.getShapeOrder());
+	this->flatTree = builder.getNodes();
+	this->numLeaves = builder.getNumLeaves();
+	this->notePeakBuildMemory(builder.getMemoryUsage() +
+		(this->flatTree.capacity() * sizeof(BVHFlatNode)) +
+		(this->shapePtrs.capacity() * sizeof(const Shape**)));
+}
+
+void BVH::setShapeOrder(const std::vector<Shape*> &shapes,
+	const std::vector<uint> &shapeOrder)
+{
+	const int shapeCount = static_cast<int>(shapeOrder.size());
+	this->shapePtrs = std::vector<const Shape**>(shapeCount);
+	for (int i = 0; i < shapeCount; i++)
+	{
+		this->shapePtrs[i] = const_cast<const Shape**>(&shapes[shapeOrder[i]]);
+	}
+}
+
+void BVH::buildParallel()
+{
+	// Split the top of the tree until there are a few subtrees per thread, so the
+	// dynamic schedule can balance uneven subtrees.
+	int maxDepth = 0;
+	while ((1 << maxDepth) < (this->threadCount * BVH::TASKS_PER_THREAD))
+	{
+		maxDepth++;
+	}
+
+	std::vector<BVHBuildTask> tasks = std::vector<BVHBuildTask>();
+	this->planTopLevels(BVH::ROOT_START_INDEX, static_cast<int>(this->shapePtrs.size()),
+		0, maxDepth, tasks);
+
+	// Build every subtree independently. Their shape ranges don't overlap, so each
+	// one can partition its own shapes in place.
+	const int taskCount = static_cast<int>(tasks.size());
+	std::vector<BVHFlatNodeArray> subtrees = std::vector<BVHFlatNodeArray>(taskCount);
+	std::vector<int> subtreeLeaves = std::vector<int>(taskCount, 0);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(this->threadCount)
+	for (int i = 0; i < taskCount; i++)
+	{
+		if (tasks[i].isSubtree())
+		{
+			subtreeLeaves[i] = this->buildSubtree(tasks[i].getStartIndex(),
+				tasks[i].getEndIndex(), tasks[i].getDepth(), subtrees[i]);
 		}
 	}
 
-	// Set the intersection data from the ray attempting to intersect the flat tree in 
-	// the intersection parameter.
-	return Intersection(nearestT, nearestPoint, nearestNormal, nearestShape);
+	// The flat tree is reserved at its exact size, for the top levels plus every
+	// subtree, before the subtrees are copied into it.
+	size_t nodeCount = 0;
+	size_t subtreeBytes = 0;
+	for (int i = 0; i < taskCount; i++)
+	{
+		nodeCount += tasks[i].isSubtree() ? subtrees[i].size() : 1;
+		subtreeBytes += subtrees[i].capacity() * sizeof(BVHFlatNode);
+	}
+
+	this->flatTree.reserve(nodeCount);
+	this->notePeakBuildMemory(subtreeBytes + (nodeCount * sizeof(BVHFlatNode)));
+
+	// Stitch the top levels and the subtrees together in depth-first order.
+	this->emitTask(0, tasks, subtrees);
+
+	for (int i = 0; i < taskCount; i++)
+	{
+		this->numLeaves += subtreeLeaves[i];
+	}
+}
+
+void BVH::orderShapesByLeaf()
+{
+	std::vector<const Shape**> orderedShapePtrs = std::vector<const Shape**>();
+	orderedShapePtrs.reserve(this->shapePtrs.size());
+
+	for (BVHFlatNode &node : this->flatTree)
+	{
+		if (node.isLeaf())
+		{
+			const int startIndex = node.getStartIndex();
+			const int count = node.getNumPrimitives();
+			node = BVHFlatNode(node.getBoundingBox(),
+				static_cast<int>(orderedShapePtrs.size()), count,
+				BVH::LEAF_NODE_CHILD_OFFSET);
+			orderedShapePtrs.insert(orderedShapePtrs.end(),
+				this->shapePtrs.begin() + startIndex,
+				this->shapePtrs.begin() + startIndex + count);
+		}
+	}
+
+	this->notePeakBuildMemory((this->flatTree.capacity() * sizeof(BVHFlatNode)) +
+		((this->shapePtrs.capacity() + orderedShapePtrs.capacity()) * sizeof(const Shape**)));
+	this->shapePtrs.swap(orderedShapePtrs);
+}
+
+void BVH::copyPrimitives()
+{
+	const int shapeCount = static_cast<int>(this->shapePtrs.size());
+	this->primitives.reserve(shapeCount);
+	for (int i = 0; i < shapeCount; i++)
+	{
+		this->primitives.push_back((*this->shapePtrs[i])->getPrimitive());
+	}
+}
+
+void BVH::notePeakBuildMemory(size_t bytes)
+{
+	this->peakBuildMemory = std::max(this->peakBuildMemory, bytes);
+}
+
+std::string BVH::getBuildMethodName(BVHBuildMethod buildMethod)
+{
+	switch (buildMethod)
+	{
+	case BVHBuildMethod::Midpoint:
+		return "midpoint";
+	case BVHBuildMethod::SpatialSAH:
+		return "spatial SAH";
+	case BVHBuildMethod::Linear:
+		return "linear";
+	default:
+		return "binned SAH";
+	}
+}
+
+const BVHFlatNodeArray &BVH::getFlatTree() const
+{
+	return this->flatTree;
+}
+
+const Shape *BVH::getShape(int index) const
+{
+	return *this->shapePtrs[index];
+}
+
+int BVH::getNumNodes() const
+{
+	return this->numNodes;
+}
+
+int BVH::getNumLeaves() const
+{
+	return this->numLeaves;
+}
+
+double BVH::getSAHCost() const
+{
+	if (this->flatTree.empty())
+	{
+		return 0.0;
+	}
+
+	// The cost of every node weighted by its area relative to the root's, which is
+	// the expected cost of a ray that hits the root.
+	double weightedArea = 0.0;
+	for (int i = 0; i < this->numNodes; i++)
+	{
+		weightedArea += this->getNodeCost(i);
+	}
+
+	const double rootArea = this->flatTree[0].getBoundingBox().getSurfaceArea();
+	return weightedArea / std::max(rootArea, Utility::EPSILON);
+}
+
+size_t BVH::getPeakBuildMemory() const
+{
+	return this->peakBuildMemory;
+}
+
+ullong BVH::getSampledRays() const
+{
+	return this->sampledRays;
+}
+
+ullong BVH::getSampledNodeVisits() const
+{
+	return this->sampledNodeVisits;
+}
+
+ullong BVH::getSampledPrimitiveTests() const
+{
+	return this->sampledPrimitiveTests;
+}
+
+void BVH::resetTraversalCounters()
+{
+	this->sampledRays = 0;
+	this->sampledNodeVisits = 0;
+	this->sampledPrimitiveTests = 0;
+}
+
+const Primitive &BVH::getPrimitive(int index) const
+{
+	return this->primitives[index];
+}
+
+Intersection BVH::nearestHit(const Ray &ray) const
+{
+	// Intersection data, just like a naive "Ray::closestShape" implementation.
+	// Nodes past the ray's max T are culled like those past the nearest hit.
+	double nearestT = ray.getTMax();
+	Vector3 nearestPoint;
+	Vector3 nearestNormal;
+	const Shape *nearestShape = nullptr;
+	const Shape *nearestTopLevelShape = nullptr;
+
+	if (this->flatTree.empty())
+	{
+		return Intersection();
+	}
+
+	// The ray's inverse direction and signs are only computed once per query.
+	const BVHRay bvhRay(ray);
+
+	// T values for where the ray enters the current pair of child nodes.
+	float leftNearT, rightNearT;
+
+	// The working set of traversal nodes. It lives on the stack, so a query
+	// doesn't allocate anything on the heap.
+	BVHTraversal workArray[BVH::MAX_BVH_TRAVERSAL_TO_DO];
+
+	// Push the root node onto the working set. Be careful that the negative
+	// intersection T max does not underflow.
+	workArray[0] = BVHTraversal(0, -Intersection::T_MAX);
+
+	// Work done by this ray, for the traversal statistics.
+	int nodeVisits = 0;
+	int primitiveTests = 0;
+
+	// Begin processing node hits.
+	int stackIndex = 0;
+	while (stackIndex >= 0)
+	{
+		// Pop the next work node off the work array. This node holds the "nodeNumber"
+		// and "nearT" values.
+		BVHTraversal workNode = workArray[stackIndex];
+		stackIndex--;
+
+		// Obtain a pointer to the current node in the BVH flat tree.
+		const BVHFlatNode &flatNode = this->flatTree[workNode.getIndex()];
+
+		// If the current closest intersection is closer than this node, continue.
+		if (nearestT < workNode.getMinT())
+		{
+			continue;
+		}
+
+		nodeVisits++;
+
+		// If this node is a leaf node, try to intersect it with the ray, like any
+		// other shape. This part is analogous to the "Ray::closestHit" method, only
+		// now it's the BVH version.
+		if (flatNode.isLeaf())
+		{
+			primitiveTests += flatNode.getNumPrimitives();
+			for (int i = 0; i < flatNode.getNumPrimitives(); i++)
+			{
+				const Primitive &primitive =
+					this->primitives[flatNode.getStartIndex() + i];
+
+				Intersection currentTry = primitive.hit(ray);
+
+				if (currentTry.getT() < nearestT)
+				{
+					// A closer intersection was found. Overwrite the most recent one.
+					nearestT = currentTry.getT();
+					nearestPoint = currentTry.getPoint();
+					nearestNormal = currentTry.getNormal();
+					nearestShape = currentTry.getShape();
+					nearestTopLevelShape = currentTry.getTopLevelShape();
+				}
+			}
+		}
+
+		// Otherwise, if this node is an internal node, check its children to see if
+		// they will need to be pushed onto the work stack.
+		else
+		{
+			const int leftIndex = workNode.getIndex() + flatNode.getChildOffset();
+			const int rightIndex = leftIndex + 1;
+
+			// Test both children in one pass, only as far as the nearest hit so far.
+			const int hitMask = bvhRay.intersects(this->flatTree[leftIndex],
+				this->flatTree[rightIndex], static_cast<float>(nearestT),
+				&leftNearT, &rightNearT);
+
+			// If both child nodes were hit, push the farther one first so the closer
+			// one is visited next. The nearest hit shape could still be in the other.
+			if (hitMask == (BVHRay::HIT_FIRST | BVHRay::HIT_SECOND))
+			{
+				this->prefetchNode((rightNearT < leftNearT) ? leftIndex : rightIndex);
+
+				if (rightNearT < leftNearT)
+				{
+					stackIndex++;
+					workArray[stackIndex] = BVHTraversal(leftIndex, leftNearT);
+					stackIndex++;
+					workArray[stackIndex] = BVHTraversal(rightIndex, rightNearT);
+				}
+				else
+				{
+					stackIndex++;
+					workArray[stackIndex] = BVHTraversal(rightIndex, rightNearT);
+					stackIndex++;
+					workArray[stackIndex] = BVHTraversal(leftIndex, leftNearT);
+				}
+			}
+
+			// Else if only the left child was hit, push that one.
+			else if (hitMask == BVHRay::HIT_FIRST)
+			{
+				stackIndex++;
+				workArray[stackIndex] = BVHTraversal(leftIndex, leftNearT);
+			}
+
+			// Else if only the right child was hit, push that one.
+			else if (hitMask == BVHRay::HIT_SECOND)
+			{
+				stackIndex++;
+				workArray[stackIndex] = BVHTraversal(rightIndex, rightNearT);
+			}
+		}
+	}
+
+	this->recordTraversal(ray, nodeVisits, primitiveTests);
+
+	// Set the intersection data from the ray attempting to intersect the flat tree in 
+	// the intersection parameter.
+	return (nearestShape != nullptr) ? Intersection(nearestT, nearestPoint, nearestNormal,
+		nearestShape, nearestTopLevelShape) : Intersection();
+}
+
+bool BVH::occluded(const Ray &ray) const
+{
+	if (this->flatTree.empty())
+	{
+		return false;
+	}
+
+	const BVHRay bvhRay(ray);
+	const double tMax = ray.getTMax();
+	const float maxT = static_cast<float>(tMax);
+	float leftNearT, rightNearT;
+
+	// Any hit will do, so children are visited in whatever order they were pushed.
+	int workArray[BVH::MAX_BVH_TRAVERSAL_TO_DO];
+	workArray[0] = 0;
+
+	int nodeVisits = 0;
+	int primitiveTests = 0;
+
+	int stackIndex = 0;
+	while (stackIndex >= 0)
+	{
+		const int nodeIndex = workArray[stackIndex];
+		stackIndex--;
+
+		const BVHFlatNode &flatNode = this->flatTree[nodeIndex];
+		nodeVisits++;
+
+		if (flatNode.isLeaf())
+		{
+			for (int i = 0; i < flatNode.getNumPrimitives(); i++)
+			{
+				const Primitive &primitive =
+					this->primitives[flatNode.getStartIndex() + i];
+				primitiveTests++;
+
+				if (primitive.hit(ray).getT() < tMax)
+				{
+					this->recordTraversal(ray, nodeVisits, primitiveTests);
+					return true;
+				}
+			}
+		}
+		else
+		{
+			const int leftIndex = nodeIndex + flatNode.getChildOffset();
+			const int rightIndex = leftIndex + 1;
+			const int hitMask = bvhRay.intersects(this->flatTree[leftIndex],
+				this->flatTree[rightIndex], maxT, &leftNearT, &rightNearT);
+
+			// The left child stays on the stack while the right one is visited.
+			if ((hitMask & BVHRay::HIT_FIRST) != 0)
+			{
+				if ((hitMask & BVHRay::HIT_SECOND) != 0)
+				{
+					this->prefetchNode(leftIndex);
+				}
+
+				stackIndex++;
+				workArray[stackIndex] = leftIndex;
+			}
+
+			if ((hitMask & BVHRay::HIT_SECOND) != 0)
+			{
+				stackIndex++;
+				workArray[stackIndex] = rightIndex;
+			}
+		}
+	}
+
+	this->recordTraversal(ray, nodeVisits, primitiveTests);
+	return false;
+}
+
+void BVH::nearestHits(const RayPacket &packet, Intersection *intersections) const
+{
+	// An incoherent packet can't be bounded with intervals, so its rays are traced
+	// one at a time instead.
+	if (!packet.isCoherent() || this->flatTree.empty())
+	{
+		Accelerator::nearestHits(packet, intersections);
+		return;
+	}
+
+	const int packetSize = packet.getSize();
+	BVHRay bvhRays[RayPacket::MAX_SIZE];
+	double nearestTs[RayPacket::MAX_SIZE];
+	for (int i = 0; i < packetSize; i++)
+	{
+		bvhRays[i] = BVHRay(packet.getRay(i));
+		nearestTs[i] = packet.getTMax();
+		intersections[i] = Intersection();
+	}
+
+	// The farthest of the rays' nearest hits. A node beyond it can't give any ray
+	// a closer hit.
+	double packetMaxT = packet.getTMax();
+
+	double rootNearT;
+	if (!packet.intersects(this->flatTree[0].getBoundingBox(), packetMaxT, &rootNearT))
+	{
+		return;
+	}
+
+	BVHTraversal workArray[BVH::MAX_BVH_TRAVERSAL_TO_DO];
+	workArray[0] = BVHTraversal(0, rootNearT);
+
+	int stackIndex = 0;
+	while (stackIndex >= 0)
+	{
+		BVHTraversal workNode = workArray[stackIndex];
+		stackIndex--;
+
+		if (packetMaxT < workNode.getMinT())
+		{
+			continue;
+		}
+
+		const BVHFlatNode &flatNode = this->flatTree[workNode.getIndex()];
+
+		if (flatNode.isLeaf())
+		{
+			// The packet only says that some ray might reach this leaf, so each ray
+			// tests the leaf's bounds before its shapes.
+			packetMaxT = 0.0;
+			for (int i = 0; i < packetSize; i++)
+			{
+				if (bvhRays[i].intersects(flatNode, static_cast<float>(nearestTs[i])))
+				{
+					const Ray ray = packet.getRay(i);
+					for (int j = 0; j < flatNode.getNumPrimitives(); j++)
+					{
+						const Primitive &primitive =
+							this->primitives[flatNode.getStartIndex() + j];
+
+						Intersection currentTry = primitive.hit(ray);
+
+						if (currentTry.getT() < nearestTs[i])
+						{
+							nearestTs[i] = currentTry.getT();
+							intersections[i] = currentTry;
+						}
+					}
+				}
+
+				packetMaxT = std::max(packetMaxT, nearestTs[i]);
+			}
+		}
+		else
+		{
+			const int leftIndex = workNode.getIndex() + flatNode.getChildOffset();
+			const int rightIndex = leftIndex + 1;
+			double leftNearT, rightNearT;
+			const bool hitLeft = packet.intersects(
+				this->flatTree[leftIndex].getBoundingBox(), packetMaxT, &leftNearT);
+			const bool hitRight = packet.intersects(
+				this->flatTree[rightIndex].getBoundingBox(), packetMaxT, &rightNearT);
+
+			if (hitLeft && hitRight)
+			{
+				this->prefetchNode((rightNearT < leftNearT) ? leftIndex : rightIndex);
+			}
+
+			// Push the farther child first, so the closer one is visited next.
+			if (hitLeft && hitRight && (rightNearT < leftNearT))
+			{
+				stackIndex++;
+				workArray[stackIndex] = BVHTraversal(leftIndex, leftNearT);
+				stackIndex++;
+				workArray[stackIndex] = BVHTraversal(rightIndex, rightNearT);
+			}
+			else
+			{
+				if (hitRight)
+				{
+					stackIndex++;
+					workArray[stackIndex] = BVHTraversal(rightIndex, rightNearT);
+				}
+
+				if (hitLeft)
+				{
+					stackIndex++;
+					workArray[stackIndex] = BVHTraversal(leftIndex, leftNearT);
+				}
+			}
+		}
+	}
+}
+
+void BVH::recordTraversal(const Ray &ray, int nodeVisits, int primitiveTests) const
+{
+	// Only a few rays are added to the shared totals, which keeps the atomic adds
+	// rare enough to leave on. The ray's bits are hashed to pick them, so the choice
+	// is spread evenly over rays without counting them anywhere.
+	const double values[] =
+	{
+		ray.getPoint().getX(), ray.getDirection().getX(), ray.getDirection().getY()
+	};
+
+	ullong hash = 0;
+	for (const double value : values)
+	{
+		ullong bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		hash = (hash ^ bits) * 0x9E3779B97F4A7C15ULL;
+	}
+
+	if (((hash >> 32) % BVH::TRAVERSAL_SAMPLE_INTERVAL) == 0)
+	{
+		this->sampledRays++;
+		this->sampledNodeVisits += static_cast<ullong>(nodeVisits);
+		this->sampledPrimitiveTests += static_cast<ullong>(primitiveTests);
+	}
+}
+
+void BVH::prefetchNode(int nodeIndex) const
+{
+	// The node shares a cache line with its sibling, which was just tested, so fetch
+	// what will be read after it instead.
+	const BVHFlatNode &node = this->flatTree[nodeIndex];
+	const char *next = node.isLeaf() ?
+		reinterpret_cast<const char*>(&this->primitives[node.getStartIndex()]) :
+		reinterpret_cast<const char*>(&this->flatTree[nodeIndex + node.getChildOffset()]);
+	_mm_prefetch(next, _MM_HINT_T0);
+}
+
+double BVH::getNodeCost(int nodeIndex) const
+{
+	const BVHFlatNode &node = this->flatTree[nodeIndex];
+	double cost = (node.getChildOffset() == BVH::LEAF_NODE_CHILD_OFFSET) ?
+		(static_cast<double>(node.getNumPrimitives()) * BVH::SAH_INTERSECTION_COST) :
+		BVH::SAH_TRAVERSAL_COST;
+	return node.getBoundingBox().getSurfaceArea() * cost;
+}
+
+double BVH::refitNode(int nodeIndex)
+{
+	BVHFlatNode &node = this->flatTree[nodeIndex];
+	double oldCost = this->getNodeCost(nodeIndex);
+
+	// Leaves surround their shapes, and internal nodes surround their children.
+	BoundingBox nodeBox = BoundingBox();
+	if (node.getChildOffset() == BVH::LEAF_NODE_CHILD_OFFSET)
+	{
+		for (int i = 0; i < node.getNumPrimitives(); i++)
+		{
+			nodeBox.expandToInclude(
+				(*this->shapePtrs[node.getStartIndex() + i])->getBoundingBox());
+		}
+	}
+	else
+	{
+		const int leftIndex = nodeIndex + node.getChildOffset();
+		nodeBox.expandToInclude(this->flatTree[leftIndex].getBoundingBox());
+		nodeBox.expandToInclude(this->flatTree[leftIndex + 1].getBoundingBox());
+	}
+
+	node.setBoundingBox(nodeBox);
+	return this->getNodeCost(nodeIndex) - oldCost;
+}
+
+void BVH::gatherRefitData()
+{
+	const int shapeCount = static_cast<int>(this->shapePtrs.size());
+	const int nodeCount = static_cast<int>(this->flatTree.size());
+
+	this->shapeIndices.reserve(shapeCount);
+	for (int i = 0; i < shapeCount; i++)
+	{
+		this->shapeIndices[*this->shapePtrs[i]] = i;
+	}
+
+	// Every node's parent and leaf are found in one pass. Rotations keep them up to
+	// date afterwards.
+	const int noParent = BVH::ROOT_PARENT_INDEX;
+	this->leafIndices = std::vector<int>(shapeCount);
+	this->parentIndices = std::vector<int>(nodeCount, noParent);
+	this->dirtyNodes = std::vector<bool>(nodeCount, false);
+	this->queuedNodes = std::vector<bool>(nodeCount, false);
+	this->weightedArea = 0.0;
+
+	for (int i = 0; i < nodeCount; i++)
+	{
+		const BVHFlatNode &node = this->flatTree[i];
+		this->weightedArea += this->getNodeCost(i);
+
+		if (BVHNodeLayout::isPadding(node))
+		{
+			continue;
+		}
+		else if (node.getChildOffset() == BVH::LEAF_NODE_CHILD_OFFSET)
+		{
+			for (int j = 0; j < node.getNumPrimitives(); j++)
+			{
+				this->leafIndices[node.getStartIndex() + j] = i;
+			}
+		}
+		else
+		{
+			const int leftIndex = i + node.getChildOffset();
+			this->parentIndices[leftIndex] = i;
+			this->parentIndices[leftIndex + 1] = i;
+		}
+	}
+
+	// Each leaf raises its ancestors' heights until one is already as tall.
+	this->nodeHeights = std::vector<int>(nodeCount, 0);
+	for (int i = 0; i < nodeCount; i++)
+	{
+		const BVHFlatNode &node = this->flatTree[i];
+		if (BVHNodeLayout::isPadding(node) ||
+			(node.getChildOffset() != BVH::LEAF_NODE_CHILD_OFFSET))
+		{
+			continue;
+		}
+
+		int height = 1;
+		for (int nodeIndex = this->parentIndices[i];
+			(nodeIndex != BVH::ROOT_PARENT_INDEX) && (this->nodeHeights[nodeIndex] < height);
+			nodeIndex = this->parentIndices[nodeIndex])
+		{
+			this->nodeHeights[nodeIndex] = height;
+			height++;
+		}
+	}
+
+	const double rootArea = (nodeCount > 0) ?
+		this->flatTree[0].getBoundingBox().getSurfaceArea() : 0.0;
+	this->builtCost = this->weightedArea / std::max(rootArea, Utility::EPSILON);
+	this->hasRefitData = true;
+}
+
+bool BVH::refit(const std::vector<const Shape*> &movedShapes)
+{
+	if (this->flatTree.empty())
+	{
+		return true;
+	}
+
+	// A split shape's leaves only hold the clipped parts of its box, which can't be
+	// recomputed from the shape.
+	if (this->buildMethod == BVHBuildMethod::SpatialSAH)
+	{
+		return false;
+	}
+
+	if (!this->hasRefitData)
+	{
+		this->gatherRefitData();
+	}
+
+	// Mark each moved shape's leaf and its ancestors, grouped by depth. Shapes that
+	// aren't in this tree are ignored. Marking stops at an already marked node,
+	// since its ancestors are marked too. Rotations change depths, so they're
+	// counted from the whole path up to the root.
+	std::vector<std::vector<int>> dirtyLevels = std::vector<std::vector<int>>();
+	std::vector<int> path = std::vector<int>();
+	int dirtyCount = 0;
+	for (const Shape *shape : movedShapes)
+	{
+		std::unordered_map<const Shape*, int>::const_iterator iter =
+			this->shapeIndices.find(shape);
+		if (iter == this->shapeIndices.end())
+		{
+			continue;
+		}
+
+		this->primitives[iter->second] = shape->getPrimitive();
+
+		path.clear();
+		for (int nodeIndex = this->leafIndices[iter->second];
+			nodeIndex != BVH::ROOT_PARENT_INDEX; nodeIndex = this->parentIndices[nodeIndex])
+		{
+			path.push_back(nodeIndex);
+		}
+
+		const int pathLength = static_cast<int>(path.size());
+		for (int i = 0; (i < pathLength) && !this->dirtyNodes[path[i]]; i++)
+		{
+			const int nodeIndex = path[i];
+			const int depth = pathLength - 1 - i;
+			if (depth >= static_cast<int>(dirtyLevels.size()))
+			{
+				dirtyLevels.resize(depth + 1);
+			}
+
+			this->dirtyNodes[nodeIndex] = true;
+			dirtyLevels[depth].push_back(nodeIndex);
+			dirtyCount++;
+			this->queueTouchedNode(nodeIndex);
+		}
+	}
+
+	// Refit from the deepest level up, so children are always done before their
+	// parents. Nodes on the same level don't depend on each other.
+	const bool parallel = dirtyCount >= BVH::PARALLEL_REFIT_THRESHOLD;
+	for (int depth = static_cast<int>(dirtyLevels.size()) - 1; depth >= 0; depth--)
+	{
+		const std::vector<int> &level = dirtyLevels[depth];
+		const int levelCount = static_cast<int>(level.size());
+		double areaChange = 0.0;
+
+#pragma omp parallel for reduction(+: areaChange) if (parallel && (levelCount > 1))
+		for (int i = 0; i < levelCount; i++)
+		{
+			areaChange += this->refitNode(level[i]);
+		}
+
+		this->weightedArea += areaChange;
+
+		for (const int nodeIndex : level)
+		{
+			this->dirtyNodes[nodeIndex] = false;
+		}
+	}
+
+	// Moving shapes apart stretches nodes over empty space, so past some point
+	// it's cheaper to rebuild than to keep traversing the stretched tree.
+	const double rootArea = this->flatTree[0].getBoundingBox().getSurfaceArea();
+	const double cost = this->weightedArea / std::max(rootArea, Utility::EPSILON);
+	return cost <= (this->builtCost * BVH::MAX_REFIT_COST_RATIO);
+}
+
+void BVH::queueTouchedNode(int nodeIndex)
+{
+	if (!this->queuedNodes[nodeIndex])
+	{
+		this->queuedNodes[nodeIndex] = true;
+		this->touchedNodes.push_back(nodeIndex);
+	}
+}
+
+int BVH::getNodeDepth(int nodeIndex) const
+{
+	int depth = 0;
+	for (int i = this->parentIndices[nodeIndex]; i != BVH::ROOT_PARENT_INDEX;
+		i = this->parentIndices[i])
+	{
+		depth++;
+	}
+
+	return depth;
+}
+
+void BVH::updateNodeHeights(int nodeIndex)
+{
+	while (nodeIndex != BVH::ROOT_PARENT_INDEX)
+	{
+		const BVHFlatNode &node = this->flatTree[nodeIndex];
+		const int leftIndex = nodeIndex + node.getChildOffset();
+		const int height = node.isLeaf() ? 0 : (1 + std::max(this->nodeHeights[leftIndex],
+			this->nodeHeights[leftIndex + 1]));
+
+		if (height == this->nodeHeights[nodeIndex])
+		{
+			break;
+		}
+
+		this->nodeHeights[nodeIndex] = height;
+		nodeIndex = this->parentIndices[nodeIndex];
+	}
+}
+
+void BVH::swapNodes(int firstIndex, int secondIndex)
+{
+	// Child offsets are relative, so a moved internal node's offset is shifted to
+	// keep pointing at the same children.
+	BVHFlatNode firstNode = this->flatTree[firstIndex];
+	BVHFlatNode secondNode = this->flatTree[secondIndex];
+	if (!firstNode.isLeaf())
+	{
+		firstNode.setChildOffset(firstNode.getChildOffset() + firstIndex - secondIndex);
+	}
+
+	if (!secondNode.isLeaf())
+	{
+		secondNode.setChildOffset(secondNode.getChildOffset() + secondIndex - firstIndex);
+	}
+
+	this->flatTree[firstIndex] = secondNode;
+	this->flatTree[secondIndex] = firstNode;
+	std::swap(this->nodeHeights[firstIndex], this->nodeHeights[secondIndex]);
+
+	// The swapped nodes keep their places' parents, but their children and shapes
+	// need to know where they went.
+	const int indices[] = { firstIndex, secondIndex };
+	for (const int nodeIndex : indices)
+	{
+		const BVHFlatNode &node = this->flatTree[nodeIndex];
+		if (node.isLeaf())
+		{
+			for (int i = 0; i < node.getNumPrimitives(); i++)
+			{
+				this->leafIndices[node.getStartIndex() + i] = nodeIndex;
+			}
+		}
+		else
+		{
+			const int leftIndex = nodeIndex + node.getChildOffset();
+			this->parentIndices[leftIndex] = nodeIndex;
+			this->parentIndices[leftIndex + 1] = nodeIndex;
+		}
+	}
+}
+
+double BVH::getSwapGain(int parentIndex, int oldChild, int newChild) const
+{
+	const BVHFlatNode &parentNode = this->flatTree[parentIndex];
+	const int leftIndex = parentIndex + parentNode.getChildOffset();
+	const int sibling = (oldChild == leftIndex) ? (leftIndex + 1) : leftIndex;
+
+	BoundingBox newBox = this->flatTree[newChild].getBoundingBox();
+	newBox.expandToInclude(this->flatTree[sibling].getBoundingBox());
+	return parentNode.getBoundingBox().getSurfaceArea() - newBox.getSurfaceArea();
+}
+
+bool BVH::rotateNode(int nodeIndex)
+{
+	const BVHFlatNode &node = this->flatTree[nodeIndex];
+	if (node.isLeaf() || BVHNodeLayout::isPadding(node))
+	{
+		return false;
+	}
+
+	const int leftIndex = nodeIndex + node.getChildOffset();
+	const int children[] = { leftIndex, leftIndex + 1 };
+	int grandchildren[2][2];
+	for (int i = 0; i < 2; i++)
+	{
+		const BVHFlatNode &child = this->flatTree[children[i]];
+		grandchildren[i][0] = child.isLeaf() ? BVH::ROOT_PARENT_INDEX :
+			(children[i] + child.getChildOffset());
+		grandchildren[i][1] = child.isLeaf() ? BVH::ROOT_PARENT_INDEX :
+			(grandchildren[i][0] + 1);
+	}
+
+	// Only beat a swap by a clear margin, so float rounding can't make two swaps
+	// undo each other forever.
+	const double minGain = node.getBoundingBox().getSurfaceArea() * BVH::MIN_ROTATION_GAIN;
+	int bestFirst = BVH::ROOT_PARENT_INDEX;
+	int bestSecond = BVH::ROOT_PARENT_INDEX;
+	double bestGain = minGain;
+
+	// A child can swap with a grandchild under the other child, which only changes
+	// the other child's bounds. The child's subtree moves a level down, so it's
+	// skipped if that would make its deepest leaf too deep.
+	const int childDepth = this->getNodeDepth(nodeIndex) + 1;
+	for (int i = 0; i < 2; i++)
+	{
+		if ((childDepth + 1 + this->nodeHeights[children[i]]) > BVH::MAX_LEAF_DEPTH)
+		{
+			continue;
+		}
+
+		const int sibling = children[1 - i];
+		for (int j = 0; (j < 2) && (grandchildren[1 - i][j] != BVH::ROOT_PARENT_INDEX); j++)
+		{
+			const int grandchild = grandchildren[1 - i][j];
+			const double gain = this->getSwapGain(sibling, grandchild, children[i]);
+			if (gain > bestGain)
+			{
+				bestFirst = children[i];
+				bestSecond = grandchild;
+				bestGain = gain;
+			}
+		}
+	}
+
+	// Grandchildren under different children can swap too, which changes both.
+	if ((grandchildren[0][0] != BVH::ROOT_PARENT_INDEX) &&
+		(grandchildren[1][0] != BVH::ROOT_PARENT_INDEX))
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				const int first = grandchildren[0][i];
+				const int second = grandchildren[1][j];
+				const double gain = this->getSwapGain(children[0], first, second) +
+					this->getSwapGain(children[1], second, first);
+				if (gain > bestGain)
+				{
+					bestFirst = first;
+					bestSecond = second;
+					bestGain = gain;
+				}
+			}
+		}
+	}
+
+	if (bestFirst == BVH::ROOT_PARENT_INDEX)
+	{
+		return false;
+	}
+
+	this->swapNodes(bestFirst, bestSecond);
+
+	// The children whose contents changed get new bounds, and they and the node's
+	// parent have new grandchildren, which may allow more rotations.
+	for (const int child : children)
+	{
+		this->weightedArea += this->refitNode(child);
+		this->updateNodeHeights(child);
+		this->queueTouchedNode(child);
+	}
+
+	if (this->parentIndices[nodeIndex] != BVH::ROOT_PARENT_INDEX)
+	{
+		this->queueTouchedNode(this->parentIndices[nodeIndex]);
+	}
+
+	return true;
+}
+
+bool BVH::optimize(double seconds)
+{
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	bool rotated = false;
+	while (!this->touchedNodes.empty())
+	{
+		const double elapsed = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - startTime).count();
+		if (elapsed >= seconds)
+		{
+			break;
+		}
+
+		const int nodeIndex = this->touchedNodes.front();
+		this->touchedNodes.pop_front();
+		this->queuedNodes[nodeIndex] = false;
+		rotated |= this->rotateNode(nodeIndex);
+	}
+
+	return rotated;
+}
+
+bool BVH::isOptimized() const
+{
+	return this->touchedNodes.empty();
+}
+
+size_t BVH::getMemoryUsage() const
+{
+	return (this->flatTree.capacity() * sizeof(BVHFlatNode)) +
+		(this->primitives.capacity() * sizeof(Primitive)) +
+		(this->shapePtrs.capacity() * sizeof(const Shape**));
 }
\ No newline at end of file
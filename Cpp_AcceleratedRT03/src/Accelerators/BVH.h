@@ -1,35 +1,250 @@
 #ifndef BVH_H
 #define BVH_H
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Accelerator.h"
+#include "BVHFlatNode.h"
+#include "BoundingBox.h"
+#include "../Shapes/Primitive.h"
 #include "../Utilities/Utility.h"
 
 // Uses code from the "Fast-BVH" ray tracer by Brandon Pelfrey.
 
+// Midpoint splits each node at the center of its centroids' longest axis, and makes
+// leaves of a fixed capacity. Binned SAH picks the cheapest of several candidate
+// splits per axis using the surface area heuristic, and lets that cost decide when
+// a node larger than a midpoint leaf should become a leaf. Spatial SAH also considers splitting shapes between
+// both children, which suits static scenes of large overlapping shapes, but its
+// trees can't be refit. Linear sorts the shapes along a Morton curve and builds the
+// tree from their codes, which is much faster than the others, for scenes that are
+// rebuilt often.
+enum class BVHBuildMethod { Midpoint, BinnedSAH, SpatialSAH, Linear };
+
 class BVH : public Accelerator
 {
 private:
 	std::vector<const class Shape**> shapePtrs;
-	std::vector<class BVHFlatNode> flatTree;
+	BVHFlatNodeArray flatTree;
+
+	// The leaves' shapes, copied in the same order as "shapePtrs" so each leaf's
+	// primitives are contiguous.
+	std::vector<Primitive> primitives;
+
+	// Refit data, only gathered the first time the tree is refit.
+	std::unordered_map<const class Shape*, int> shapeIndices;
+	std::vector<int> leafIndices, parentIndices;
+
+	// How many levels are below each node, so rotations can tell how deep they'd push
+	// its leaves.
+	std::vector<int> nodeHeights;
+	std::vector<bool> dirtyNodes;
+
+	// Nodes whose bounds refits have changed, waiting to be optimized.
+	std::deque<int> touchedNodes;
+	std::vector<bool> queuedNodes;
+	double weightedArea, builtCost;
+	bool hasRefitData;
+
+	// Totals from the sampled single-ray traversals, for statistics.
+	mutable std::atomic<ullong> sampledRays, sampledNodeVisits, sampledPrimitiveTests;
+
+	// The most bytes the build held at once, counting the finished tree.
+	size_t peakBuildMemory;
+
+	BVHBuildMethod buildMethod;
+	int binCount;
+	int threadCount;
 	int numNodes;
 	int numLeaves;
 	int leafCapacity;
 
 	static const int DEFAULT_LEAF_CAPACITY = 4;
-	static const int MAX_BVH_BUILD_TO_DO = 128;
+	static const int MAX_BIN_COUNT = 64;
+	static const int MAX_SAH_LEAF_SIZE = 16;
+	// Halving nodes past the split depth adds at most 31 more levels, so a traversal
+	// stack, which holds at most one entry per level, can't overflow.
+	static const int MAX_SPLIT_DEPTH = 64;
 	static const int MAX_BVH_TRAVERSAL_TO_DO = 128;
-	static const int LEAF_NODE_RIGHT_OFFSET = 0;
-	static const int UNTOUCHED = 0xFFFFFFFF;
-	static const int TOUCHED_TWICE = 0xFFFFFFFD;
+	static const int PARALLEL_BUILD_THRESHOLD = 4096;
+	static const int PARALLEL_NODE_THRESHOLD = 1024;
+	static const int TASKS_PER_THREAD = 4;
+	static const int PARALLEL_REFIT_THRESHOLD = 256;
+	static const int LEAF_NODE_CHILD_OFFSET = 0;
+	static const int UNSET_CHILD_OFFSET = 0x7FFFFFFF;
 	static const int ROOT_START_INDEX = 0;
-	static const int ROOT_PARENT_INDEX = 0xFFFFFFFC;
+	static const int ROOT_PARENT_INDEX = -1;
+	static const int TRAVERSAL_SAMPLE_INTERVAL = 64;
+
+	// Testing a pair of child boxes takes about as long as a sphere's hit test.
+	static const double SAH_TRAVERSAL_COST;
+	static const double SAH_INTERSECTION_COST;
+	static const double MAX_REFIT_COST_RATIO;
+	static const double MIN_ROTATION_GAIN;
+
+	// The "parallel" flag lets a single large node spread its work over all build
+	// threads. It's only used for the top levels of a parallel build, where there
+	// aren't enough nodes yet to keep every thread busy.
+	void computeBounds(int start, int end, bool parallel, BoundingBox *nodeBox,
+		BoundingBox *centroidBox) const;
+	void binShapes(int start, int end, const double *axisMins, const double *binScales,
+		int *binCounts, BoundingBox *binBoxes) const;
+	class BVHSplit chooseSplit(int start, int end, const BoundingBox &nodeBox,
+		const BoundingBox &centroidBox, bool parallel) const;
+	class BVHSplit chooseMidpointSplit(int start, int end,
+		const BoundingBox &centroidBox) const;
+	class BVHSplit chooseBinnedSAHSplit(int start, int end, const BoundingBox &nodeBox,
+		const BoundingBox &centroidBox, bool parallel) const;
+
+	// Past the maximum split depth, nodes either become leaves or are halved, so no
+	// path through the tree is longer than the traversal stacks allow for.
+	class BVHSplit limitSplitDepth(const class BVHSplit &split, int depth, int count) const;
+
+	// Partitions the shapes in [start, end) in place and returns the index of the
+	// first shape in the right child.
+	int partition(int start, int end, const class BVHSplit &split, bool parallel);
+
+	// Appends the depth-first flat nodes for the shapes in [start, end) to the given
+	// nodes, and returns how many of them are leaves. Right offsets are relative, so
+	// a subtree can be built on its own and copied into the flat tree afterwards.
+	// The depth is that of the subtree's root in the whole tree.
+	int buildSubtree(int start, int end, int depth, BVHFlatNodeArray &nodes);
+
+	// Splits the top of the tree on the calling thread until there are enough
+	// subtrees for every thread, and returns the index of the new task.
+	int planTopLevels(int start, int end, int depth, int maxDepth,
+		std::vector<class BVHBuildTask> &tasks);
+	void emitTask(int taskIndex, const std::vector<class BVHBuildTask> &tasks,
+		std::vector<BVHFlatNodeArray> &subtrees);
+	void buildSerial();
+	void buildParallel();
+
+	// Replaces the shape order with the spatial split builder's, which may list a
+	// shape in more than one leaf.
+	void buildSpatial(const std::vector<class Shape*> &shapes);
+	void buildLinear(const std::vector<class Shape*> &shapes);
+
+	// Points each position in the leaves' order at the shape a builder put there.
+	void setShapeOrder(const std::vector<class Shape*> &shapes,
+		const std::vector<uint> &shapeOrder);
+
+	// Renumbers the leaves' shapes to follow the nodes' layout, so leaves stored near
+	// each other also have their primitives near each other.
+	void orderShapesByLeaf();
+
+	// Fills the primitives from the shapes, in their current order.
+	void copyPrimitives();
+
+	void notePeakBuildMemory(size_t bytes);
+
+	// Adds one ray's traversal work to the sampled totals, if it's a sampled ray.
+	// Whether it is depends only on the ray, so each tree samples its own rays evenly,
+	// whatever other trees are traced on the same thread.
+	void recordTraversal(const class Ray &ray, int nodeVisits, int primitiveTests) const;
+
+	// Starts loading the data a node will need once it's popped from a traversal stack.
+	void prefetchNode(int nodeIndex) const;
+
+	// The SAH cost weight of a node, which is its area times the cost of visiting it.
+	double getNodeCost(int nodeIndex) const;
+
+	// Returns the change in the tree's weighted area from refitting the given node.
+	double refitNode(int nodeIndex);
+	void gatherRefitData();
+	void queueTouchedNode(int nodeIndex);
+
+	// The root's depth is zero.
+	int getNodeDepth(int nodeIndex) const;
+
+	// Recomputes the heights of the node and its ancestors after its children changed,
+	// stopping at the first one whose height stays the same.
+	void updateNodeHeights(int nodeIndex);
+
+	// Swaps two nodes that aren't on the same path from the root, along with their
+	// subtrees.
+	void swapNodes(int firstIndex, int secondIndex);
+
+	// How much a parent's area shrinks if one of its children is swapped for
+	// another node.
+	double getSwapGain(int parentIndex, int oldChild, int newChild) const;
+
+	// Tries swapping each child of the node with a grandchild under the other
+	// child, and grandchildren under different children with each other, like the
+	// tree rotations by Kensler. Makes the swap that shrinks the children the most,
+	// if any, and returns whether it made one. Swaps that would push a leaf past the
+	// maximum leaf depth are skipped.
+	bool rotateNode(int nodeIndex);
 public:
+	// No leaf is deeper than this, counting the root as depth zero, so traversal
+	// stacks always fit. Rotations never go past it, and adopted trees must not
+	// either.
+	static const int MAX_LEAF_DEPTH = BVH::MAX_SPLIT_DEPTH + 31;
+
+	static const BVHBuildMethod DEFAULT_BUILD_METHOD;
+	static const int DEFAULT_BIN_COUNT = 16;
+
+	static std::string getBuildMethodName(BVHBuildMethod buildMethod);
+
+	// A thread count of one builds on the calling thread only.
+	BVH(const std::vector<class Shape*> &shapes, BVHBuildMethod buildMethod, int binCount,
+		int threadCount);
 	BVH(const std::vector<class Shape*> &shapes);
 
+	// Adopts a tree built earlier from the same shapes, such as one loaded from a
+	// cache. The shape order gives each leaf shape's index in the shape list.
+	BVH(const std::vector<class Shape*> &shapes, const BVHFlatNode *nodes, int nodeCount,
+		const uint *shapeOrder, int numLeaves);
+
+	// The flat tree, and the shape at a position in its leaves' order. These are for
+	// accelerators built on top of a binary BVH.
+	const BVHFlatNodeArray &getFlatTree() const;
+	const class Shape *getShape(int index) const;
+	int getNumNodes() const;
+	int getNumLeaves() const;
+	const Primitive &getPrimitive(int index) const;
+
+	// The expected cost of a ray that hits the root, relative to one shape test.
+	double getSAHCost() const;
+
+	// Zero for trees adopted from elsewhere, such as a cache.
+	size_t getPeakBuildMemory() const;
+
+	// About one of every so many rays traced one at a time (not in packets) adds how
+	// many nodes it visited and shapes it tested to these totals. They start at zero
+	// when the tree is built.
+	ullong getSampledRays() const;
+	ullong getSampledNodeVisits() const;
+	ullong getSampledPrimitiveTests() const;
+	void resetTraversalCounters();
+
 	virtual class Intersection nearestHit(const class Ray &ray) const override;
+	virtual bool occluded(const class Ray &ray) const override;
+
+	// Culls nodes for the whole packet at once while it's coherent, and only tests
+	// single rays against the nodes of leaves the packet reaches.
+	virtual void nearestHits(const class RayPacket &packet,
+		class Intersection *intersections) const override;
+
+	// Recopies the moved shapes' primitives and recomputes the bounds of the leaves
+	// holding them and of their ancestors. Returns false once the tree's SAH cost
+	// has degraded too far from when it was built, meaning a rebuild is due. Trees
+	// with split shapes always need a rebuild.
+	virtual bool refit(const std::vector<const class Shape*> &movedShapes) override;
+
+	// Rotates the nodes refits have touched, children before parents, until time is
+	// up. A rotation never changes the tree's shapes, only how they're grouped, so
+	// tracing stays correct whenever it's stopped.
+	virtual bool optimize(double seconds) override;
+
+	// Whether every node refits have touched has been optimized.
+	bool isOptimized() const;
+
+	virtual size_t getMemoryUsage() const override;
 };
 
 #endif
\ No newline at end of file
@@ -5,13 +5,15 @@ BVHBuildEntry::BVHBuildEntry()
 	this->startIndex = 0;
 	this->endIndex = 0;
 	this->parentIndex = 0;
+	this->depth = 0;
 }
 
-BVHBuildEntry::BVHBuildEntry(int startIndex, int endIndex, int parentIndex)
+BVHBuildEntry::BVHBuildEntry(int startIndex, int endIndex, int parentIndex, int depth)
 {
 	this->startIndex = startIndex;
 	this->endIndex = endIndex;
 	this->parentIndex = parentIndex;
+	this->depth = depth;
 }
 
 int BVHBuildEntry::getStartIndex() const
@@ -27,4 +29,9 @@ int BVHBuildEntry::getEndIndex() const
 int BVHBuildEntry::getParentIndex() const
 {
 	return this->parentIndex;
+}
+
+int BVHBuildEntry::getDepth() const
+{
+	return this->depth;
 }
\ No newline at end of file
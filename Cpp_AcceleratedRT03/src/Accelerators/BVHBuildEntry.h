@@ -9,13 +9,15 @@ private:
 	int startIndex;
 	int endIndex;
 	int parentIndex;
+	int depth;
 public:
 	BVHBuildEntry();
-	BVHBuildEntry(int startIndex, int endIndex, int parentIndex);
+	BVHBuildEntry(int startIndex, int endIndex, int parentIndex, int depth);
 
 	int getStartIndex() const;
 	int getEndIndex() const;
 	int getParentIndex() const;
+	int getDepth() const;
 };
 
 #endif
\ No newline at end of file
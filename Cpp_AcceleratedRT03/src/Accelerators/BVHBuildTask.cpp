@@ -0,0 +1,57 @@
+#include "BVHBuildTask.h"
+
+BVHBuildTask::BVHBuildTask(int startIndex, int endIndex, int depth)
+	: BVHBuildTask(BoundingBox(), startIndex, endIndex, depth, BVHBuildTask::NO_TASK,
+	BVHBuildTask::NO_TASK) { }
+
+BVHBuildTask::BVHBuildTask(const BoundingBox &boundingBox, int startIndex, int endIndex,
+	int depth, int leftTask, int rightTask)
+	: boundingBox(boundingBox)
+{
+	this->startIndex = startIndex;
+	this->endIndex = endIndex;
+	this->depth = depth;
+	this->leftTask = leftTask;
+	this->rightTask = rightTask;
+}
+
+const BoundingBox &BVHBuildTask::getBoundingBox() const
+{
+	return this->boundingBox;
+}
+
+int BVHBuildTask::getStartIndex() const
+{
+	return this->startIndex;
+}
+
+int BVHBuildTask::getEndIndex() const
+{
+	return this->endIndex;
+}
+
+int BVHBuildTask::getDepth() const
+{
+	return this->depth;
+}
+
+int BVHBuildTask::getLeftTask() const
+{
+	return this->leftTask;
+}
+
+int BVHBuildTask::getRightTask() const
+{
+	return this->rightTask;
+}
+
+bool BVHBuildTask::isSubtree() const
+{
+	return this->leftTask == BVHBuildTask::NO_TASK;
+}
+
+void BVHBuildTask::setChildren(int leftTask, int rightTask)
+{
+	this->leftTask = leftTask;
+	this->rightTask = rightTask;
+}
\ No newline at end of file
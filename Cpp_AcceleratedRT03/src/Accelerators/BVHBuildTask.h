@@ -0,0 +1,36 @@
+#ifndef BVH_BUILD_TASK_H
+#define BVH_BUILD_TASK_H
+
+#include "BoundingBox.h"
+#include "../Utilities/Utility.h"
+
+// One node of the top levels of a parallel BVH build. It is either an internal node
+// that was split on the calling thread, or a range of shapes whose subtree is built
+// independently by a worker thread.
+
+class BVHBuildTask
+{
+private:
+	BoundingBox boundingBox;
+	int startIndex, endIndex, depth, leftTask, rightTask;
+
+	static const int NO_TASK = -1;
+public:
+	// A subtree task, whose root is at the given depth in the whole tree.
+	BVHBuildTask(int startIndex, int endIndex, int depth);
+
+	// An internal node whose children are other tasks.
+	BVHBuildTask(const BoundingBox &boundingBox, int startIndex, int endIndex, int depth,
+		int leftTask, int rightTask);
+
+	const BoundingBox &getBoundingBox() const;
+	int getStartIndex() const;
+	int getEndIndex() const;
+	int getDepth() const;
+	int getLeftTask() const;
+	int getRightTask() const;
+	bool isSubtree() const;
+	void setChildren(int leftTask, int rightTask);
+};
+
+#endif
\ No newline at end of file
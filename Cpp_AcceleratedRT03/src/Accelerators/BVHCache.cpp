@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+#include "BVH.h"
+#include "BVHCache.h"
+#include "BVHFlatNode.h"
+#include "BoundingBox.h"
+#include "../Shapes/Shape.h"
+#include "../Utilities/MappedFile.h"
+
+const std::string BVHCache::INDEX_FILENAME = "bvh_cache.index";
+
+void BVHCache::hashBytes(ullong &hash, const void *bytes, size_t count)
+{
+	const uchar *data = static_cast<const uchar*>(bytes);
+	for (size_t i = 0; i < count; i++)
+	{
+		hash = (hash ^ data[i]) * BVHCache::FNV_PRIME;
+	}
+}
+
+void BVHCache::hashVector(ullong &hash, const Vector3 &v)
+{
+	const double components[] = { v.getX(), v.getY(), v.getZ() };
+	BVHCache::hashBytes(hash, components, sizeof(components));
+}
+
+ullong BVHCache::hashScene(const std::vector<Shape*> &shapes)
+{
+	ullong hash = BVHCache::FNV_OFFSET_BASIS;
+
+	const ullong shapeCount = static_cast<ullong>(shapes.size());
+	const int buildMethod = static_cast<int>(BVH::DEFAULT_BUILD_METHOD);
+	BVHCache::hashBytes(hash, &shapeCount, sizeof(shapeCount));
+	BVHCache::hashBytes(hash, &buildMethod, sizeof(buildMethod));
+
+	for (const Shape *shape : shapes)
+	{
+		const BoundingBox box = shape->getBoundingBox();
+		BVHCache::hashVector(hash, box.getMin());
+		BVHCache::hashVector(hash, box.getMax());
+		BVHCache::hashVector(hash, shape->getCentroid());
+	}
+
+	return hash;
+}
+
+std::string BVHCache::getFilename(ullong sceneHash)
+{
+	std::ostringstream filename;
+	filename << "bvh_" << std::hex << std::setfill('0') << std::setw(16) << sceneHash
+		<< ".cache";
+	return filename.str();
+}
+
+std::unique_ptr<BVH> BVHCache::load(const std::vector<Shape*> &shapes, ullong sceneHash)
+{
+	const MappedFile file(BVHCache::getFilename(sceneHash));
+	if (!file.isOpen() || (file.getSize() < sizeof(Header)))
+	{
+		return nullptr;
+	}
+
+	const Header &header = *reinterpret_cast<const Header*>(file.getData());
+	const size_t expectedSize = sizeof(Header) +
+		(static_cast<size_t>(header.nodeCount) * sizeof(BVHFlatNode)) +
+		(static_cast<size_t>(header.shapeCount) * sizeof(uint));
+	if ((header.magic != BVHCache::MAGIC) || (header.version != BVHCache::VERSION) ||
+		(header.sceneHash != sceneHash) || (header.shapeCount != shapes.size()) ||
+		(header.nodeCount == 0) || (file.getSize() != expectedSize))
+	{
+		return nullptr;
+	}
+
+	const BVHFlatNode *nodes =
+		reinterpret_cast<const BVHFlatNode*>(file.getData() + sizeof(Header));
+	const uint *shapeOrder = reinterpret_cast<const uint*>(nodes + header.nodeCount);
+
+	const int nodeCount = static_cast<int>(header.nodeCount);
+	const int shapeCount = static_cast<int>(header.shapeCount);
+	const int leafCount = static_cast<int>(header.leafCount);
+	if ((nodeCount < 0) || !BVHCache::isValidTree(nodes, nodeCount, shapeOrder,
+		shapeCount, leafCount))
+	{
+		return nullptr;
+	}
+
+	BVHCache::touchFile(BVHCache::getFilename(sceneHash));
+	return std::unique_ptr<BVH>(new BVH(shapes, nodes, nodeCount, shapeOrder, leafCount));
+}
+
+bool BVHCache::isValidTree(const BVHFlatNode *nodes, int nodeCount, const uint *shapeOrder,
+	int shapeCount, int leafCount)
+{
+	std::vector<bool> seenShapes = std::vector<bool>(shapeCount, false);
+	for (int i = 0; i < shapeCount; i++)
+	{
+		if ((shapeOrder[i] >= static_cast<uint>(shapeCount)) || seenShapes[shapeOrder[i]])
+		{
+			return false;
+		}
+
+		seenShapes[shapeOrder[i]] = true;
+	}
+
+	// Walk down from the root with each node's depth. A node reached twice would
+	// mean a cycle or shared subtree, which a built tree never has.
+	std::vector<bool> seenNodes = std::vector<bool>(nodeCount, false);
+	std::vector<std::pair<int, int>> toDo = std::vector<std::pair<int, int>>();
+	toDo.push_back(std::make_pair(0, 0));
+	seenNodes[0] = true;
+	int leavesFound = 0;
+
+	while (!toDo.empty())
+	{
+		const BVHFlatNode &node = nodes[toDo.back().first];
+		const int index = toDo.back().first;
+		const int depth = toDo.back().second;
+		toDo.pop_back();
+
+		if (node.isLeaf())
+		{
+			const llong start = static_cast<llong>(node.getStartIndex());
+			const llong end = start + static_cast<llong>(node.getNumPrimitives());
+			if ((start < 0) || (end > static_cast<llong>(shapeCount)))
+			{
+				return false;
+			}
+
+			leavesFound++;
+			continue;
+		}
+
+		// Padding nodes have an offset of zero, so they're never a child.
+		const llong leftIndex = static_cast<llong>(index) + node.getChildOffset();
+		if ((depth >= BVH::MAX_LEAF_DEPTH) || (leftIndex <= index) ||
+			((leftIndex + 1) >= static_cast<llong>(nodeCount)) ||
+			seenNodes[static_cast<int>(leftIndex)] || seenNodes[static_cast<int>(leftIndex) + 1])
+		{
+			return false;
+		}
+
+		for (int i = 0; i < 2; i++)
+		{
+			seenNodes[static_cast<int>(leftIndex) + i] = true;
+			toDo.push_back(std::make_pair(static_cast<int>(leftIndex) + i, depth + 1));
+		}
+	}
+
+	return leavesFound == leafCount;
+}
+
+void BVHCache::touchFile(const std::string &filename)
+{
+	std::vector<std::string> filenames = std::vector<std::string>();
+	{
+		std::ifstream stream(BVHCache::INDEX_FILENAME);
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			if (!line.empty() && (line != filename))
+			{
+				filenames.push_back(line);
+			}
+		}
+	}
+
+	filenames.push_back(filename);
+
+	const int extraCount = std::max(0,
+		static_cast<int>(filenames.size()) - BVHCache::MAX_CACHE_FILES);
+	for (int i = 0; i < extraCount; i++)
+	{
+		std::remove(filenames[i].c_str());
+	}
+
+	std::ofstream stream(BVHCache::INDEX_FILENAME, std::ios::trunc);
+	for (size_t i = static_cast<size_t>(extraCount); i < filenames.size(); i++)
+	{
+		stream << filenames[i] << "\n";
+	}
+}
+
+bool BVHCache::save(const BVH &bvh, const std::vector<Shape*> &shapes, ullong sceneHash)
+{
+	const BVHFlatNodeArray &flatTree = bvh.getFlatTree();
+	if (flatTree.empty())
+	{
+		return false;
+	}
+
+	std::unordered_map<const Shape*, uint> shapeIndices =
+		std::unordered_map<const Shape*, uint>();
+	shapeIndices.reserve(shapes.size());
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		shapeIndices[shapes[i]] = static_cast<uint>(i);
+	}
+
+	std::vector<uint> shapeOrder = std::vector<uint>(shapes.size());
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		shapeOrder[i] = shapeIndices[bvh.getShape(static_cast<int>(i))];
+	}
+
+	Header header;
+	header.magic = BVHCache::MAGIC;
+	header.version = BVHCache::VERSION;
+	header.sceneHash = sceneHash;
+	header.shapeCount = static_cast<uint>(shapes.size());
+	header.nodeCount = static_cast<uint>(flatTree.size());
+	header.leafCount = static_cast<uint>(bvh.getNumLeaves());
+	header.reserved = 0;
+
+	// Write to a temporary file first, so another launch never maps a partial one.
+	const std::string filename = BVHCache::getFilename(sceneHash);
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream stream(tempFilename, std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(flatTree.data()),
+			flatTree.size() * sizeof(BVHFlatNode));
+		stream.write(reinterpret_cast<const char*>(shapeOrder.data()),
+			shapeOrder.size() * sizeof(uint));
+
+		if (!stream.good())
+		{
+			stream.close();
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		return false;
+	}
+
+	BVHCache::touchFile(filename);
+	return true;
+}
\ No newline at end of file
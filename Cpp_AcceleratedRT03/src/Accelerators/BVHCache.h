@@ -0,0 +1,79 @@
+#ifndef BVH_CACHE_H
+#define BVH_CACHE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Utilities/Utility.h"
+
+// Saves a built BVH's flat tree and shape order to disk, and loads it back by
+// mapping the file, so a large fixed scene doesn't have to be rebuilt every launch.
+// Files are named and checked by a hash of everything the build depends on, so a
+// changed scene just misses the cache. The file holds a header, then the flat
+// nodes exactly as they are in memory, then the index of each leaf shape in the
+// scene's shape list. Only the few most recently used files are kept.
+
+class BVHCache
+{
+private:
+	// Mirrors the start of the file. It's 32 bytes, so the nodes after it stay
+	// aligned in the mapping.
+	struct Header
+	{
+		uint magic, version;
+		ullong sceneHash;
+		uint shapeCount, nodeCount, leafCount, reserved;
+	};
+
+	static const uint MAGIC = 0x43485642;
+
+	// 64-bit FNV-1a.
+	static const ullong FNV_OFFSET_BASIS = 14695981039346656037ULL;
+	static const ullong FNV_PRIME = 1099511628211ULL;
+
+	// Bump this whenever the file layout or the BVH builder's output changes.
+	static const uint VERSION = 3;
+
+	// The most cache files kept at once. The index file lists them from least to
+	// most recently used, and the least recent ones are deleted past this.
+	static const int MAX_CACHE_FILES = 8;
+	static const std::string INDEX_FILENAME;
+
+	static void hashBytes(ullong &hash, const void *bytes, size_t count);
+	static void hashVector(ullong &hash, const class Vector3 &v);
+
+	// Checks everything the BVH will index with, so a damaged or hand-edited file
+	// can't make traversal read outside the nodes or the shape list. The shape order
+	// must be a permutation, every node reached from the root must be reached once,
+	// with its children inside the node list, every leaf's shapes must be inside the
+	// shape list, and no leaf may be deeper than the traversal stacks allow.
+	static bool isValidTree(const class BVHFlatNode *nodes, int nodeCount,
+		const uint *shapeOrder, int shapeCount, int leafCount);
+
+	// Moves the file to the most recently used end of the index, and deletes the
+	// least recently used files past the limit.
+	static void touchFile(const std::string &filename);
+public:
+	BVHCache() = delete;
+	BVHCache(const BVHCache&) = delete;
+	~BVHCache() = delete;
+
+	// Hashes the shapes' bounds and centroids in order, which is everything a
+	// default BVH build looks at.
+	static ullong hashScene(const std::vector<class Shape*> &shapes);
+
+	static std::string getFilename(ullong sceneHash);
+
+	// Returns null if there's no valid cache file for the scene.
+	static std::unique_ptr<class BVH> load(const std::vector<class Shape*> &shapes,
+		ullong sceneHash);
+
+	// Returns whether the file was written. The BVH must have been built from the
+	// given shapes.
+	static bool save(const class BVH &bvh, const std::vector<class Shape*> &shapes,
+		ullong sceneHash);
+};
+
+#endif
\ No newline at end of file
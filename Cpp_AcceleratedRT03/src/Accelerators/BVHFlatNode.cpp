@@ -1,58 +1,93 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
 #include "BVHFlatNode.h"
 
 BVHFlatNode::BVHFlatNode()
-	: boundingBox(Vector3(), Vector3())
+	: BVHFlatNode(BoundingBox(Vector3(), Vector3()), 0, 0, 0) { }
+
+BVHFlatNode::BVHFlatNode(const BoundingBox &boundingBox, int startIndex, int numPrimitives,
+	int childOffset)
 {
-	this->startIndex = 0;
-	this->numPrimitives = 0;
-	this->rightOffset = 0;
+	this->setBoundingBox(boundingBox);
+
+	if (childOffset == 0)
+	{
+		this->startOrOffset = static_cast<uint>(startIndex);
+		this->numPrimitives = static_cast<uint>(numPrimitives);
+	}
+	else
+	{
+		this->setChildOffset(childOffset);
+	}
 }
 
-BVHFlatNode::BVHFlatNode(const BoundingBox &boundingBox, int startIndex, int numPrimitives,
-	int rightOffset)
-	: boundingBox(boundingBox)
+BoundingBox BVHFlatNode::getBoundingBox() const
 {
-	this->startIndex = startIndex;
-	this->numPrimitives = numPrimitives;
-	this->rightOffset = rightOffset;
+	return BoundingBox(
+		Vector3(this->minX, this->minY, this->minZ),
+		Vector3(this->maxX, this->maxY, this->maxZ));
 }
 
-const BoundingBox &BVHFlatNode::getBoundingBox() const
+const float *BVHFlatNode::getMinData() const
 {
-	return this->boundingBox;
+	return &this->minX;
+}
+
+const float *BVHFlatNode::getMaxData() const
+{
+	return &this->maxX;
+}
+
+bool BVHFlatNode::isLeaf() const
+{
+	return this->numPrimitives > 0;
 }
 
 int BVHFlatNode::getStartIndex() const
 {
-	return this->startIndex;
+	return this->isLeaf() ? static_cast<int>(this->startOrOffset) : 0;
 }
 
 int BVHFlatNode::getNumPrimitives() const
 {
-	return this->numPrimitives;
+	return static_cast<int>(this->numPrimitives);
 }
 
-int BVHFlatNode::getRightOffset() const
+int BVHFlatNode::getChildOffset() const
 {
-	return this->rightOffset;
+	return this->isLeaf() ? 0 : static_cast<int>(this->startOrOffset);
 }
 
 void BVHFlatNode::setBoundingBox(const BoundingBox &boundingBox)
 {
-	this->boundingBox = boundingBox;
+	this->minX = roundDown(boundingBox.getMin().getX());
+	this->minY = roundDown(boundingBox.getMin().getY());
+	this->minZ = roundDown(boundingBox.getMin().getZ());
+	this->maxX = roundUp(boundingBox.getMax().getX());
+	this->maxY = roundUp(boundingBox.getMax().getY());
+	this->maxZ = roundUp(boundingBox.getMax().getZ());
 }
 
-void BVHFlatNode::setStartIndex(int startIndex)
+void BVHFlatNode::setChildOffset(int childOffset)
 {
-	this->startIndex = startIndex;
+	this->startOrOffset = static_cast<uint>(childOffset);
+	this->numPrimitives = 0;
 }
 
-void BVHFlatNode::setNumPrimitives(int numPrimitives)
+float BVHFlatNode::roundDown(double value)
 {
-	this->numPrimitives = numPrimitives;
+	float rounded = static_cast<float>(std::max(-static_cast<double>(FLT_MAX),
+		std::min(value, static_cast<double>(FLT_MAX))));
+	return (static_cast<double>(rounded) > value) ?
+		std::nextafter(rounded, -FLT_MAX) : rounded;
 }
 
-void BVHFlatNode::setRightOffset(int rightOffset)
+float BVHFlatNode::roundUp(double value)
 {
-	this->rightOffset = rightOffset;
+	float rounded = static_cast<float>(std::max(-static_cast<double>(FLT_MAX),
+		std::min(value, static_cast<double>(FLT_MAX))));
+	return (static_cast<double>(rounded) < value) ?
+		std::nextafter(rounded, FLT_MAX) : rounded;
 }
\ No newline at end of file
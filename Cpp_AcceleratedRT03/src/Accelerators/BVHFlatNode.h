@@ -1,27 +1,53 @@
 #ifndef BVH_FLAT_NODE_H
 #define BVH_FLAT_NODE_H
 
+#include <vector>
+
 #include "BoundingBox.h"
+#include "../Utilities/AlignedAllocator.h"
 #include "../Utilities/Utility.h"
 
-class BVHFlatNode
+// A 32-byte flat tree node, so two of them fit in a cache line. The bounds are
+// floats, rounded outward so they never shrink the box they were made from. A leaf
+// stores its first shape index and shape count. An internal node stores the offset
+// to its children and a count of zero. Trees are built depth first, where that's the
+// offset to the right child and the left child is always the next node. After
+// BVHNodeLayout rearranges the tree, it's the offset to the left child, and the
+// right child is the node after that.
+
+class __declspec(align(32)) BVHFlatNode
 {
 private:
-	BoundingBox boundingBox;
-	int startIndex, numPrimitives, rightOffset;
+	float minX, minY, minZ;
+	uint startOrOffset;
+	float maxX, maxY, maxZ;
+	uint numPrimitives;
+
+	// Round a double to the nearest float that is no greater, or no less, than it.
+	static float roundDown(double value);
+	static float roundUp(double value);
 public:
 	BVHFlatNode();
+
+	// A child offset of zero makes the node a leaf.
 	BVHFlatNode(const BoundingBox &boundingBox, int startIndex, int numPrimitives,
-		int rightOffset);
+		int childOffset);
+
+	BoundingBox getBoundingBox() const;
 
-	const BoundingBox &getBoundingBox() const;
+	// The min and max corners as four floats each, for SSE loads. The fourth float
+	// of each holds the packed index data and isn't meaningful as a bound.
+	const float *getMinData() const;
+	const float *getMaxData() const;
+	bool isLeaf() const;
 	int getStartIndex() const;
 	int getNumPrimitives() const;
-	int getRightOffset() const;
+	int getChildOffset() const;
 	void setBoundingBox(const BoundingBox &boundingBox);
-	void setStartIndex(int startIndex);
-	void setNumPrimitives(int numPrimitives);
-	void setRightOffset(int rightOffset);
+	void setChildOffset(int childOffset);
 };
 
+// Flat trees start on a cache line boundary, so no node straddles two lines.
+typedef std::vector<BVHFlatNode, AlignedAllocator<BVHFlatNode, 64>> BVHFlatNodeArray;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <deque>
+#include <queue>
+#include <utility>
+
+#include "BVHNodeLayout.h"
+
+BVHFlatNodeArray BVHNodeLayout::clusterTreelets(const BVHFlatNodeArray &depthFirstNodes)
+{
+	const int nodeCount = static_cast<int>(depthFirstNodes.size());
+	const int rootIndex = BVHNodeLayout::ROOT_INDEX;
+	if ((nodeCount <= 1) || depthFirstNodes[rootIndex].isLeaf())
+	{
+		return depthFirstNodes;
+	}
+
+	// Each laid out node remembers where it was in the depth-first tree, so its
+	// children can be found when it's opened.
+	BVHFlatNodeArray nodes = BVHFlatNodeArray();
+	std::vector<int> sourceIndices = std::vector<int>();
+	nodes.reserve(nodeCount + 1);
+	sourceIndices.reserve(nodeCount + 1);
+	nodes.push_back(depthFirstNodes[rootIndex]);
+	sourceIndices.push_back(rootIndex);
+	nodes.push_back(BVHFlatNode());
+	sourceIndices.push_back(rootIndex);
+
+	std::deque<int> treeletRoots = std::deque<int>();
+	treeletRoots.push_back(rootIndex);
+
+	while (!treeletRoots.empty())
+	{
+		std::priority_queue<std::pair<double, int>> openable =
+			std::priority_queue<std::pair<double, int>>();
+		openable.push(std::make_pair(0.0, treeletRoots.front()));
+		treeletRoots.pop_front();
+
+		int pairCount = 0;
+		while (!openable.empty() && (pairCount < BVHNodeLayout::PAIRS_PER_TREELET))
+		{
+			const int index = openable.top().second;
+			openable.pop();
+
+			// Append the node's children as a pair, and point the node at them.
+			const int sourceIndex = sourceIndices[index];
+			const int children[] = { sourceIndex + 1,
+				sourceIndex + depthFirstNodes[sourceIndex].getChildOffset() };
+			const int pairIndex = static_cast<int>(nodes.size());
+			nodes[index].setChildOffset(pairIndex - index);
+
+			for (int i = 0; i < 2; i++)
+			{
+				const BVHFlatNode &child = depthFirstNodes[children[i]];
+				nodes.push_back(child);
+				sourceIndices.push_back(children[i]);
+
+				if (!child.isLeaf())
+				{
+					openable.push(std::make_pair(
+						child.getBoundingBox().getSurfaceArea(), pairIndex + i));
+				}
+			}
+
+			pairCount++;
+		}
+
+		// Whatever didn't fit starts its own treelet.
+		while (!openable.empty())
+		{
+			treeletRoots.push_back(openable.top().second);
+			openable.pop();
+		}
+	}
+
+	return nodes;
+}
+
+bool BVHNodeLayout::isPadding(const BVHFlatNode &node)
+{
+	return !node.isLeaf() && (node.getChildOffset() == 0);
+}
\ No newline at end of file
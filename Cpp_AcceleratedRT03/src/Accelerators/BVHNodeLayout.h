@@ -0,0 +1,38 @@
+#ifndef BVH_NODE_LAYOUT_H
+#define BVH_NODE_LAYOUT_H
+
+#include "BVHFlatNode.h"
+#include "../Utilities/Utility.h"
+
+// Rearranges a depth-first flat tree for traversal. Each internal node's two children
+// are stored next to each other on one cache line, so testing both of them only
+// loads one line. The child pairs are then grouped into treelets of about a page
+// each. A treelet grows from its root by always opening its largest node, which is
+// the one most likely to be hit, and the nodes left over start later treelets. Rays
+// then mostly stay within a few pages near the top of the tree, no matter how large
+// the tree is.
+//
+// So that every pair starts on a cache line, the root is followed by an unused
+// padding node with neither shapes nor children.
+
+class BVHNodeLayout
+{
+private:
+	// A 64-byte pair of children per cache line, and 64 lines per 4 KB page.
+	static const int PAIRS_PER_TREELET = 64;
+	static const int ROOT_INDEX = 0;
+public:
+	BVHNodeLayout() = delete;
+	BVHNodeLayout(const BVHNodeLayout&) = delete;
+	~BVHNodeLayout() = delete;
+
+	// Takes a tree where the left child is the next node, and returns one where an
+	// internal node's child offset leads to its left child, with the right child
+	// right after it.
+	static BVHFlatNodeArray clusterTreelets(const BVHFlatNodeArray &depthFirstNodes);
+
+	// Whether the node is the padding after the root.
+	static bool isPadding(const BVHFlatNode &node);
+};
+
+#endif
\ No newline at end of file
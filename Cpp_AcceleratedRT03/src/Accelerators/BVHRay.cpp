@@ -0,0 +1,105 @@
+#include "BVHFlatNode.h"
+#include "BVHRay.h"
+#include "../Rays/Ray.h"
+
+// Node bounds are rounded outward to floats, but the ray isn't, so the far T gets a
+// few ulps of slack to keep rays that graze a node from slipping past it.
+const float BVHRay::FAR_T_SLACK = 1.0000005f;
+
+BVHRay::BVHRay()
+{
+	// Left uninitialized, so an array of them can be declared and filled in later.
+}
+
+BVHRay::BVHRay(const Ray &ray)
+{
+	const Vector3 &point = ray.getPoint();
+	const Vector3 &direction = ray.getDirection();
+
+	// The fourth lane is never read, because node bounds keep packed data there.
+	const __m128 directionData = _mm_set_ps(0.0f,
+		static_cast<float>(direction.getZ()),
+		static_cast<float>(direction.getY()),
+		static_cast<float>(direction.getX()));
+
+	this->origin = _mm_set_ps(0.0f,
+		static_cast<float>(point.getZ()),
+		static_cast<float>(point.getY()),
+		static_cast<float>(point.getX()));
+	this->inverseDirection = _mm_div_ps(_mm_set1_ps(1.0f), directionData);
+
+	// Signs come from the inverse, so a -0 direction matches its -infinity inverse.
+	this->negativeMask = _mm_cmplt_ps(this->inverseDirection, _mm_setzero_ps());
+	this->minT = _mm_set_ss(static_cast<float>(ray.getTMin()));
+}
+
+__m128 BVHRay::maxOfAxes(__m128 t, __m128 initial)
+{
+	// "max_ss" returns its second operand when either one is NaN.
+	__m128 result = _mm_max_ss(t, initial);
+	result = _mm_max_ss(_mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)), result);
+	return _mm_max_ss(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2)), result);
+}
+
+__m128 BVHRay::minOfAxes(__m128 t, __m128 initial)
+{
+	__m128 result = _mm_min_ss(t, initial);
+	result = _mm_min_ss(_mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)), result);
+	return _mm_min_ss(_mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2)), result);
+}
+
+int BVHRay::intersects(const BVHFlatNode &first, const BVHFlatNode &second, float tMax,
+	float *firstNear, float *secondNear) const
+{
+	const __m128 firstMin = _mm_load_ps(first.getMinData());
+	const __m128 firstMax = _mm_load_ps(first.getMaxData());
+	const __m128 secondMin = _mm_load_ps(second.getMinData());
+	const __m128 secondMax = _mm_load_ps(second.getMaxData());
+
+	// Pick each axis' near and far planes from the direction's sign.
+	const __m128 firstNearPlanes = _mm_or_ps(_mm_and_ps(this->negativeMask, firstMax),
+		_mm_andnot_ps(this->negativeMask, firstMin));
+	const __m128 firstFarPlanes = _mm_or_ps(_mm_and_ps(this->negativeMask, firstMin),
+		_mm_andnot_ps(this->negativeMask, firstMax));
+	const __m128 secondNearPlanes = _mm_or_ps(_mm_and_ps(this->negativeMask, secondMax),
+		_mm_andnot_ps(this->negativeMask, secondMin));
+	const __m128 secondFarPlanes = _mm_or_ps(_mm_and_ps(this->negativeMask, secondMin),
+		_mm_andnot_ps(this->negativeMask, secondMax));
+
+	// The ray enters a box at the latest near plane and leaves at the earliest far
+	// plane, clipped to [min T, tMax].
+	const __m128 far = _mm_set_ss(tMax * BVHRay::FAR_T_SLACK);
+
+	const __m128 firstNearT = BVHRay::maxOfAxes(_mm_mul_ps(
+		_mm_sub_ps(firstNearPlanes, this->origin), this->inverseDirection), this->minT);
+	const __m128 firstFarT = BVHRay::minOfAxes(_mm_mul_ps(
+		_mm_sub_ps(firstFarPlanes, this->origin), this->inverseDirection), far);
+	const __m128 secondNearT = BVHRay::maxOfAxes(_mm_mul_ps(
+		_mm_sub_ps(secondNearPlanes, this->origin), this->inverseDirection), this->minT);
+	const __m128 secondFarT = BVHRay::minOfAxes(_mm_mul_ps(
+		_mm_sub_ps(secondFarPlanes, this->origin), this->inverseDirection), far);
+
+	*firstNear = _mm_cvtss_f32(firstNearT);
+	*secondNear = _mm_cvtss_f32(secondNearT);
+
+	return (_mm_comile_ss(firstNearT, firstFarT) ? BVHRay::HIT_FIRST : 0) |
+		(_mm_comile_ss(secondNearT, secondFarT) ? BVHRay::HIT_SECOND : 0);
+}
+
+bool BVHRay::intersects(const BVHFlatNode &node, float tMax) const
+{
+	const __m128 nodeMin = _mm_load_ps(node.getMinData());
+	const __m128 nodeMax = _mm_load_ps(node.getMaxData());
+	const __m128 nearPlanes = _mm_or_ps(_mm_and_ps(this->negativeMask, nodeMax),
+		_mm_andnot_ps(this->negativeMask, nodeMin));
+	const __m128 farPlanes = _mm_or_ps(_mm_and_ps(this->negativeMask, nodeMin),
+		_mm_andnot_ps(this->negativeMask, nodeMax));
+
+	const __m128 nearT = BVHRay::maxOfAxes(_mm_mul_ps(
+		_mm_sub_ps(nearPlanes, this->origin), this->inverseDirection), this->minT);
+	const __m128 farT = BVHRay::minOfAxes(_mm_mul_ps(
+		_mm_sub_ps(farPlanes, this->origin), this->inverseDirection),
+		_mm_set_ss(tMax * BVHRay::FAR_T_SLACK));
+
+	return _mm_comile_ss(nearT, farT) != 0;
+}
\ No newline at end of file
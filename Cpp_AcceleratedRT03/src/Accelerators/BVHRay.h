@@ -0,0 +1,39 @@
+#ifndef BVH_RAY_H
+#define BVH_RAY_H
+
+#include <xmmintrin.h>
+
+#include "../Utilities/Utility.h"
+
+// A ray prepared for testing against BVH node bounds. The inverse direction and the
+// direction's sign masks are computed once per ray, so each slab test is just a few
+// branchless SSE operations with no divisions. Nodes are only hit from the ray's
+// min T onward.
+
+class __declspec(align(16)) BVHRay
+{
+private:
+	__m128 origin, inverseDirection, negativeMask, minT;
+
+	// Reduce the x, y, and z lanes of "t" into the first lane of "initial". If a lane
+	// is NaN (a zero direction component on a plane), then it's ignored.
+	static __m128 maxOfAxes(__m128 t, __m128 initial);
+	static __m128 minOfAxes(__m128 t, __m128 initial);
+public:
+	static const float FAR_T_SLACK;
+	static const int HIT_FIRST = 1;
+	static const int HIT_SECOND = 2;
+
+	BVHRay();
+	BVHRay(const class Ray &ray);
+
+	// Tests the ray against two nodes at once, up to the given max T. Returns a mask
+	// of which nodes were hit, and writes where the ray enters each of them.
+	int intersects(const class BVHFlatNode &first, const class BVHFlatNode &second,
+		float tMax, float *firstNear, float *secondNear) const;
+
+	// Tests the ray against one node, up to the given max T.
+	bool intersects(const class BVHFlatNode &node, float tMax) const;
+};
+
+#endif
\ No newline at end of file
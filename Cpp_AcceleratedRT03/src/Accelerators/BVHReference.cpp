@@ -0,0 +1,17 @@
+#include "BVHReference.h"
+
+BVHReference::BVHReference(const BoundingBox &boundingBox, int shapeIndex)
+{
+	this->boundingBox = boundingBox;
+	this->shapeIndex = shapeIndex;
+}
+
+const BoundingBox &BVHReference::getBoundingBox() const
+{
+	return this->boundingBox;
+}
+
+int BVHReference::getShapeIndex() const
+{
+	return this->shapeIndex;
+}
\ No newline at end of file
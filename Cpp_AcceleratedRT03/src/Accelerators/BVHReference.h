@@ -0,0 +1,23 @@
+#ifndef BVH_REFERENCE_H
+#define BVH_REFERENCE_H
+
+#include "BoundingBox.h"
+#include "../Utilities/Utility.h"
+
+// A reference to one shape during a spatial split build. A shape that straddles a
+// spatial split plane is referenced from both sides, and each reference's box is
+// clipped to its side of the plane.
+
+class BVHReference
+{
+private:
+	BoundingBox boundingBox;
+	int shapeIndex;
+public:
+	BVHReference(const BoundingBox &boundingBox, int shapeIndex);
+
+	const BoundingBox &getBoundingBox() const;
+	int getShapeIndex() const;
+};
+
+#endif
\ No newline at end of file
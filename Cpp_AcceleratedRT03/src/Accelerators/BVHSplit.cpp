@@ -0,0 +1,45 @@
+#include <algorithm>
+
+#include "BVHSplit.h"
+
+BVHSplit::BVHSplit(Axis axis, double axisMin, double binScale, int binCount,
+	int lastLeftBin)
+{
+	this->axis = axis;
+	this->axisMin = axisMin;
+	this->binScale = binScale;
+	this->binCount = binCount;
+	this->lastLeftBin = lastLeftBin;
+}
+
+BVHSplit BVHSplit::leaf()
+{
+	return BVHSplit(Axis::X, 0.0, 0.0, 0, BVHSplit::LEAF_BIN);
+}
+
+BVHSplit BVHSplit::median()
+{
+	return BVHSplit(Axis::X, 0.0, 0.0, 0, BVHSplit::MEDIAN_BIN);
+}
+
+int BVHSplit::binIndex(double coordinate, double axisMin, double binScale, int binCount)
+{
+	return std::max(0, std::min(static_cast<int>((coordinate - axisMin) * binScale),
+		binCount - 1));
+}
+
+bool BVHSplit::isLeaf() const
+{
+	return this->lastLeftBin == BVHSplit::LEAF_BIN;
+}
+
+bool BVHSplit::isMedian() const
+{
+	return this->lastLeftBin == BVHSplit::MEDIAN_BIN;
+}
+
+bool BVHSplit::isLeft(const Vector3 &centroid) const
+{
+	return BVHSplit::binIndex(centroid.getComponent(this->axis), this->axisMin,
+		this->binScale, this->binCount) <= this->lastLeftBin;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef BVH_SPLIT_H
+#define BVH_SPLIT_H
+
+#include "../Math/Vector3.h"
+#include "../Utilities/Utility.h"
+
+// A split plane chosen by a BVH build method. Centroids are binned along the split
+// axis, and every shape whose bin is at or before the "last left bin" goes left. A
+// split can instead say that the node should be a leaf, or that no plane separates
+// the centroids and the shapes should just be halved.
+
+class BVHSplit
+{
+private:
+	Axis axis;
+	double axisMin, binScale;
+	int binCount, lastLeftBin;
+
+	static const int LEAF_BIN = -1;
+	static const int MEDIAN_BIN = -2;
+public:
+	BVHSplit(Axis axis, double axisMin, double binScale, int binCount, int lastLeftBin);
+
+	static BVHSplit leaf();
+	static BVHSplit median();
+	static int binIndex(double coordinate, double axisMin, double binScale, int binCount);
+
+	bool isLeaf() const;
+	bool isMedian() const;
+	bool isLeft(const Vector3 &centroid) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#include "BVH.h"
+#include "BVHFlatNode.h"
+#include "BVHStatistics.h"
+
+BVHStatistics::BVHStatistics(const BVH &bvh)
+{
+	this->leafSizeCounts = std::vector<int>(BVHStatistics::MAX_HISTOGRAM_LEAF_SIZE + 1, 0);
+	this->nodeBytes = 0;
+	this->totalBytes = bvh.getMemoryUsage();
+	this->peakBuildBytes = bvh.getPeakBuildMemory();
+	this->sahCost = bvh.getSAHCost();
+	this->averageLeafDepth = 0.0;
+	this->sampledRays = bvh.getSampledRays();
+	this->averageNodeVisits = (this->sampledRays > 0) ?
+		(static_cast<double>(bvh.getSampledNodeVisits()) /
+		static_cast<double>(this->sampledRays)) : 0.0;
+	this->averagePrimitiveTests = (this->sampledRays > 0) ?
+		(static_cast<double>(bvh.getSampledPrimitiveTests()) /
+		static_cast<double>(this->sampledRays)) : 0.0;
+	this->nodeCount = 0;
+	this->leafCount = 0;
+	this->primitiveCount = 0;
+	this->maxDepth = 0;
+
+	const BVHFlatNodeArray &flatTree = bvh.getFlatTree();
+	this->nodeBytes = flatTree.size() * sizeof(BVHFlatNode);
+	if (flatTree.empty())
+	{
+		return;
+	}
+
+	// Walk down from the root, so only nodes in the tree are counted.
+	std::vector<std::pair<int, int>> toDo = std::vector<std::pair<int, int>>();
+	toDo.push_back(std::make_pair(0, 0));
+
+	const int maxHistogramLeafSize = BVHStatistics::MAX_HISTOGRAM_LEAF_SIZE;
+	double depthSum = 0.0;
+	while (!toDo.empty())
+	{
+		const int index = toDo.back().first;
+		const int depth = toDo.back().second;
+		toDo.pop_back();
+
+		const BVHFlatNode &node = flatTree[index];
+		this->nodeCount++;
+		this->maxDepth = std::max(this->maxDepth, depth);
+
+		if (node.isLeaf())
+		{
+			const int size = node.getNumPrimitives();
+			this->leafCount++;
+			this->primitiveCount += size;
+			this->leafSizeCounts[std::min(size, maxHistogramLeafSize)]++;
+			depthSum += static_cast<double>(depth);
+		}
+		else
+		{
+			const int leftIndex = index + node.getChildOffset();
+			toDo.push_back(std::make_pair(leftIndex, depth + 1));
+			toDo.push_back(std::make_pair(leftIndex + 1, depth + 1));
+		}
+	}
+
+	this->averageLeafDepth = depthSum / static_cast<double>(std::max(this->leafCount, 1));
+}
+
+int BVHStatistics::getNodeCount() const
+{
+	return this->nodeCount;
+}
+
+int BVHStatistics::getLeafCount() const
+{
+	return this->leafCount;
+}
+
+int BVHStatistics::getPrimitiveCount() const
+{
+	return this->primitiveCount;
+}
+
+int BVHStatistics::getMaxDepth() const
+{
+	return this->maxDepth;
+}
+
+double BVHStatistics::getAverageLeafDepth() const
+{
+	return this->averageLeafDepth;
+}
+
+double BVHStatistics::getSAHCost() const
+{
+	return this->sahCost;
+}
+
+size_t BVHStatistics::getNodeBytes() const
+{
+	return this->nodeBytes;
+}
+
+size_t BVHStatistics::getTotalBytes() const
+{
+	return this->totalBytes;
+}
+
+size_t BVHStatistics::getPeakBuildBytes() const
+{
+	return this->peakBuildBytes;
+}
+
+const std::vector<int> &BVHStatistics::getLeafSizeCounts() const
+{
+	return this->leafSizeCounts;
+}
+
+ullong BVHStatistics::getSampledRays() const
+{
+	return this->sampledRays;
+}
+
+double BVHStatistics::getAverageNodeVisits() const
+{
+	return this->averageNodeVisits;
+}
+
+double BVHStatistics::getAveragePrimitiveTests() const
+{
+	return this->averagePrimitiveTests;
+}
+
+std::string BVHStatistics::toString() const
+{
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(2);
+	stream << "nodes " << this->nodeCount << ", leaves " << this->leafCount <<
+		", leaf shapes " << this->primitiveCount << ", max depth " << this->maxDepth <<
+		", average leaf depth " << this->averageLeafDepth << "\n";
+	stream << "SAH cost " << this->sahCost << ", node memory " <<
+		(static_cast<double>(this->nodeBytes) / 1024.0) << " KB, total memory " <<
+		(static_cast<double>(this->totalBytes) / 1024.0) << " KB, peak build memory " <<
+		(static_cast<double>(this->peakBuildBytes) / 1024.0) << " KB\n";
+
+	// Only list the leaf sizes that occur.
+	stream << "leaf sizes:";
+	const int bucketCount = static_cast<int>(this->leafSizeCounts.size());
+	for (int size = 0; size < bucketCount; size++)
+	{
+		if (this->leafSizeCounts[size] > 0)
+		{
+			stream << " " << size << ((size == (bucketCount - 1)) ? "+" : "") << "x" <<
+				this->leafSizeCounts[size];
+		}
+	}
+	stream << "\n";
+
+	stream << "per ray: " << this->averageNodeVisits << " node visits, " <<
+		this->averagePrimitiveTests << " shape tests (" << this->sampledRays <<
+		" rays sampled)\n";
+	return stream.str();
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef BVH_STATISTICS_H
+#define BVH_STATISTICS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "../Utilities/Utility.h"
+
+// A summary of a BVH's shape and how well it has been traversing, for comparing
+// build methods and catching regressions when a scene changes. The tree is walked
+// once when the statistics are made. The traversal averages come from the rays the
+// BVH sampled since it was built or its counters were last reset.
+
+class BVHStatistics
+{
+private:
+	std::vector<int> leafSizeCounts;
+	size_t nodeBytes, totalBytes, peakBuildBytes;
+	double sahCost, averageLeafDepth, averageNodeVisits, averagePrimitiveTests;
+	ullong sampledRays;
+	int nodeCount, leafCount, primitiveCount, maxDepth;
+
+	// Leaves of this size or larger share the last histogram bucket.
+	static const int MAX_HISTOGRAM_LEAF_SIZE = 16;
+public:
+	BVHStatistics(const class BVH &bvh);
+
+	int getNodeCount() const;
+	int getLeafCount() const;
+
+	// Shapes in leaves, counting a shape split between leaves once per leaf.
+	int getPrimitiveCount() const;
+	int getMaxDepth() const;
+	double getAverageLeafDepth() const;
+	double getSAHCost() const;
+	size_t getNodeBytes() const;
+	size_t getTotalBytes() const;
+	size_t getPeakBuildBytes() const;
+
+	// The number of leaves with each shape count, from zero up to the largest
+	// histogram size.
+	const std::vector<int> &getLeafSizeCounts() const;
+
+	ullong getSampledRays() const;
+	double getAverageNodeVisits() const;
+	double getAveragePrimitiveTests() const;
+
+	// A few lines of text for printing.
+	std::string toString() const;
+};
+
+#endif
\ No newline at end of file
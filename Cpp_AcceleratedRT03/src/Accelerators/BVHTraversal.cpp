@@ -1,11 +1,5 @@
 #include "BVHTraversal.h"
 
-BVHTraversal::BVHTraversal()
-{
-	this->index = 0;
-	this->minT = 0;
-}
-
 BVHTraversal::BVHTraversal(int index, double minT)
 {
 	this->index = index;
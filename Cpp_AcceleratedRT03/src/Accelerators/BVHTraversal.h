@@ -9,7 +9,9 @@ private:
 	int index;
 	double minT;
 public:
-	BVHTraversal();
+	// Left uninitialized and trivial, so declaring a traversal stack doesn't call a
+	// constructor for each of its entries on every ray.
+	BVHTraversal() = default;
 	BVHTraversal(int index, double minT);
 
 	int getIndex() const;
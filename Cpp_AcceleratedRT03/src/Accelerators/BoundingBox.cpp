@@ -1,6 +1,17 @@
+#include <algorithm>
+#include <limits>
+
 #include "BoundingBox.h"
 #include "../Rays/Ray.h"
 
+BoundingBox::BoundingBox()
+{
+	const double maxValue = std::numeric_limits<double>::max();
+	this->min = Vector3(maxValue, maxValue, maxValue);
+	this->max = Vector3(-maxValue, -maxValue, -maxValue);
+	this->extent = Vector3();
+}
+
 BoundingBox::BoundingBox(const Vector3 &min, const Vector3 &max)
 {
 	this->min = min;
@@ -8,6 +19,14 @@ BoundingBox::BoundingBox(const Vector3 &min, const Vector3 &max)
 	this->extent = max - min;
 }
 
+Vector3 BoundingBox::withComponent(const Vector3 &v, Axis axis, double value)
+{
+	return Vector3(
+		(axis == Axis::X) ? value : v.getX(),
+		(axis == Axis::Y) ? value : v.getY(),
+		(axis == Axis::Z) ? value : v.getZ());
+}
+
 const Vector3 &BoundingBox::getMin() const
 {
 	return this->min;
@@ -38,6 +57,36 @@ Axis BoundingBox::getLongestAxis() const
 	return axis;
 }
 
+double BoundingBox::getSurfaceArea() const
+{
+	// An empty box has no area, which keeps it from skewing SAH cost estimates.
+	if ((this->min.getX() > this->max.getX()) ||
+		(this->min.getY() > this->max.getY()) ||
+		(this->min.getZ() > this->max.getZ()))
+	{
+		return 0.0;
+	}
+
+	return 2.0 * ((this->extent.getX() * this->extent.getY()) +
+		(this->extent.getY() * this->extent.getZ()) +
+		(this->extent.getZ() * this->extent.getX()));
+}
+
+BoundingBox BoundingBox::getOverlap(const BoundingBox &boundingBox) const
+{
+	return BoundingBox(this->min.componentMax(boundingBox.min),
+		this->max.componentMin(boundingBox.max));
+}
+
+BoundingBox BoundingBox::clippedTo(Axis axis, double axisMin, double axisMax) const
+{
+	return BoundingBox(
+		BoundingBox::withComponent(this->min, axis,
+			std::max(this->min.getComponent(axis), axisMin)),
+		BoundingBox::withComponent(this->max, axis,
+			std::min(this->max.getComponent(axis), axisMax)));
+}
+
 void BoundingBox::expandToInclude(const Vector3 &point)
 {
 	this->min = this->min.componentMin(point);
@@ -55,9 +104,9 @@ void BoundingBox::expandToInclude(const BoundingBox &boundingBox)
 bool BoundingBox::intersects(const Ray &ray, double *tNear, double *tFar) const
 {
 	Vector3 point = this->min + this->extent.scaledBy(0.5);
-	double width = this->max.getX() - this->min.getX();
-	double height = this->max.getY() - this->min.getY();
-	double depth = this->max.getZ() - this->min.getZ();
+	double width = this->extent.getX() * 0.5;
+	double height = this->extent.getY() * 0.5;
+	double depth = this->extent.getZ() * 0.5;
 
 	double nMinX, nMinY, nMinZ, nMaxX, nMaxY, nMaxZ;
 	double tMin, tMax;
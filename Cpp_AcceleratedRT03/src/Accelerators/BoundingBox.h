@@ -8,7 +8,12 @@ class BoundingBox
 {
 private:
 	Vector3 min, max, extent;
+
+	// Returns the vector with one component replaced.
+	static Vector3 withComponent(const Vector3 &v, Axis axis, double value);
 public:
+	// The default box is empty (inverted), so expanding it by anything yields that thing.
+	BoundingBox();
 	BoundingBox(const Vector3 &min, const Vector3 &max);
 
 	const Vector3 &getMin() const;
@@ -16,6 +21,13 @@ public:
 	const Vector3 &getExtent() const;
 	Vector3 getCentroid() const;
 	Axis getLongestAxis() const;
+	double getSurfaceArea() const;
+
+	// The box shared by this box and another, which is empty if they don't touch.
+	BoundingBox getOverlap(const BoundingBox &boundingBox) const;
+
+	// This box limited to the slab [axisMin, axisMax] along the given axis.
+	BoundingBox clippedTo(Axis axis, double axisMin, double axisMax) const;
 	void expandToInclude(const Vector3 &point);
 	void expandToInclude(const BoundingBox &boundingBox);
 	bool intersects(const class Ray &ray, double *tNear, double *tFar) const;
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Grid.h"
+#include "../Intersections/Intersection.h"
+#include "../Rays/Ray.h"
+#include "../Shapes/Shape.h"
+
+const double Grid::CELLS_PER_SHAPE = 2.0;
+
+Grid::Grid(const std::vector<Shape*> &shapes)
+	: Accelerator()
+{
+	this->shapes = std::vector<const Shape*>(shapes.begin(), shapes.end());
+	this->primitives.reserve(shapes.size());
+	this->shapeIndices.reserve(shapes.size());
+
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		this->primitives.push_back(shapes[i]->getPrimitive());
+		this->shapeIndices[shapes[i]] = static_cast<int>(i);
+		this->bounds.expandToInclude(shapes[i]->getBoundingBox());
+	}
+
+	this->chooseResolution();
+	this->fillCells();
+}
+
+Grid::~Grid()
+{
+
+}
+
+void Grid::chooseResolution()
+{
+	if (this->shapes.empty())
+	{
+		this->bounds = BoundingBox(Vector3(), Vector3());
+	}
+
+	// Flat scenes would make the volume zero, so every axis gets some thickness.
+	const Vector3 &extent = this->bounds.getExtent();
+	const double extents[] =
+	{
+		std::max(extent.getX(), Utility::EPSILON),
+		std::max(extent.getY(), Utility::EPSILON),
+		std::max(extent.getZ(), Utility::EPSILON)
+	};
+	const double volume = extents[0] * extents[1] * extents[2];
+	const double shapeCount = std::max(static_cast<double>(this->shapes.size()), 1.0);
+	const double cellsPerUnit = std::cbrt((Grid::CELLS_PER_SHAPE * shapeCount) / volume);
+
+	const Vector3 &min = this->bounds.getMin();
+	this->origin[0] = min.getX();
+	this->origin[1] = min.getY();
+	this->origin[2] = min.getZ();
+
+	// Copied, since "std::min" takes references, which in-class constants don't have.
+	const int maxResolution = Grid::MAX_RESOLUTION;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		this->resolution[axis] = std::max(1, std::min(maxResolution,
+			static_cast<int>(extents[axis] * cellsPerUnit)));
+		this->cellSizes[axis] = extents[axis] / static_cast<double>(this->resolution[axis]);
+		this->inverseCellSizes[axis] = 1.0 / this->cellSizes[axis];
+	}
+}
+
+void Grid::getCellRange(const BoundingBox &box, int *minCells, int *maxCells) const
+{
+	const double mins[] = { box.getMin().getX(), box.getMin().getY(), box.getMin().getZ() };
+	const double maxs[] = { box.getMax().getX(), box.getMax().getY(), box.getMax().getZ() };
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const int lastCell = this->resolution[axis] - 1;
+		minCells[axis] = std::max(0, std::min(lastCell, static_cast<int>(std::floor(
+			(mins[axis] - this->origin[axis]) * this->inverseCellSizes[axis]))));
+		maxCells[axis] = std::max(0, std::min(lastCell, static_cast<int>(std::floor(
+			(maxs[axis] - this->origin[axis]) * this->inverseCellSizes[axis]))));
+	}
+}
+
+void Grid::fillCells()
+{
+	const int cellCount = this->resolution[0] * this->resolution[1] * this->resolution[2];
+	const int rowSize = this->resolution[0];
+	const int sliceSize = this->resolution[0] * this->resolution[1];
+	const int shapeCount = static_cast<int>(this->shapes.size());
+
+	// The first pass counts each cell's shapes, and the second writes them out after
+	// the counts are turned into start offsets.
+	std::vector<int> cellRanges = std::vector<int>(shapeCount * 6);
+	this->cellStarts.assign(cellCount + 1, 0);
+
+	for (int i = 0; i < shapeCount; i++)
+	{
+		int *minCells = &cellRanges[i * 6];
+		int *maxCells = minCells + 3;
+		this->getCellRange(this->shapes[i]->getBoundingBox(), minCells, maxCells);
+
+		for (int z = minCells[2]; z <= maxCells[2]; z++)
+		{
+			for (int y = minCells[1]; y <= maxCells[1]; y++)
+			{
+				for (int x = minCells[0]; x <= maxCells[0]; x++)
+				{
+					this->cellStarts[x + (y * rowSize) + (z * sliceSize) + 1]++;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < cellCount; i++)
+	{
+		this->cellStarts[i + 1] += this->cellStarts[i];
+	}
+
+	std::vector<int> cellEnds = std::vector<int>(
+		this->cellStarts.begin(), this->cellStarts.end() - 1);
+	this->cellPrimitives.resize(this->cellStarts[cellCount]);
+
+	for (int i = 0; i < shapeCount; i++)
+	{
+		const int *minCells = &cellRanges[i * 6];
+		const int *maxCells = minCells + 3;
+
+		for (int z = minCells[2]; z <= maxCells[2]; z++)
+		{
+			for (int y = minCells[1]; y <= maxCells[1]; y++)
+			{
+				for (int x = minCells[0]; x <= maxCells[0]; x++)
+				{
+					const int cell = x + (y * rowSize) + (z * sliceSize);
+					this->cellPrimitives[cellEnds[cell]] = i;
+					cellEnds[cell]++;
+				}
+			}
+		}
+	}
+}
+
+bool Grid::traverse(const Ray &ray, bool anyHit, Intersection *nearest) const
+{
+	double tNear, tFar;
+	if (this->shapes.empty() || !this->bounds.intersects(ray, &tNear, &tFar) ||
+		(tFar < ray.getTMin()))
+	{
+		return false;
+	}
+
+	const double tMax = ray.getTMax();
+	tNear = std::max(tNear, ray.getTMin());
+	if (tNear >= tMax)
+	{
+		return false;
+	}
+
+	// Set up the walk from the cell where the ray enters the grid. "nextTs" are where
+	// the ray crosses into the next cell on each axis, and "deltaTs" are how far
+	// apart those crossings are.
+	const Vector3 entry = ray.pointAt(tNear);
+	const double entries[] = { entry.getX(), entry.getY(), entry.getZ() };
+	const double directions[] =
+	{
+		ray.getDirection().getX(), ray.getDirection().getY(), ray.getDirection().getZ()
+	};
+
+	int cells[3], steps[3], ends[3];
+	double nextTs[3], deltaTs[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		cells[axis] = std::max(0, std::min(this->resolution[axis] - 1,
+			static_cast<int>(std::floor((entries[axis] - this->origin[axis]) *
+			this->inverseCellSizes[axis]))));
+
+		if (directions[axis] > 0.0)
+		{
+			const double plane = this->origin[axis] +
+				(static_cast<double>(cells[axis] + 1) * this->cellSizes[axis]);
+			steps[axis] = 1;
+			ends[axis] = this->resolution[axis];
+			nextTs[axis] = tNear + ((plane - entries[axis]) / directions[axis]);
+			deltaTs[axis] = this->cellSizes[axis] / directions[axis];
+		}
+		else if (directions[axis] < 0.0)
+		{
+			const double plane = this->origin[axis] +
+				(static_cast<double>(cells[axis]) * this->cellSizes[axis]);
+			steps[axis] = -1;
+			ends[axis] = -1;
+			nextTs[axis] = tNear + ((plane - entries[axis]) / directions[axis]);
+			deltaTs[axis] = -this->cellSizes[axis] / directions[axis];
+		}
+		else
+		{
+			steps[axis] = 0;
+			ends[axis] = -1;
+			nextTs[axis] = std::numeric_limits<double>::infinity();
+			deltaTs[axis] = std::numeric_limits<double>::infinity();
+		}
+	}
+
+	const int rowSize = this->resolution[0];
+	const int sliceSize = this->resolution[0] * this->resolution[1];
+	double nearestT = tMax;
+	bool hit = false;
+
+	while (true)
+	{
+		const int cell = cells[0] + (cells[1] * rowSize) + (cells[2] * sliceSize);
+		for (int i = this->cellStarts[cell]; i < this->cellStarts[cell + 1]; i++)
+		{
+			const Intersection currentTry =
+				this->primitives[this->cellPrimitives[i]].hit(ray);
+
+			if (currentTry.getT() < nearestT)
+			{
+				if (anyHit)
+				{
+					return true;
+				}
+
+				nearestT = currentTry.getT();
+				*nearest = currentTry;
+				hit = true;
+			}
+		}
+
+		// A shape can stick out of this cell, so its hit is only certain to be the
+		// nearest once the walk has passed it.
+		const int axis = (nextTs[0] < nextTs[1]) ?
+			((nextTs[0] < nextTs[2]) ? 0 : 2) :
+			((nextTs[1] < nextTs[2]) ? 1 : 2);
+		if (nextTs[axis] >= nearestT)
+		{
+			break;
+		}
+
+		cells[axis] += steps[axis];
+		if (cells[axis] == ends[axis])
+		{
+			break;
+		}
+
+		nextTs[axis] += deltaTs[axis];
+	}
+
+	return hit;
+}
+
+Intersection Grid::nearestHit(const Ray &ray) const
+{
+	Intersection nearest = Intersection();
+	this->traverse(ray, false, &nearest);
+	return nearest;
+}
+
+bool Grid::occluded(const Ray &ray) const
+{
+	return this->traverse(ray, true, nullptr);
+}
+
+bool Grid::refit(const std::vector<const Shape*> &movedShapes)
+{
+	const Vector3 &min = this->bounds.getMin();
+	const Vector3 &max = this->bounds.getMax();
+
+	for (const Shape *shape : movedShapes)
+	{
+		std::unordered_map<const Shape*, int>::const_iterator iter =
+			this->shapeIndices.find(shape);
+		if (iter == this->shapeIndices.end())
+		{
+			continue;
+		}
+
+		const BoundingBox box = shape->getBoundingBox();
+		if ((box.getMin().getX() < min.getX()) || (box.getMin().getY() < min.getY()) ||
+			(box.getMin().getZ() < min.getZ()) || (box.getMax().getX() > max.getX()) ||
+			(box.getMax().getY() > max.getY()) || (box.getMax().getZ() > max.getZ()))
+		{
+			return false;
+		}
+
+		this->primitives[iter->second] = shape->getPrimitive();
+	}
+
+	this->fillCells();
+	return true;
+}
+
+size_t Grid::getMemoryUsage() const
+{
+	return (this->primitives.capacity() * sizeof(Primitive)) +
+		(this->cellStarts.capacity() * sizeof(int)) +
+		(this->cellPrimitives.capacity() * sizeof(int));
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "Accelerator.h"
+#include "BoundingBox.h"
+#include "../Shapes/Primitive.h"
+
+// A uniform grid over the shapes' bounds, with about "CELLS_PER_SHAPE" cells for
+// each shape. A shape is listed in every cell its bounding box overlaps. Rays step
+// through the cells in order (3D DDA), so a hit found inside the current cell ends
+// the search. Building is just two linear passes, so moved shapes are handled by
+// refilling the cells instead of rebuilding.
+
+class Grid : public Accelerator
+{
+private:
+	std::vector<const class Shape*> shapes;
+	std::vector<Primitive> primitives;
+	std::unordered_map<const class Shape*, int> shapeIndices;
+
+	// Each cell's primitive indices are at [cellStarts[i], cellStarts[i + 1]) in
+	// "cellPrimitives".
+	std::vector<int> cellStarts;
+	std::vector<int> cellPrimitives;
+
+	BoundingBox bounds;
+	double origin[3], cellSizes[3], inverseCellSizes[3];
+	int resolution[3];
+
+	static const int MAX_RESOLUTION = 128;
+	static const double CELLS_PER_SHAPE;
+
+	// Picks the cell counts from the bounds and the shape count.
+	void chooseResolution();
+
+	// Refills every cell from the current shape bounds.
+	void fillCells();
+
+	// Gets the inclusive range of cells a box overlaps on each axis.
+	void getCellRange(const BoundingBox &box, int *minCells, int *maxCells) const;
+
+	// Steps through the cells the ray passes within its T interval. With "anyHit",
+	// it stops at the first hit and doesn't write an intersection. Returns whether
+	// anything was hit.
+	bool traverse(const class Ray &ray, bool anyHit, class Intersection *nearest) const;
+public:
+	Grid(const std::vector<class Shape*> &shapes);
+	virtual ~Grid();
+
+	virtual class Intersection nearestHit(const class Ray &ray) const override;
+	virtual bool occluded(const class Ray &ray) const override;
+
+	// Moved shapes are put back in the cells they now overlap. Returns false if one
+	// of them left the grid's bounds, since the grid would have to grow.
+	virtual bool refit(const std::vector<const class Shape*> &movedShapes) override;
+	virtual size_t getMemoryUsage() const override;
+};
+
+#endif
\ No newline at end of file
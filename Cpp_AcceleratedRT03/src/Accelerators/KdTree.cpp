@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cmath>
+
+#include "KdTree.h"
+#include "../Intersections/Intersection.h"
+#include "../Rays/Ray.h"
+#include "../Shapes/Shape.h"
+
+const double KdTree::SAH_TRAVERSAL_COST = 1.0;
+const double KdTree::SAH_INTERSECTION_COST = 80.0;
+const double KdTree::SAH_EMPTY_BONUS = 0.5;
+
+KdTree::KdTree(const std::vector<Shape*> &shapes)
+	: Accelerator()
+{
+	const int shapeCount = static_cast<int>(shapes.size());
+	if (shapeCount == 0)
+	{
+		return;
+	}
+
+	std::vector<double> shapeBounds = std::vector<double>(shapeCount * 6);
+	std::vector<int> shapeIndices = std::vector<int>(shapeCount);
+	for (int i = 0; i < shapeCount; i++)
+	{
+		const BoundingBox box = shapes[i]->getBoundingBox();
+		double *bounds = &shapeBounds[i * 6];
+		bounds[0] = box.getMin().getX();
+		bounds[1] = box.getMin().getY();
+		bounds[2] = box.getMin().getZ();
+		bounds[3] = box.getMax().getX();
+		bounds[4] = box.getMax().getY();
+		bounds[5] = box.getMax().getZ();
+		shapeIndices[i] = i;
+		this->bounds.expandToInclude(box);
+	}
+
+	const double nodeBounds[] =
+	{
+		this->bounds.getMin().getX(), this->bounds.getMin().getY(),
+		this->bounds.getMin().getZ(), this->bounds.getMax().getX(),
+		this->bounds.getMax().getY(), this->bounds.getMax().getZ()
+	};
+
+	// The usual depth limit for kd-trees, which grows with the log of the shapes.
+	const int maxDepth = std::min(KdTree::MAX_KD_TRAVERSAL_TO_DO - 1,
+		static_cast<int>(8.0 + (1.3 * std::log2(static_cast<double>(shapeCount)))));
+
+	std::vector<std::pair<double, int>> edges = std::vector<std::pair<double, int>>();
+	edges.reserve(shapeCount * 2);
+	this->buildNode(shapes, shapeBounds, nodeBounds, shapeIndices, maxDepth, 0, edges);
+}
+
+KdTree::~KdTree()
+{
+
+}
+
+void KdTree::buildNode(const std::vector<Shape*> &shapes,
+	const std::vector<double> &shapeBounds, const double *nodeBounds,
+	const std::vector<int> &shapeIndices, int depth, int badRefines,
+	std::vector<std::pair<double, int>> &edges)
+{
+	const int nodeIndex = static_cast<int>(this->nodes.size());
+	const int shapeCount = static_cast<int>(shapeIndices.size());
+	this->nodes.push_back(KdTreeNode());
+
+	// Find the cheapest split plane among the shapes' bounds, trying the longest
+	// axis first and only moving on if it has no plane inside the node.
+	const double extents[] =
+	{
+		nodeBounds[3] - nodeBounds[0],
+		nodeBounds[4] - nodeBounds[1],
+		nodeBounds[5] - nodeBounds[2]
+	};
+	const double inverseArea = 1.0 / std::max(2.0 * ((extents[0] * extents[1]) +
+		(extents[1] * extents[2]) + (extents[2] * extents[0])), Utility::EPSILON);
+	const double leafCost = KdTree::SAH_INTERSECTION_COST * static_cast<double>(shapeCount);
+
+	double bestCost = leafCost;
+	double bestSplit = 0.0;
+	int bestAxis = -1;
+
+	int axis = (extents[0] > extents[1]) ?
+		((extents[0] > extents[2]) ? 0 : 2) :
+		((extents[1] > extents[2]) ? 1 : 2);
+	for (int tries = 0; (shapeCount > KdTree::MAX_KD_LEAF_SIZE) && (depth > 0) &&
+		(tries < 3) && (bestAxis == -1); tries++)
+	{
+		// Starts are numbered below ends, so at the same coordinate a start comes
+		// first.
+		edges.clear();
+		for (int i = 0; i < shapeCount; i++)
+		{
+			const double *bounds = &shapeBounds[shapeIndices[i] * 6];
+			edges.push_back(std::make_pair(bounds[axis], i));
+			edges.push_back(std::make_pair(bounds[axis + 3], shapeCount + i));
+		}
+
+		std::sort(edges.begin(), edges.end());
+
+		const int otherAxis1 = (axis + 1) % 3;
+		const int otherAxis2 = (axis + 2) % 3;
+		const double capArea = 2.0 * extents[otherAxis1] * extents[otherAxis2];
+		const double sideLength = extents[otherAxis1] + extents[otherAxis2];
+
+		int belowCount = 0;
+		int aboveCount = shapeCount;
+		for (const std::pair<double, int> &edge : edges)
+		{
+			const bool isEnd = edge.second >= shapeCount;
+			if (isEnd)
+			{
+				aboveCount--;
+			}
+
+			// Planes are stored as floats, so they're judged as floats too. Otherwise a
+			// plane could round onto the node's own bound and split it forever.
+			const double t = static_cast<double>(static_cast<float>(edge.first));
+			if ((t > nodeBounds[axis]) && (t < nodeBounds[axis + 3]))
+			{
+				const double belowArea = capArea +
+					(2.0 * (t - nodeBounds[axis]) * sideLength);
+				const double aboveArea = capArea +
+					(2.0 * (nodeBounds[axis + 3] - t) * sideLength);
+				const double emptyBonus = ((belowCount == 0) || (aboveCount == 0)) ?
+					KdTree::SAH_EMPTY_BONUS : 0.0;
+				const double cost = KdTree::SAH_TRAVERSAL_COST +
+					(KdTree::SAH_INTERSECTION_COST * (1.0 - emptyBonus) * inverseArea *
+					((belowArea * belowCount) + (aboveArea * aboveCount)));
+
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = t;
+					bestAxis = axis;
+				}
+			}
+
+			if (!isEnd)
+			{
+				belowCount++;
+			}
+		}
+
+		axis = (axis + 1) % 3;
+	}
+
+	// Give up on splits that cost more than they save a few times in a row, since
+	// a later split might still make up for it.
+	if (bestCost > leafCost)
+	{
+		badRefines++;
+	}
+
+	if ((bestAxis == -1) || (badRefines == KdTree::MAX_KD_BAD_REFINES) ||
+		((bestCost > (4.0 * leafCost)) && (shapeCount < 16)))
+	{
+		const int start = static_cast<int>(this->leafPrimitives.size());
+		for (const int shapeIndex : shapeIndices)
+		{
+			this->leafPrimitives.push_back(shapes[shapeIndex]->getPrimitive());
+		}
+
+		this->nodes[nodeIndex] = KdTreeNode::leaf(start, shapeCount);
+		return;
+	}
+
+	// Anything touching the plane goes on both sides.
+	const float split = static_cast<float>(bestSplit);
+	const double plane = bestSplit;
+	std::vector<int> belowShapes = std::vector<int>();
+	std::vector<int> aboveShapes = std::vector<int>();
+	for (const int shapeIndex : shapeIndices)
+	{
+		const double *bounds = &shapeBounds[shapeIndex * 6];
+		if (bounds[bestAxis] <= plane)
+		{
+			belowShapes.push_back(shapeIndex);
+		}
+		if (bounds[bestAxis + 3] >= plane)
+		{
+			aboveShapes.push_back(shapeIndex);
+		}
+	}
+
+	double belowBounds[6], aboveBounds[6];
+	std::copy(nodeBounds, nodeBounds + 6, belowBounds);
+	std::copy(nodeBounds, nodeBounds + 6, aboveBounds);
+	belowBounds[bestAxis + 3] = plane;
+	aboveBounds[bestAxis] = plane;
+
+	this->buildNode(shapes, shapeBounds, belowBounds, belowShapes, depth - 1,
+		badRefines, edges);
+
+	const int aboveChild = static_cast<int>(this->nodes.size());
+	this->nodes[nodeIndex] = KdTreeNode::internal(bestAxis, split, aboveChild);
+
+	this->buildNode(shapes, shapeBounds, aboveBounds, aboveShapes, depth - 1,
+		badRefines, edges);
+}
+
+bool KdTree::traverse(const Ray &ray, bool anyHit, Intersection *nearest) const
+{
+	double tNear, tFar;
+	if (this->nodes.empty() || !this->bounds.intersects(ray, &tNear, &tFar) ||
+		(tFar < ray.getTMin()))
+	{
+		return false;
+	}
+
+	const double origins[] =
+	{
+		ray.getPoint().getX(), ray.getPoint().getY(), ray.getPoint().getZ()
+	};
+	const double directions[] =
+	{
+		ray.getDirection().getX(), ray.getDirection().getY(), ray.getDirection().getZ()
+	};
+	const double inverseDirections[] =
+	{
+		1.0 / directions[0], 1.0 / directions[1], 1.0 / directions[2]
+	};
+
+	// Nodes still to visit, with the T range the ray spends inside each of them.
+	int workNodes[KdTree::MAX_KD_TRAVERSAL_TO_DO];
+	double workMinTs[KdTree::MAX_KD_TRAVERSAL_TO_DO];
+	double workMaxTs[KdTree::MAX_KD_TRAVERSAL_TO_DO];
+	int stackIndex = -1;
+
+	int nodeIndex = 0;
+	double nodeMinT = std::max(tNear, ray.getTMin());
+	double nodeMaxT = tFar;
+	double nearestT = ray.getTMax();
+	bool hit = false;
+
+	while (true)
+	{
+		// Nothing in this node can beat the nearest hit so far.
+		if (nearestT < nodeMinT)
+		{
+			break;
+		}
+
+		const KdTreeNode &node = this->nodes[nodeIndex];
+		if (!node.isLeaf())
+		{
+			// Visit the child on the ray origin's side of the plane first, and the
+			// other one only if the ray crosses the plane inside this node.
+			const int axis = node.getAxis();
+			const double split = static_cast<double>(node.getSplit());
+			const double planeT = (split - origins[axis]) * inverseDirections[axis];
+			const bool belowFirst = (origins[axis] < split) ||
+				((origins[axis] == split) && (directions[axis] <= 0.0));
+			const int firstChild = belowFirst ? (nodeIndex + 1) : node.getAboveChild();
+			const int secondChild = belowFirst ? node.getAboveChild() : (nodeIndex + 1);
+
+			if ((planeT > nodeMaxT) || (planeT <= 0.0))
+			{
+				nodeIndex = firstChild;
+			}
+			else if (planeT < nodeMinT)
+			{
+				nodeIndex = secondChild;
+			}
+			else
+			{
+				stackIndex++;
+				workNodes[stackIndex] = secondChild;
+				workMinTs[stackIndex] = planeT;
+				workMaxTs[stackIndex] = nodeMaxT;
+				nodeIndex = firstChild;
+				nodeMaxT = planeT;
+			}
+		}
+		else
+		{
+			const int start = node.getPrimitiveStart();
+			const int end = start + node.getNumPrimitives();
+			for (int i = start; i < end; i++)
+			{
+				const Intersection currentTry = this->leafPrimitives[i].hit(ray);
+
+				if (currentTry.getT() < nearestT)
+				{
+					if (anyHit)
+					{
+						return true;
+					}
+
+					nearestT = currentTry.getT();
+					*nearest = currentTry;
+					hit = true;
+				}
+			}
+
+			if (stackIndex < 0)
+			{
+				break;
+			}
+
+			nodeIndex = workNodes[stackIndex];
+			nodeMinT = workMinTs[stackIndex];
+			nodeMaxT = workMaxTs[stackIndex];
+			stackIndex--;
+		}
+	}
+
+	return hit;
+}
+
+Intersection KdTree::nearestHit(const Ray &ray) const
+{
+	Intersection nearest = Intersection();
+	this->traverse(ray, false, &nearest);
+	return nearest;
+}
+
+bool KdTree::occluded(const Ray &ray) const
+{
+	return this->traverse(ray, true, nullptr);
+}
+
+size_t KdTree::getMemoryUsage() const
+{
+	return (this->nodes.capacity() * sizeof(KdTreeNode)) +
+		(this->leafPrimitives.capacity() * sizeof(Primitive));
+}
\ No newline at end of file
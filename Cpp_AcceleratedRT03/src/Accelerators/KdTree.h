@@ -0,0 +1,56 @@
+#ifndef KD_TREE_H
+#define KD_TREE_H
+
+#include <utility>
+#include <vector>
+
+#include "Accelerator.h"
+#include "BoundingBox.h"
+#include "KdTreeNode.h"
+#include "../Shapes/Primitive.h"
+
+// A kd-tree built with the surface area heuristic. Every internal node splits space
+// with an axis-aligned plane, so a ray visits the leaves it passes in order and can
+// stop at the first leaf with a hit inside it. A shape that straddles a plane is
+// listed on both sides, which makes the build slower and the tree bigger than a BVH,
+// so it suits static scenes. It can't be refit.
+
+class KdTree : public Accelerator
+{
+private:
+	std::vector<KdTreeNode> nodes;
+
+	// Each leaf's primitives are copied into one range, so a shape in several
+	// leaves has several copies.
+	std::vector<Primitive> leafPrimitives;
+	BoundingBox bounds;
+
+	static const int MAX_KD_LEAF_SIZE = 1;
+	static const int MAX_KD_BAD_REFINES = 3;
+	static const int MAX_KD_TRAVERSAL_TO_DO = 64;
+	static const double SAH_TRAVERSAL_COST;
+	static const double SAH_INTERSECTION_COST;
+	static const double SAH_EMPTY_BONUS;
+
+	// Appends the node for the given shapes and the subtree under it. The shape
+	// bounds are six doubles per shape (min x, y, z, max x, y, z), and so are the
+	// node bounds.
+	void buildNode(const std::vector<class Shape*> &shapes,
+		const std::vector<double> &shapeBounds, const double *nodeBounds,
+		const std::vector<int> &shapeIndices, int depth, int badRefines,
+		std::vector<std::pair<double, int>> &edges);
+
+	// Visits the leaves the ray passes within its T interval, in order. With
+	// "anyHit", it stops at the first hit and doesn't write an intersection. Returns
+	// whether anything was hit.
+	bool traverse(const class Ray &ray, bool anyHit, class Intersection *nearest) const;
+public:
+	KdTree(const std::vector<class Shape*> &shapes);
+	virtual ~KdTree();
+
+	virtual class Intersection nearestHit(const class Ray &ray) const override;
+	virtual bool occluded(const class Ray &ray) const override;
+	virtual size_t getMemoryUsage() const override;
+};
+
+#endif
\ No newline at end of file
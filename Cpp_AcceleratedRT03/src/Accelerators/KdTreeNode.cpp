@@ -0,0 +1,58 @@
+#include "KdTreeNode.h"
+
+KdTreeNode::KdTreeNode()
+{
+	this->primitiveStart = 0;
+	this->flags = KdTreeNode::LEAF_FLAG;
+}
+
+KdTreeNode KdTreeNode::internal(int axis, float split, int aboveChild)
+{
+	KdTreeNode node;
+	node.split = split;
+	node.flags = static_cast<uint>(axis) | (static_cast<uint>(aboveChild) << 2);
+	return node;
+}
+
+KdTreeNode KdTreeNode::leaf(int primitiveStart, int numPrimitives)
+{
+	KdTreeNode node;
+	node.primitiveStart = static_cast<uint>(primitiveStart);
+	node.flags = KdTreeNode::LEAF_FLAG | (static_cast<uint>(numPrimitives) << 2);
+	return node;
+}
+
+bool KdTreeNode::isLeaf() const
+{
+	return (this->flags & 3) == KdTreeNode::LEAF_FLAG;
+}
+
+int KdTreeNode::getAxis() const
+{
+	return static_cast<int>(this->flags & 3);
+}
+
+float KdTreeNode::getSplit() const
+{
+	return this->split;
+}
+
+int KdTreeNode::getAboveChild() const
+{
+	return static_cast<int>(this->flags >> 2);
+}
+
+int KdTreeNode::getPrimitiveStart() const
+{
+	return static_cast<int>(this->primitiveStart);
+}
+
+int KdTreeNode::getNumPrimitives() const
+{
+	return static_cast<int>(this->flags >> 2);
+}
+
+void KdTreeNode::setAboveChild(int aboveChild)
+{
+	this->flags = (this->flags & 3) | (static_cast<uint>(aboveChild) << 2);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef KD_TREE_NODE_H
+#define KD_TREE_NODE_H
+
+#include "../Utilities/Utility.h"
+
+// An 8-byte kd-tree node. The low two bits of "flags" are the split axis, or three
+// for a leaf, and the rest are the above child's index or the leaf's primitive
+// count. The below child of an internal node is always the next node.
+
+class KdTreeNode
+{
+private:
+	union
+	{
+		float split;
+		uint primitiveStart;
+	};
+	uint flags;
+
+	static const uint LEAF_FLAG = 3;
+public:
+	KdTreeNode();
+
+	static KdTreeNode internal(int axis, float split, int aboveChild);
+	static KdTreeNode leaf(int primitiveStart, int numPrimitives);
+
+	bool isLeaf() const;
+	int getAxis() const;
+	float getSplit() const;
+	int getAboveChild() const;
+	int getPrimitiveStart() const;
+	int getNumPrimitives() const;
+	void setAboveChild(int aboveChild);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <utility>
+
+#include "BVHRay.h"
+#include "BVHSplit.h"
+#include "BVHTraversal.h"
+#include "LazyBVH.h"
+#include "../Intersections/Intersection.h"
+#include "../Rays/Ray.h"
+#include "../Shapes/Shape.h"
+
+const double LazyBVH::MAX_REFIT_AREA_RATIO = 1.5;
+
+LazyBVH::LazyBVH(const std::vector<Shape*> &shapes)
+	: nodes(2 * static_cast<int>(shapes.size())),
+	states(2 * static_cast<int>(shapes.size())),
+	depths(2 * static_cast<int>(shapes.size())),
+	primitives(static_cast<int>(shapes.size()))
+{
+	const int shapeCount = static_cast<int>(shapes.size());
+	this->shapes = std::vector<const Shape*>(shapes.begin(), shapes.end());
+	this->shapeBoxes = std::vector<BoundingBox>(shapeCount);
+	this->centroids = std::vector<Vector3>(shapeCount);
+	this->shapeOrder = std::vector<uint>(shapeCount);
+	this->shapePositions = std::vector<int>(shapeCount);
+	this->shapeIndices = std::unordered_map<const Shape*, int>();
+	this->builtArea = 0.0;
+	this->refitAreaGrowth = 0.0;
+	this->refitNodeCount = 0;
+	this->nodeCount = LazyBVH::FIRST_CHILD_INDEX;
+
+	// This pass is the only work done up front.
+#pragma omp parallel for
+	for (int i = 0; i < shapeCount; i++)
+	{
+		this->shapeBoxes[i] = shapes[i]->getBoundingBox();
+		this->centroids[i] = shapes[i]->getCentroid();
+		this->shapeOrder[i] = static_cast<uint>(i);
+		this->shapePositions[i] = i;
+	}
+
+	if (shapeCount > 0)
+	{
+		this->writeNode(LazyBVH::ROOT_INDEX, 0, shapeCount, 0);
+	}
+}
+
+LazyBVH::~LazyBVH()
+{
+
+}
+
+int LazyBVH::getNumNodes() const
+{
+	// Not counting the unused node after the root.
+	return this->shapes.empty() ? 0 : (this->nodeCount.load() - 1);
+}
+
+void LazyBVH::writeNode(int nodeIndex, int start, int count, int depth) const
+{
+	const int end = start + count;
+	BoundingBox nodeBox = BoundingBox();
+	for (int i = start; i < end; i++)
+	{
+		nodeBox.expandToInclude(this->shapeBoxes[this->shapeOrder[i]]);
+	}
+
+	this->nodes.at(nodeIndex) = BVHFlatNode(nodeBox, start, count, 0);
+	this->depths.at(nodeIndex) = depth;
+
+	// Nothing reads these until the node is published, so plain stores will do.
+	if (count <= LazyBVH::MAX_LEAF_SIZE)
+	{
+		for (int i = start; i < end; i++)
+		{
+			this->primitives.at(i) = this->shapes[this->shapeOrder[i]]->getPrimitive();
+		}
+
+		this->states.at(nodeIndex).store(LazyBVH::LEAF, std::memory_order_relaxed);
+	}
+	else
+	{
+		this->states.at(nodeIndex).store(LazyBVH::UNSPLIT, std::memory_order_relaxed);
+	}
+}
+
+BVHSplit LazyBVH::chooseSplit(int start, int end, int depth) const
+{
+	if (depth >= LazyBVH::MAX_SPLIT_DEPTH)
+	{
+		return BVHSplit::median();
+	}
+
+	BoundingBox centroidBox = BoundingBox();
+	for (int i = start; i < end; i++)
+	{
+		centroidBox.expandToInclude(this->centroids[this->shapeOrder[i]]);
+	}
+
+	const Axis axis = centroidBox.getLongestAxis();
+	const double axisExtent = centroidBox.getExtent().getComponent(axis);
+	if (axisExtent <= 0.0)
+	{
+		return BVHSplit::median();
+	}
+
+	const double axisMin = centroidBox.getMin().getComponent(axis);
+	const double binScale = static_cast<double>(LazyBVH::BIN_COUNT) / axisExtent;
+
+	int binCounts[LazyBVH::BIN_COUNT];
+	BoundingBox binBoxes[LazyBVH::BIN_COUNT];
+	std::fill(binCounts, binCounts + LazyBVH::BIN_COUNT, 0);
+
+	for (int i = start; i < end; i++)
+	{
+		const uint shapeIndex = this->shapeOrder[i];
+		const int bin = BVHSplit::binIndex(this->centroids[shapeIndex].getComponent(axis),
+			axisMin, binScale, LazyBVH::BIN_COUNT);
+		binCounts[bin]++;
+		binBoxes[bin].expandToInclude(this->shapeBoxes[shapeIndex]);
+	}
+
+	// Sweep from the right to get the area of everything right of each plane.
+	double rightAreas[LazyBVH::BIN_COUNT];
+	BoundingBox rightBox = BoundingBox();
+	for (int bin = LazyBVH::BIN_COUNT - 1; bin > 0; bin--)
+	{
+		rightBox.expandToInclude(binBoxes[bin]);
+		rightAreas[bin] = rightBox.getSurfaceArea();
+	}
+
+	// Then sweep from the left, evaluating the plane after each bin. The traversal
+	// and intersection costs are the same for every plane, so only areas matter.
+	const int count = end - start;
+	BoundingBox leftBox = BoundingBox();
+	int leftCount = 0;
+	double bestCost = std::numeric_limits<double>::max();
+	int bestBin = -1;
+	for (int bin = 0; bin < (LazyBVH::BIN_COUNT - 1); bin++)
+	{
+		leftBox.expandToInclude(binBoxes[bin]);
+		leftCount += binCounts[bin];
+		const int rightCount = count - leftCount;
+
+		if ((leftCount == 0) || (rightCount == 0))
+		{
+			continue;
+		}
+
+		const double cost = (leftBox.getSurfaceArea() * static_cast<double>(leftCount)) +
+			(rightAreas[bin + 1] * static_cast<double>(rightCount));
+
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestBin = bin;
+		}
+	}
+
+	if (bestBin < 0)
+	{
+		return BVHSplit::median();
+	}
+
+	return BVHSplit(axis, axisMin, binScale, LazyBVH::BIN_COUNT, bestBin);
+}
+
+int LazyBVH::splitNode(int nodeIndex) const
+{
+	const BVHFlatNode &node = this->nodes[nodeIndex];
+	const int start = node.getStartIndex();
+	const int end = start + node.getNumPrimitives();
+	const int depth = this->depths[nodeIndex];
+	const BVHSplit split = this->chooseSplit(start, end, depth);
+
+	// This thread owns the node's range of shapes until its children are published.
+	int middle = start + ((end - start) / 2);
+	if (!split.isMedian())
+	{
+		// Swap each shape that belongs on the left with the middle shape.
+		middle = start;
+		for (int i = start; i < end; i++)
+		{
+			if (split.isLeft(this->centroids[this->shapeOrder[i]]))
+			{
+				std::swap(this->shapeOrder[i], this->shapeOrder[middle]);
+				this->shapePositions[this->shapeOrder[i]] = i;
+				this->shapePositions[this->shapeOrder[middle]] = middle;
+				middle++;
+			}
+		}
+	}
+
+	const int leftIndex = this->nodeCount.fetch_add(2);
+	this->writeNode(leftIndex, start, middle - start, depth + 1);
+	this->writeNode(leftIndex + 1, middle, end - middle, depth + 1);
+	return leftIndex;
+}
+
+int LazyBVH::findChildren(int nodeIndex) const
+{
+	std::atomic<int> &state = this->states.at(nodeIndex);
+	int children = state.load(std::memory_order_acquire);
+
+	while ((children == LazyBVH::UNSPLIT) || (children == LazyBVH::SPLITTING))
+	{
+		int expected = LazyBVH::UNSPLIT;
+		if ((children == LazyBVH::UNSPLIT) && state.compare_exchange_strong(expected,
+			LazyBVH::SPLITTING, std::memory_order_acquire))
+		{
+			// Everything the split wrote is visible to whoever sees the new state.
+			children = this->splitNode(nodeIndex);
+			state.store(children, std::memory_order_release);
+		}
+		else
+		{
+			std::this_thread::yield();
+			children = state.load(std::memory_order_acquire);
+		}
+	}
+
+	return children;
+}
+
+Intersection LazyBVH::nearestHit(const Ray &ray) const
+{
+	// Rays that miss the whole scene leave even the root unsplit.
+	const BVHRay bvhRay(ray);
+	double nearestT = ray.getTMax();
+	if (this->shapes.empty() ||
+		!bvhRay.intersects(this->nodes[LazyBVH::ROOT_INDEX], static_cast<float>(nearestT)))
+	{
+		return Intersection();
+	}
+
+	Intersection nearest = Intersection();
+	float leftNearT, rightNearT;
+
+	BVHTraversal workArray[LazyBVH::MAX_LAZY_BVH_TRAVERSAL_TO_DO];
+	workArray[0] = BVHTraversal(LazyBVH::ROOT_INDEX, ray.getTMin());
+
+	int stackIndex = 0;
+	while (stackIndex >= 0)
+	{
+		BVHTraversal workNode = workArray[stackIndex];
+		stackIndex--;
+
+		if (nearestT < workNode.getMinT())
+		{
+			continue;
+		}
+
+		const int children = this->findChildren(workNode.getIndex());
+		if (children == LazyBVH::LEAF)
+		{
+			const BVHFlatNode &node = this->nodes[workNode.getIndex()];
+			const int end = node.getStartIndex() + node.getNumPrimitives();
+			for (int i = node.getStartIndex(); i < end; i++)
+			{
+				Intersection currentTry = this->primitives[i].hit(ray);
+
+				if (currentTry.getT() < nearestT)
+				{
+					nearestT = currentTry.getT();
+					nearest = currentTry;
+				}
+			}
+		}
+		else
+		{
+			const int leftIndex = children;
+			const int rightIndex = leftIndex + 1;
+			const int hitMask = bvhRay.intersects(this->nodes[leftIndex],
+				this->nodes[rightIndex], static_cast<float>(nearestT),
+				&leftNearT, &rightNearT);
+
+			// If both children were hit, push the farther one first so the closer one
+			// is visited next.
+			if (hitMask == (BVHRay::HIT_FIRST | BVHRay::HIT_SECOND))
+			{
+				const bool rightNearer = rightNearT < leftNearT;
+				stackIndex++;
+				workArray[stackIndex] = rightNearer ?
+					BVHTraversal(leftIndex, leftNearT) : BVHTraversal(rightIndex, rightNearT);
+				stackIndex++;
+				workArray[stackIndex] = rightNearer ?
+					BVHTraversal(rightIndex, rightNearT) : BVHTraversal(leftIndex, leftNearT);
+			}
+			else if (hitMask == BVHRay::HIT_FIRST)
+			{
+				stackIndex++;
+				workArray[stackIndex] = BVHTraversal(leftIndex, leftNearT);
+			}
+			else if (hitMask == BVHRay::HIT_SECOND)
+			{
+				stackIndex++;
+				workArray[stackIndex] = BVHTraversal(rightIndex, rightNearT);
+			}
+		}
+	}
+
+	return nearest;
+}
+
+bool LazyBVH::occluded(const Ray &ray) const
+{
+	const BVHRay bvhRay(ray);
+	const double tMax = ray.getTMax();
+	const float maxT = static_cast<float>(tMax);
+	if (this->shapes.empty() ||
+		!bvhRay.intersects(this->nodes[LazyBVH::ROOT_INDEX], maxT))
+	{
+		return false;
+	}
+
+	// Any hit will do, so children are visited in whatever order they were pushed.
+	int workArray[LazyBVH::MAX_LAZY_BVH_TRAVERSAL_TO_DO];
+	workArray[0] = LazyBVH::ROOT_INDEX;
+	float leftNearT, rightNearT;
+
+	int stackIndex = 0;
+	while (stackIndex >= 0)
+	{
+		const int nodeIndex = workArray[stackIndex];
+		stackIndex--;
+
+		const int children = this->findChildren(nodeIndex);
+		if (children == LazyBVH::LEAF)
+		{
+			const BVHFlatNode &node = this->nodes[nodeIndex];
+			const int end = node.getStartIndex() + node.getNumPrimitives();
+			for (int i = node.getStartIndex(); i < end; i++)
+			{
+				if (this->primitives[i].hit(ray).getT() < tMax)
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			const int hitMask = bvhRay.intersects(this->nodes[children],
+				this->nodes[children + 1], maxT, &leftNearT, &rightNearT);
+
+			if ((hitMask & BVHRay::HIT_FIRST) != 0)
+			{
+				stackIndex++;
+				workArray[stackIndex] = children;
+			}
+
+			if ((hitMask & BVHRay::HIT_SECOND) != 0)
+			{
+				stackIndex++;
+				workArray[stackIndex] = children + 1;
+			}
+		}
+	}
+
+	return false;
+}
+
+double LazyBVH::refitNode(int nodeIndex)
+{
+	const BVHFlatNode &node = this->nodes[nodeIndex];
+	const double oldArea = node.getBoundingBox().getSurfaceArea();
+	const int children = this->states[nodeIndex].load(std::memory_order_relaxed);
+
+	BoundingBox nodeBox = BoundingBox();
+	if ((children == LazyBVH::LEAF) || (children == LazyBVH::UNSPLIT))
+	{
+		const int end = node.getStartIndex() + node.getNumPrimitives();
+		for (int i = node.getStartIndex(); i < end; i++)
+		{
+			nodeBox.expandToInclude(this->shapeBoxes[this->shapeOrder[i]]);
+		}
+	}
+	else
+	{
+		nodeBox.expandToInclude(this->nodes[children].getBoundingBox());
+		nodeBox.expandToInclude(this->nodes[children + 1].getBoundingBox());
+	}
+
+	this->nodes.at(nodeIndex).setBoundingBox(nodeBox);
+	return node.getBoundingBox().getSurfaceArea() - oldArea;
+}
+
+bool LazyBVH::refit(const std::vector<const Shape*> &movedShapes)
+{
+	if (this->shapes.empty())
+	{
+		return true;
+	}
+
+	if (this->shapeIndices.empty())
+	{
+		for (int i = 0; i < static_cast<int>(this->shapes.size()); i++)
+		{
+			this->shapeIndices.insert(std::make_pair(this->shapes[i], i));
+		}
+	}
+
+	// Count the nodes split since the last refit as they are now, skipping the
+	// unused one after the root.
+	const int nodeCount = this->nodeCount.load();
+	for (int i = this->refitNodeCount; i < nodeCount; i++)
+	{
+		if (i != (LazyBVH::ROOT_INDEX + 1))
+		{
+			this->builtArea += this->nodes[i].getBoundingBox().getSurfaceArea();
+		}
+	}
+
+	this->refitNodeCount = nodeCount;
+
+	// Pairs of depths and indices of the nodes holding moved shapes, so they can be
+	// refit deepest first. Shapes that aren't in this tree are ignored.
+	std::vector<std::pair<int, int>> dirtyNodes = std::vector<std::pair<int, int>>();
+	for (const Shape *shape : movedShapes)
+	{
+		std::unordered_map<const Shape*, int>::const_iterator iter =
+			this->shapeIndices.find(shape);
+		if (iter == this->shapeIndices.end())
+		{
+			continue;
+		}
+
+		const int shapeIndex = iter->second;
+		const int position = this->shapePositions[shapeIndex];
+		this->shapeBoxes[shapeIndex] = shape->getBoundingBox();
+		this->centroids[shapeIndex] = shape->getCentroid();
+
+		// Walk down the split nodes whose range has the shape, until the leaf or the
+		// unsplit node it's in.
+		int nodeIndex = LazyBVH::ROOT_INDEX;
+		while (true)
+		{
+			dirtyNodes.push_back(std::make_pair(this->depths[nodeIndex], nodeIndex));
+			const int children = this->states[nodeIndex].load(std::memory_order_relaxed);
+			if (children == LazyBVH::LEAF)
+			{
+				this->primitives.at(position) = shape->getPrimitive();
+				break;
+			}
+			else if (children == LazyBVH::UNSPLIT)
+			{
+				break;
+			}
+
+			const int rightStart = this->nodes[children + 1].getStartIndex();
+			nodeIndex = (position < rightStart) ? children : (children + 1);
+		}
+	}
+
+	std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<std::pair<int, int>>());
+	dirtyNodes.erase(std::unique(dirtyNodes.begin(), dirtyNodes.end()), dirtyNodes.end());
+	for (const std::pair<int, int> &dirtyNode : dirtyNodes)
+	{
+		this->refitAreaGrowth += this->refitNode(dirtyNode.second);
+	}
+
+	// Moving shapes apart stretches the nodes split before, so past some point
+	// it's cheaper to rebuild than to keep traversing them.
+	return (this->builtArea + this->refitAreaGrowth) <=
+		(this->builtArea * LazyBVH::MAX_REFIT_AREA_RATIO);
+}
+
+size_t LazyBVH::getMemoryUsage() const
+{
+	return (this->shapes.capacity() * sizeof(const Shape*)) +
+		(this->shapeBoxes.capacity() * sizeof(BoundingBox)) +
+		(this->centroids.capacity() * sizeof(Vector3)) +
+		(this->shapeOrder.capacity() * sizeof(uint)) +
+		(this->shapePositions.capacity() * sizeof(int)) +
+		this->nodes.getMemoryUsage() + this->states.getMemoryUsage() +
+		this->depths.getMemoryUsage() + this->primitives.getMemoryUsage();
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef LAZY_BVH_H
+#define LAZY_BVH_H
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include "Accelerator.h"
+#include "BVHFlatNode.h"
+#include "BoundingBox.h"
+#include "../Math/Vector3.h"
+#include "../Shapes/Primitive.h"
+#include "../Utilities/ConcurrentBlockArray.h"
+#include "../Utilities/Utility.h"
+
+// A BVH that only splits a node the first time a ray enters it. Building it is just
+// one pass over the shapes' bounds, and the tree only grows where rays go, so a
+// scene with most of its geometry out of view gets its first frame much sooner than
+// with a full build.
+//
+// Whichever thread first reaches an unsplit node splits it. It claims the node with
+// a compare-and-swap, partitions the node's range of shapes in place, writes the
+// two children, and publishes them with a release store of the children's index,
+// so threads reading split nodes never lock. A thread that reaches a node while
+// another one is splitting it yields until the children are published, since the
+// node's shapes are being moved in the meantime.
+//
+// Splits use binned SAH along the longest axis of the node's centroids, without a
+// leaf cost, so each leaf holds up to "MAX_LEAF_SIZE" shapes.
+//
+// Once rays have explored the scene, it traces a little slower than a BVH built up
+// front, since each node visit also checks the node's state, and it uses more
+// memory, since it keeps each shape's bounds and centroid for later splits. Scenes
+// that stay in view for long are better off with a full build.
+
+class LazyBVH : public Accelerator
+{
+private:
+	static const int BLOCK_SIZE = 4096;
+	static const int BIN_COUNT = 16;
+	static const int MAX_LEAF_SIZE = 4;
+	// Halving nodes past the split depth adds at most 31 more levels, so a traversal
+	// stack, which holds at most one entry per level, can't overflow.
+	static const int MAX_SPLIT_DEPTH = 64;
+	static const int MAX_LAZY_BVH_TRAVERSAL_TO_DO = 128;
+	static const int ROOT_INDEX = 0;
+	static const int FIRST_CHILD_INDEX = 2;
+	static const double MAX_REFIT_AREA_RATIO;
+
+	// Node states. A split node's state is the index of its left child instead.
+	static const int UNSPLIT = 0;
+	static const int SPLITTING = -1;
+	static const int LEAF = -2;
+
+	std::vector<const class Shape*> shapes;
+
+	// Each shape's bounds and centroid, in the shapes' own order.
+	std::vector<BoundingBox> shapeBoxes;
+	std::vector<Vector3> centroids;
+
+	// Shape indices, partitioned in place as nodes are split. Each node's start index
+	// and count give its range of them.
+	mutable std::vector<uint> shapeOrder;
+
+	// Where each shape is in "shapeOrder", kept up to date by splits.
+	mutable std::vector<int> shapePositions;
+
+	// Each shape's index, for finding moved shapes. Only made by the first refit.
+	std::unordered_map<const class Shape*, int> shapeIndices;
+
+	// The total surface area of the nodes as they were made, and how much refits
+	// have grown it since. Nodes made since the last refit are added by the next.
+	double builtArea, refitAreaGrowth;
+	int refitNodeCount;
+
+	// Children are made in pairs at even indices after the root, so a pair never
+	// straddles two blocks. Index 1 is unused.
+	mutable ConcurrentBlockArray<BVHFlatNode, LazyBVH::BLOCK_SIZE> nodes;
+	mutable ConcurrentBlockArray<std::atomic<int>, LazyBVH::BLOCK_SIZE> states;
+	mutable ConcurrentBlockArray<int, LazyBVH::BLOCK_SIZE> depths;
+
+	// Leaves' primitives, at the same positions as their shapes in "shapeOrder".
+	mutable ConcurrentBlockArray<Primitive, LazyBVH::BLOCK_SIZE> primitives;
+	mutable std::atomic<int> nodeCount;
+
+	// Writes a node for the shapes in [start, start + count). Small nodes become
+	// leaves right away.
+	void writeNode(int nodeIndex, int start, int count, int depth) const;
+
+	// Past the maximum split depth, or when every centroid is in the same place, the
+	// shapes are just halved.
+	class BVHSplit chooseSplit(int start, int end, int depth) const;
+
+	// Splits a node this thread has claimed, and returns its left child's index.
+	int splitNode(int nodeIndex) const;
+
+	// Returns the node's left child's index, or "LEAF", splitting the node first if
+	// nobody has yet.
+	int findChildren(int nodeIndex) const;
+
+	// Recomputes a node's bounds from its children, or from its shapes if it's a
+	// leaf or hasn't been split yet. Returns how much its surface area grew.
+	double refitNode(int nodeIndex);
+public:
+	LazyBVH(const std::vector<class Shape*> &shapes);
+	virtual ~LazyBVH();
+
+	// How many nodes have been made so far.
+	int getNumNodes() const;
+
+	virtual class Intersection nearestHit(const class Ray &ray) const override;
+	virtual bool occluded(const class Ray &ray) const override;
+
+	// Recopies the moved shapes' bounds and primitives, and recomputes the bounds of
+	// the nodes holding them, keeping the splits made so far. Unsplit nodes are
+	// split with the new centroids later. Returns false once the nodes' total area
+	// has grown too far past what it was when they were made, meaning a rebuild is
+	// due. It must not run while rays are traced.
+	virtual bool refit(const std::vector<const class Shape*> &movedShapes) override;
+
+	// Counts the nodes and leaves made so far, which grow as rays explore the scene.
+	virtual size_t getMemoryUsage() const override;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <atomic>
+#include <omp.h>
+#include <utility>
+
+#include "LinearBVHBuilder.h"
+#include "../Shapes/Shape.h"
+
+LinearBVHBuilder::LinearBVHBuilder(const std::vector<Shape*> &shapes, int threadCount)
+	: shapes(shapes)
+{
+	this->nodes = BVHFlatNodeArray();
+	this->shapeOrder = std::vector<uint>();
+	this->keys = std::vector<ullong>();
+	this->threadCount = std::max(threadCount, 1);
+	this->numLeaves = 0;
+}
+
+int LinearBVHBuilder::commonPrefix(int i, int j) const
+{
+	if ((j < 0) || (j >= static_cast<int>(this->keys.size())))
+	{
+		return -1;
+	}
+
+	return Utility::countLeadingZeros(this->keys[i] ^ this->keys[j]);
+}
+
+bool LinearBVHBuilder::isFlatLeaf(int node) const
+{
+	return (this->lastIndices[node] - this->firstIndices[node]) <
+		LinearBVHBuilder::MAX_LEAF_SIZE;
+}
+
+void LinearBVHBuilder::computeKeys()
+{
+	const int shapeCount = static_cast<int>(this->shapes.size());
+
+	// Each thread bounds the centroids of its share of the shapes, and the boxes
+	// are merged afterwards.
+	this->shapeBoxes = std::vector<BoundingBox>(shapeCount);
+	this->centroids = std::vector<Vector3>(shapeCount);
+	std::vector<BoundingBox> threadBoxes = std::vector<BoundingBox>(this->threadCount);
+#pragma omp parallel num_threads(this->threadCount)
+	{
+		BoundingBox &threadBox = threadBoxes[omp_get_thread_num()];
+
+#pragma omp for schedule(static)
+		for (int i = 0; i < shapeCount; i++)
+		{
+			const Shape *shape = this->shapes[i];
+			this->shapeBoxes[i] = shape->getBoundingBox();
+			this->centroids[i] = shape->getCentroid();
+			threadBox.expandToInclude(this->centroids[i]);
+		}
+	}
+
+	BoundingBox centroidBox = BoundingBox();
+	for (const BoundingBox &threadBox : threadBoxes)
+	{
+		centroidBox.expandToInclude(threadBox);
+	}
+
+	// Scale the centroids into the unit cube. A flat axis maps every centroid to zero.
+	const Vector3 &centroidMin = centroidBox.getMin();
+	const Vector3 &centroidExtent = centroidBox.getExtent();
+	const double scaleX = (centroidExtent.getX() > 0.0) ? (1.0 / centroidExtent.getX()) : 0.0;
+	const double scaleY = (centroidExtent.getY() > 0.0) ? (1.0 / centroidExtent.getY()) : 0.0;
+	const double scaleZ = (centroidExtent.getZ() > 0.0) ? (1.0 / centroidExtent.getZ()) : 0.0;
+
+	this->keys = std::vector<ullong>(shapeCount);
+#pragma omp parallel for schedule(static) num_threads(this->threadCount)
+	for (int i = 0; i < shapeCount; i++)
+	{
+		const Vector3 offset = this->centroids[i] - centroidMin;
+		const uint code = Utility::mortonCode(offset.getX() * scaleX,
+			offset.getY() * scaleY, offset.getZ() * scaleZ);
+		this->keys[i] = (static_cast<ullong>(code) << 32) | static_cast<ullong>(i);
+	}
+
+	std::vector<Vector3>().swap(this->centroids);
+}
+
+void LinearBVHBuilder::sortKeys()
+{
+	const int keyCount = static_cast<int>(this->keys.size());
+	const ullong digitMask = LinearBVHBuilder::RADIX_SIZE - 1;
+	std::vector<ullong> sortedKeys = std::vector<ullong>(keyCount);
+	std::vector<int> digitOffsets =
+		std::vector<int>(this->threadCount * LinearBVHBuilder::RADIX_SIZE);
+
+	// The shape indices in the low half are already in order, so only the codes in
+	// the high half need sorting.
+	for (int shift = 32; shift < 64; shift += LinearBVHBuilder::RADIX_BITS)
+	{
+#pragma omp parallel num_threads(this->threadCount)
+		{
+			const int thread = omp_get_thread_num();
+			const int threads = omp_get_num_threads();
+			const int blockStart = static_cast<int>(
+				(static_cast<llong>(keyCount) * thread) / threads);
+			const int blockEnd = static_cast<int>(
+				(static_cast<llong>(keyCount) * (thread + 1)) / threads);
+			int *threadOffsets = &digitOffsets[thread * LinearBVHBuilder::RADIX_SIZE];
+
+			std::fill(threadOffsets, threadOffsets + LinearBVHBuilder::RADIX_SIZE, 0);
+			for (int i = blockStart; i < blockEnd; i++)
+			{
+				threadOffsets[(this->keys[i] >> shift) & digitMask]++;
+			}
+
+#pragma omp barrier
+#pragma omp single
+			{
+				// Keys go out by digit, and within a digit by thread, which keeps
+				// the sort stable.
+				int total = 0;
+				for (int digit = 0; digit < LinearBVHBuilder::RADIX_SIZE; digit++)
+				{
+					for (int i = 0; i < threads; i++)
+					{
+						int &offset = digitOffsets[(i * LinearBVHBuilder::RADIX_SIZE) + digit];
+						const int digitCount = offset;
+						offset = total;
+						total += digitCount;
+					}
+				}
+			}
+
+			for (int i = blockStart; i < blockEnd; i++)
+			{
+				const ullong key = this->keys[i];
+				sortedKeys[threadOffsets[(key >> shift) & digitMask]++] = key;
+			}
+		}
+
+		this->keys.swap(sortedKeys);
+	}
+}
+
+void LinearBVHBuilder::buildRadixTree()
+{
+	const int keyCount = static_cast<int>(this->keys.size());
+	const int internalCount = keyCount - 1;
+	const int nodeCount = internalCount + keyCount;
+	this->leftChildren = std::vector<int>(internalCount);
+	this->rightChildren = std::vector<int>(internalCount);
+	const int noParent = LinearBVHBuilder::NO_PARENT;
+	this->parents = std::vector<int>(nodeCount, noParent);
+	this->firstIndices = std::vector<int>(nodeCount);
+	this->lastIndices = std::vector<int>(nodeCount);
+
+	for (int i = 0; i < keyCount; i++)
+	{
+		this->firstIndices[internalCount + i] = i;
+		this->lastIndices[internalCount + i] = i;
+	}
+
+#pragma omp parallel for schedule(static) num_threads(this->threadCount)
+	for (int i = 0; i < internalCount; i++)
+	{
+		// The node's range grows from "i" towards the neighbor sharing more bits.
+		const int direction =
+			(this->commonPrefix(i, i + 1) > this->commonPrefix(i, i - 1)) ? 1 : -1;
+		const int minPrefix = this->commonPrefix(i, i - direction);
+
+		// Find the other end of the range with an exponential then a binary search.
+		int maxLength = 2;
+		while (this->commonPrefix(i, i + (maxLength * direction)) > minPrefix)
+		{
+			maxLength *= 2;
+		}
+
+		int length = 0;
+		for (int step = maxLength / 2; step > 0; step /= 2)
+		{
+			if (this->commonPrefix(i, i + ((length + step) * direction)) > minPrefix)
+			{
+				length += step;
+			}
+		}
+
+		const int j = i + (length * direction);
+
+		// The split is where the keys stop sharing the whole range's prefix.
+		const int nodePrefix = this->commonPrefix(i, j);
+		int split = 0;
+		int step = length;
+		do
+		{
+			step = (step + 1) / 2;
+			if (this->commonPrefix(i, i + ((split + step) * direction)) > nodePrefix)
+			{
+				split += step;
+			}
+		} while (step > 1);
+
+		const int splitIndex = i + (split * direction) + std::min(direction, 0);
+		const int first = std::min(i, j);
+		const int last = std::max(i, j);
+
+		// A child covering a single key is a leaf.
+		const int left = (first == splitIndex) ? (internalCount + splitIndex) : splitIndex;
+		const int right = (last == (splitIndex + 1)) ?
+			(internalCount + splitIndex + 1) : (splitIndex + 1);
+
+		this->leftChildren[i] = left;
+		this->rightChildren[i] = right;
+		this->firstIndices[i] = first;
+		this->lastIndices[i] = last;
+		this->parents[left] = i;
+		this->parents[right] = i;
+	}
+}
+
+void LinearBVHBuilder::computeBounds()
+{
+	const int keyCount = static_cast<int>(this->keys.size());
+	const int internalCount = keyCount - 1;
+	const int nodeCount = internalCount + keyCount;
+	this->boxes = std::vector<BoundingBox>(nodeCount);
+	this->flatCounts = std::vector<int>(nodeCount, 1);
+
+	std::vector<std::atomic<int>> arrivals(internalCount);
+	for (int i = 0; i < internalCount; i++)
+	{
+		arrivals[i] = 0;
+	}
+
+#pragma omp parallel for schedule(static) num_threads(this->threadCount)
+	for (int i = 0; i < keyCount; i++)
+	{
+		int node = internalCount + i;
+		const int shapeIndex = static_cast<int>(this->keys[i] & 0xFFFFFFFF);
+		this->boxes[node] = this->shapeBoxes[shapeIndex];
+
+		// The first child to arrive stops, and the second finds both done.
+		int parent = this->parents[node];
+		while ((parent != LinearBVHBuilder::NO_PARENT) && (arrivals[parent]++ == 1))
+		{
+			const int left = this->leftChildren[parent];
+			const int right = this->rightChildren[parent];
+			BoundingBox &parentBox = this->boxes[parent];
+			parentBox = this->boxes[left];
+			parentBox.expandToInclude(this->boxes[right]);
+			this->flatCounts[parent] = this->isFlatLeaf(parent) ? 1 :
+				(1 + this->flatCounts[left] + this->flatCounts[right]);
+
+			node = parent;
+			parent = this->parents[node];
+		}
+	}
+
+	std::vector<BoundingBox>().swap(this->shapeBoxes);
+}
+
+bool LinearBVHBuilder::emitNode(int node, int flatIndex)
+{
+	const int first = this->firstIndices[node];
+	const int count = this->lastIndices[node] - first + 1;
+	const bool leaf = this->isFlatLeaf(node);
+
+	// The left child directly follows this node, and the right child follows the
+	// whole left subtree.
+	this->nodes[flatIndex] = BVHFlatNode(this->boxes[node], first, count,
+		leaf ? 0 : (1 + this->flatCounts[this->leftChildren[node]]));
+	return leaf;
+}
+
+int LinearBVHBuilder::emitSubtree(int node, int flatIndex)
+{
+	std::vector<std::pair<int, int>> workArray = std::vector<std::pair<int, int>>();
+	workArray.push_back(std::make_pair(node, flatIndex));
+
+	int leafCount = 0;
+	while (!workArray.empty())
+	{
+		const std::pair<int, int> entry = workArray.back();
+		workArray.pop_back();
+
+		if (this->emitNode(entry.first, entry.second))
+		{
+			leafCount++;
+			continue;
+		}
+
+		const int left = this->leftChildren[entry.first];
+		const int right = this->rightChildren[entry.first];
+		workArray.push_back(std::make_pair(right,
+			entry.second + 1 + this->flatCounts[left]));
+		workArray.push_back(std::make_pair(left, entry.second + 1));
+	}
+
+	return leafCount;
+}
+
+void LinearBVHBuilder::emitNodes()
+{
+	const int rootNode = 0;
+	this->nodes = BVHFlatNodeArray(this->flatCounts[rootNode]);
+
+	// Write the top levels here until there are a few subtrees per thread, whose
+	// flat indices are known from the flat node counts.
+	std::vector<std::pair<int, int>> subtrees = std::vector<std::pair<int, int>>();
+	subtrees.push_back(std::make_pair(rootNode, 0));
+	const int taskCount = this->threadCount * LinearBVHBuilder::TASKS_PER_THREAD;
+	bool expanded = true;
+	while (expanded && (static_cast<int>(subtrees.size()) < taskCount))
+	{
+		expanded = false;
+		std::vector<std::pair<int, int>> nextSubtrees = std::vector<std::pair<int, int>>();
+		for (const std::pair<int, int> &subtree : subtrees)
+		{
+			if (this->isFlatLeaf(subtree.first))
+			{
+				nextSubtrees.push_back(subtree);
+				continue;
+			}
+
+			this->emitNode(subtree.first, subtree.second);
+			const int left = this->leftChildren[subtree.first];
+			const int right = this->rightChildren[subtree.first];
+			nextSubtrees.push_back(std::make_pair(left, subtree.second + 1));
+			nextSubtrees.push_back(std::make_pair(right,
+				subtree.second + 1 + this->flatCounts[left]));
+			expanded = true;
+		}
+
+		subtrees.swap(nextSubtrees);
+	}
+
+	const int subtreeCount = static_cast<int>(subtrees.size());
+	int leafCount = 0;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(this->threadCount) reduction(+: leafCount)
+	for (int i = 0; i < subtreeCount; i++)
+	{
+		leafCount += this->emitSubtree(subtrees[i].first, subtrees[i].second);
+	}
+
+	this->numLeaves = leafCount;
+}
+
+void LinearBVHBuilder::build()
+{
+	this->nodes.clear();
+	this->shapeOrder.clear();
+	this->numLeaves = 0;
+
+	const int shapeCount = static_cast<int>(this->shapes.size());
+	if (shapeCount == 0)
+	{
+		return;
+	}
+
+	this->computeKeys();
+	this->sortKeys();
+	this->buildRadixTree();
+	this->computeBounds();
+	this->emitNodes();
+
+	this->shapeOrder = std::vector<uint>(shapeCount);
+	for (int i = 0; i < shapeCount; i++)
+	{
+		this->shapeOrder[i] = static_cast<uint>(this->keys[i] & 0xFFFFFFFF);
+	}
+}
+
+const BVHFlatNodeArray &LinearBVHBuilder::getNodes() const
+{
+	return this->nodes;
+}
+
+const std::vector<uint> &LinearBVHBuilder::getShapeOrder() const
+{
+	return this->shapeOrder;
+}
+
+int LinearBVHBuilder::getNumLeaves() const
+{
+	return this->numLeaves;
+}
+
+size_t LinearBVHBuilder::getMemoryUsage() const
+{
+	return (this->keys.capacity() * sizeof(ullong)) +
+		(this->boxes.capacity() * sizeof(BoundingBox)) +
+		((this->leftChildren.capacity() + this->rightChildren.capacity() +
+		this->parents.capacity() + this->firstIndices.capacity() +
+		this->lastIndices.capacity() + this->flatCounts.capacity()) * sizeof(int)) +
+		(this->nodes.capacity() * sizeof(BVHFlatNode)) +
+		(this->shapeOrder.capacity() * sizeof(uint));
+}
\ No newline at end of file
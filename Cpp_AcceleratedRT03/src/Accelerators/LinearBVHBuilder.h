@@ -0,0 +1,89 @@
+#ifndef LINEAR_BVH_BUILDER_H
+#define LINEAR_BVH_BUILDER_H
+
+#include <vector>
+
+#include "BVHFlatNode.h"
+#include "BoundingBox.h"
+#include "../Math/Vector3.h"
+#include "../Utilities/Utility.h"
+
+// Builds a BVH by sorting shapes along a Z-order curve, like the LBVH by Lauterbach
+// et al. with the parallel hierarchy from Karras. Each shape's centroid gets a
+// Morton code, the codes are radix sorted, and every internal node of the binary
+// radix tree over the sorted codes is found on its own from its neighbors' codes.
+// Bounds then flow up the tree, and the nodes are written out in the usual
+// depth-first order, with the subtrees shared out over threads.
+//
+// Its trees are worse than binned SAH's, but it builds several times faster, so it
+// suits scenes whose shapes move too much for refitting to keep up. Each level of
+// the radix tree uses up at least one bit of the 64-bit keys, so no tree is deeper
+// than the traversal stacks allow for.
+
+class LinearBVHBuilder
+{
+private:
+	const std::vector<class Shape*> &shapes;
+	BVHFlatNodeArray nodes;
+	std::vector<uint> shapeOrder;
+
+	// A Morton code in the high 32 bits and a shape index in the low 32 bits, so
+	// every key is unique.
+	std::vector<ullong> keys;
+
+	// The shapes' bounds and centroids, read once in the shapes' own order. Later
+	// steps visit the shapes in sorted order, which would jump around in memory.
+	std::vector<BoundingBox> shapeBoxes;
+	std::vector<Vector3> centroids;
+
+	// The radix tree's internal nodes come first, then its leaves, one per sorted key.
+	// Each node covers the sorted keys from its first to its last index.
+	std::vector<BoundingBox> boxes;
+	std::vector<int> leftChildren, rightChildren, parents, firstIndices, lastIndices;
+
+	// How many flat nodes each radix tree node becomes, once small ranges are
+	// collapsed into leaves.
+	std::vector<int> flatCounts;
+	int threadCount, numLeaves;
+
+	static const int MAX_LEAF_SIZE = 4;
+	static const int RADIX_BITS = 8;
+	static const int RADIX_SIZE = 256;
+	static const int TASKS_PER_THREAD = 4;
+	static const int NO_PARENT = -1;
+
+	// The length of the prefix two sorted keys share, or -1 if "j" is out of range.
+	int commonPrefix(int i, int j) const;
+	bool isFlatLeaf(int node) const;
+
+	void computeKeys();
+
+	// Least significant digit first, over the Morton code half of each key. Every
+	// thread counts and then scatters its own contiguous block of keys.
+	void sortKeys();
+	void buildRadixTree();
+
+	// Walks up from every leaf. The second child to reach a node computes its bounds
+	// and flat node count and carries on, so each node is done exactly once.
+	void computeBounds();
+
+	// Writes one node at its flat index, and returns whether it's a leaf.
+	bool emitNode(int node, int flatIndex);
+
+	// Writes a node and everything under it, and returns how many leaves that was.
+	int emitSubtree(int node, int flatIndex);
+	void emitNodes();
+public:
+	LinearBVHBuilder(const std::vector<class Shape*> &shapes, int threadCount);
+
+	void build();
+
+	const BVHFlatNodeArray &getNodes() const;
+	const std::vector<uint> &getShapeOrder() const;
+	int getNumLeaves() const;
+
+	// The bytes held by the keys, the radix tree, and the flat nodes.
+	size_t getMemoryUsage() const;
+};
+
+#endif
\ No newline at end of file
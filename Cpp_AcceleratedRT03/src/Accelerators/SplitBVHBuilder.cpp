@@ -0,0 +1,435 @@
+#include <algorithm>
+#include <limits>
+
+#include "BVHSplit.h"
+#include "SplitBVHBuilder.h"
+#include "../Shapes/Shape.h"
+
+const double SplitBVHBuilder::TRAVERSAL_COST = 1.0;
+const double SplitBVHBuilder::INTERSECTION_COST = 1.0;
+const double SplitBVHBuilder::MAX_DUPLICATION_RATIO = 0.3;
+const double SplitBVHBuilder::MIN_OVERLAP_RATIO = 1.0e-5;
+
+SplitBVHBuilder::SplitBVHBuilder(const std::vector<Shape*> &shapes, int binCount)
+	: shapes(shapes)
+{
+	const int shapeCount = static_cast<int>(shapes.size());
+	this->nodes = BVHFlatNodeArray();
+	this->shapeOrder = std::vector<uint>();
+	this->minOverlapArea = 0.0;
+	this->liveReferences = 0;
+	this->peakLiveReferences = 0;
+	this->binCount = std::max(2, binCount);
+	this->referenceCount = shapeCount;
+	this->maxReferenceCount = shapeCount + static_cast<int>(
+		static_cast<double>(shapeCount) * SplitBVHBuilder::MAX_DUPLICATION_RATIO);
+	this->numLeaves = 0;
+}
+
+BoundingBox SplitBVHBuilder::getBounds(const std::vector<BVHReference> &references)
+{
+	BoundingBox box = BoundingBox();
+	for (const BVHReference &reference : references)
+	{
+		box.expandToInclude(reference.getBoundingBox());
+	}
+
+	return box;
+}
+
+double SplitBVHBuilder::findObjectSplit(const std::vector<BVHReference> &references,
+	const BoundingBox &nodeBox, BVHSplit *split, BoundingBox *leftBox,
+	BoundingBox *rightBox) const
+{
+	const int count = static_cast<int>(references.size());
+	const int binCount = this->binCount;
+
+	BoundingBox centroidBox = BoundingBox();
+	for (const BVHReference &reference : references)
+	{
+		centroidBox.expandToInclude(reference.getBoundingBox().getCentroid());
+	}
+
+	double axisMins[3];
+	double binScales[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		double axisExtent = centroidBox.getExtent().getComponent(static_cast<Axis>(axis));
+		axisMins[axis] = centroidBox.getMin().getComponent(static_cast<Axis>(axis));
+		binScales[axis] = (axisExtent > 0.0) ?
+			(static_cast<double>(binCount) / axisExtent) : 0.0;
+	}
+
+	std::vector<int> binCounts = std::vector<int>(3 * binCount, 0);
+	std::vector<BoundingBox> binBoxes = std::vector<BoundingBox>(3 * binCount);
+	for (const BVHReference &reference : references)
+	{
+		const Vector3 centroid = reference.getBoundingBox().getCentroid();
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int bin = BVHSplit::binIndex(centroid.getComponent(static_cast<Axis>(axis)),
+				axisMins[axis], binScales[axis], binCount);
+			binCounts[(axis * binCount) + bin]++;
+			binBoxes[(axis * binCount) + bin].expandToInclude(reference.getBoundingBox());
+		}
+	}
+
+	const double nodeAreaRecip = 1.0 / std::max(nodeBox.getSurfaceArea(), Utility::EPSILON);
+	double bestCost = std::numeric_limits<double>::infinity();
+	*split = BVHSplit::median();
+
+	std::vector<BoundingBox> rightBoxes = std::vector<BoundingBox>(binCount);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (binScales[axis] <= 0.0)
+		{
+			continue;
+		}
+
+		const int *axisCounts = &binCounts[axis * binCount];
+		const BoundingBox *axisBoxes = &binBoxes[axis * binCount];
+
+		BoundingBox rightSweep = BoundingBox();
+		for (int bin = binCount - 1; bin > 0; bin--)
+		{
+			rightSweep.expandToInclude(axisBoxes[bin]);
+			rightBoxes[bin] = rightSweep;
+		}
+
+		BoundingBox leftSweep = BoundingBox();
+		int leftCount = 0;
+		for (int bin = 0; bin < (binCount - 1); bin++)
+		{
+			leftSweep.expandToInclude(axisBoxes[bin]);
+			leftCount += axisCounts[bin];
+			int rightCount = count - leftCount;
+
+			if ((leftCount == 0) || (rightCount == 0))
+			{
+				continue;
+			}
+
+			double cost = SplitBVHBuilder::TRAVERSAL_COST +
+				(SplitBVHBuilder::INTERSECTION_COST *
+				((leftSweep.getSurfaceArea() * static_cast<double>(leftCount)) +
+				(rightBoxes[bin + 1].getSurfaceArea() * static_cast<double>(rightCount))) *
+				nodeAreaRecip);
+
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				*split = BVHSplit(static_cast<Axis>(axis), axisMins[axis], binScales[axis],
+					binCount, bin);
+				*leftBox = leftSweep;
+				*rightBox = rightBoxes[bin + 1];
+			}
+		}
+	}
+
+	return bestCost;
+}
+
+double SplitBVHBuilder::findSpatialSplit(const std::vector<BVHReference> &references,
+	const BoundingBox &nodeBox, Axis *axis, double *position) const
+{
+	const int binCount = SplitBVHBuilder::SPATIAL_BIN_COUNT;
+	const double nodeAreaRecip = 1.0 / std::max(nodeBox.getSurfaceArea(), Utility::EPSILON);
+	double bestCost = std::numeric_limits<double>::infinity();
+
+	int entries[SplitBVHBuilder::SPATIAL_BIN_COUNT];
+	int exits[SplitBVHBuilder::SPATIAL_BIN_COUNT];
+	BoundingBox binBoxes[SplitBVHBuilder::SPATIAL_BIN_COUNT];
+	BoundingBox rightBoxes[SplitBVHBuilder::SPATIAL_BIN_COUNT];
+	int rightCounts[SplitBVHBuilder::SPATIAL_BIN_COUNT];
+
+	for (int axisIndex = 0; axisIndex < 3; axisIndex++)
+	{
+		const Axis binAxis = static_cast<Axis>(axisIndex);
+		const double axisMin = nodeBox.getMin().getComponent(binAxis);
+		const double axisExtent = nodeBox.getExtent().getComponent(binAxis);
+		if (axisExtent <= 0.0)
+		{
+			continue;
+		}
+
+		const double binWidth = axisExtent / static_cast<double>(binCount);
+		const double binScale = static_cast<double>(binCount) / axisExtent;
+		std::fill(entries, entries + binCount, 0);
+		std::fill(exits, exits + binCount, 0);
+		std::fill(binBoxes, binBoxes + binCount, BoundingBox());
+
+		// Each reference counts as entering its first bin and exiting its last, and
+		// adds its clipped piece to every bin it covers.
+		for (const BVHReference &reference : references)
+		{
+			const BoundingBox &box = reference.getBoundingBox();
+			int firstBin = BVHSplit::binIndex(box.getMin().getComponent(binAxis),
+				axisMin, binScale, binCount);
+			int lastBin = BVHSplit::binIndex(box.getMax().getComponent(binAxis),
+				axisMin, binScale, binCount);
+
+			for (int bin = firstBin; bin <= lastBin; bin++)
+			{
+				double binMin = axisMin + (static_cast<double>(bin) * binWidth);
+				binBoxes[bin].expandToInclude(box.clippedTo(binAxis, binMin,
+					binMin + binWidth));
+			}
+
+			entries[firstBin]++;
+			exits[lastBin]++;
+		}
+
+		BoundingBox rightSweep = BoundingBox();
+		int rightCount = 0;
+		for (int bin = binCount - 1; bin > 0; bin--)
+		{
+			rightSweep.expandToInclude(binBoxes[bin]);
+			rightCount += exits[bin];
+			rightBoxes[bin] = rightSweep;
+			rightCounts[bin] = rightCount;
+		}
+
+		BoundingBox leftSweep = BoundingBox();
+		int leftCount = 0;
+		for (int bin = 0; bin < (binCount - 1); bin++)
+		{
+			leftSweep.expandToInclude(binBoxes[bin]);
+			leftCount += entries[bin];
+
+			if ((leftCount == 0) || (rightCounts[bin + 1] == 0))
+			{
+				continue;
+			}
+
+			double cost = SplitBVHBuilder::TRAVERSAL_COST +
+				(SplitBVHBuilder::INTERSECTION_COST *
+				((leftSweep.getSurfaceArea() * static_cast<double>(leftCount)) +
+				(rightBoxes[bin + 1].getSurfaceArea() *
+				static_cast<double>(rightCounts[bin + 1]))) * nodeAreaRecip);
+
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				*axis = binAxis;
+				*position = axisMin + (static_cast<double>(bin + 1) * binWidth);
+			}
+		}
+	}
+
+	return bestCost;
+}
+
+bool SplitBVHBuilder::partitionSpatial(const std::vector<BVHReference> &references,
+	Axis axis, double position, std::vector<BVHReference> &left,
+	std::vector<BVHReference> &right)
+{
+	int duplicates = 0;
+	for (const BVHReference &reference : references)
+	{
+		const BoundingBox &box = reference.getBoundingBox();
+		if (box.getMax().getComponent(axis) <= position)
+		{
+			left.push_back(reference);
+		}
+		else if (box.getMin().getComponent(axis) >= position)
+		{
+			right.push_back(reference);
+		}
+		else
+		{
+			const double maxValue = std::numeric_limits<double>::max();
+			left.push_back(BVHReference(box.clippedTo(axis, -maxValue, position),
+				reference.getShapeIndex()));
+			right.push_back(BVHReference(box.clippedTo(axis, position, maxValue),
+				reference.getShapeIndex()));
+			duplicates++;
+		}
+	}
+
+	if (left.empty() || right.empty() ||
+		((this->referenceCount + duplicates) > this->maxReferenceCount))
+	{
+		left.clear();
+		right.clear();
+		return false;
+	}
+
+	this->referenceCount += duplicates;
+	return true;
+}
+
+void SplitBVHBuilder::partitionObject(const std::vector<BVHReference> &references,
+	const BVHSplit &split, std::vector<BVHReference> &left,
+	std::vector<BVHReference> &right) const
+{
+	if (!split.isMedian())
+	{
+		for (const BVHReference &reference : references)
+		{
+			if (split.isLeft(reference.getBoundingBox().getCentroid()))
+			{
+				left.push_back(reference);
+			}
+			else
+			{
+				right.push_back(reference);
+			}
+		}
+
+		return;
+	}
+
+	// No plane separates the centroids, so just halve the references.
+	const size_t middle = references.size() / 2;
+	left.assign(references.begin(), references.begin() + middle);
+	right.assign(references.begin() + middle, references.end());
+}
+
+void SplitBVHBuilder::buildLeaf(const std::vector<BVHReference> &references,
+	const BoundingBox &nodeBox)
+{
+	const int count = static_cast<int>(references.size());
+	this->liveReferences -= references.size();
+	this->nodes.push_back(BVHFlatNode(nodeBox,
+		static_cast<int>(this->shapeOrder.size()), count, 0));
+	for (const BVHReference &reference : references)
+	{
+		this->shapeOrder.push_back(static_cast<uint>(reference.getShapeIndex()));
+	}
+
+	this->numLeaves++;
+}
+
+void SplitBVHBuilder::buildNode(std::vector<BVHReference> &references, int depth)
+{
+	const int count = static_cast<int>(references.size());
+	const BoundingBox nodeBox = SplitBVHBuilder::getBounds(references);
+
+	if (count <= 1)
+	{
+		this->buildLeaf(references, nodeBox);
+		return;
+	}
+
+	// Deep nodes are only halved, so that a long run of uneven splits can't keep
+	// going for as many levels as there are shapes.
+	if (depth >= SplitBVHBuilder::MAX_SPLIT_DEPTH)
+	{
+		if (count <= SplitBVHBuilder::MAX_LEAF_SIZE)
+		{
+			this->buildLeaf(references, nodeBox);
+			return;
+		}
+
+		std::vector<BVHReference> left = std::vector<BVHReference>();
+		std::vector<BVHReference> right = std::vector<BVHReference>();
+		this->partitionObject(references, BVHSplit::median(), left, right);
+		this->buildChildren(references, left, right, nodeBox, depth);
+		return;
+	}
+
+	BVHSplit objectSplit = BVHSplit::median();
+	BoundingBox leftBox, rightBox;
+	double objectCost = this->findObjectSplit(references, nodeBox, &objectSplit,
+		&leftBox, &rightBox);
+
+	// Only look for a spatial split when the object split's children overlap enough
+	// for clipping to help, and there's still room for more references.
+	Axis spatialAxis = Axis::X;
+	double spatialPosition = 0.0;
+	double spatialCost = std::numeric_limits<double>::infinity();
+	if ((depth < SplitBVHBuilder::MAX_SPATIAL_SPLIT_DEPTH) &&
+		(this->referenceCount < this->maxReferenceCount) &&
+		(leftBox.getOverlap(rightBox).getSurfaceArea() > this->minOverlapArea))
+	{
+		spatialCost = this->findSpatialSplit(references, nodeBox, &spatialAxis,
+			&spatialPosition);
+	}
+
+	const double leafCost = static_cast<double>(count) * SplitBVHBuilder::INTERSECTION_COST;
+	if ((std::min(objectCost, spatialCost) >= leafCost) &&
+		(count <= SplitBVHBuilder::MAX_LEAF_SIZE))
+	{
+		this->buildLeaf(references, nodeBox);
+		return;
+	}
+
+	std::vector<BVHReference> left = std::vector<BVHReference>();
+	std::vector<BVHReference> right = std::vector<BVHReference>();
+	if (!((spatialCost < objectCost) &&
+		this->partitionSpatial(references, spatialAxis, spatialPosition, left, right)))
+	{
+		this->partitionObject(references, objectSplit, left, right);
+	}
+
+	this->buildChildren(references, left, right, nodeBox, depth);
+}
+
+void SplitBVHBuilder::buildChildren(std::vector<BVHReference> &references,
+	std::vector<BVHReference> &left, std::vector<BVHReference> &right,
+	const BoundingBox &nodeBox, int depth)
+{
+	this->liveReferences += left.size() + right.size();
+	this->peakLiveReferences = std::max(this->peakLiveReferences, this->liveReferences);
+	this->liveReferences -= references.size();
+	std::vector<BVHReference>().swap(references);
+
+	// The left child directly follows this node, and the right child follows the
+	// whole left subtree.
+	const int nodeIndex = static_cast<int>(this->nodes.size());
+	this->nodes.push_back(BVHFlatNode(nodeBox, 0, 0, 1));
+	this->buildNode(left, depth + 1);
+	this->nodes[nodeIndex].setChildOffset(static_cast<int>(this->nodes.size()) - nodeIndex);
+	this->buildNode(right, depth + 1);
+}
+
+void SplitBVHBuilder::build()
+{
+	this->nodes.clear();
+	this->shapeOrder.clear();
+	this->numLeaves = 0;
+
+	const int shapeCount = static_cast<int>(this->shapes.size());
+	if (shapeCount == 0)
+	{
+		return;
+	}
+
+	std::vector<BVHReference> references = std::vector<BVHReference>();
+	references.reserve(shapeCount);
+	for (int i = 0; i < shapeCount; i++)
+	{
+		references.push_back(BVHReference(this->shapes[i]->getBoundingBox(), i));
+	}
+
+	const BoundingBox rootBox = SplitBVHBuilder::getBounds(references);
+	this->minOverlapArea = rootBox.getSurfaceArea() * SplitBVHBuilder::MIN_OVERLAP_RATIO;
+	this->referenceCount = shapeCount;
+	this->liveReferences = references.size();
+	this->peakLiveReferences = this->liveReferences;
+	this->nodes.reserve((2 * shapeCount) - 1);
+	this->shapeOrder.reserve(this->maxReferenceCount);
+	this->buildNode(references, 0);
+}
+
+const BVHFlatNodeArray &SplitBVHBuilder::getNodes() const
+{
+	return this->nodes;
+}
+
+const std::vector<uint> &SplitBVHBuilder::getShapeOrder() const
+{
+	return this->shapeOrder;
+}
+
+int SplitBVHBuilder::getNumLeaves() const
+{
+	return this->numLeaves;
+}
+
+size_t SplitBVHBuilder::getPeakMemory() const
+{
+	return (this->peakLiveReferences * sizeof(BVHReference)) +
+		(this->nodes.capacity() * sizeof(BVHFlatNode)) +
+		(this->shapeOrder.capacity() * sizeof(uint));
+}
\ No newline at end of file
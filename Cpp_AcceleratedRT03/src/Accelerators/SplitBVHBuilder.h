@@ -0,0 +1,89 @@
+#ifndef SPLIT_BVH_BUILDER_H
+#define SPLIT_BVH_BUILDER_H
+
+#include <vector>
+
+#include "BVHFlatNode.h"
+#include "BVHReference.h"
+#include "../Utilities/Utility.h"
+
+// Builds a BVH whose nodes may split a shape between both children, like the SBVH
+// by Stich, Friedrich, and Dietrich. Each node tries a binned SAH split over the
+// references' centroids, and when that split's children overlap a lot, also tries
+// spatial split planes that clip the references straddling them. Large cuboids that
+// overlap many others then no longer force every ray to visit both children.
+//
+// Splitting a reference duplicates it, so the total number of references is capped
+// at a fixed ratio of the shape count. Once the cap is reached, only object splits
+// are made. Past a maximum depth, nodes are halved instead, which bounds both the
+// recursion here and the traversal stacks of the finished tree.
+
+class SplitBVHBuilder
+{
+private:
+	const std::vector<class Shape*> &shapes;
+	BVHFlatNodeArray nodes;
+	std::vector<uint> shapeOrder;
+	double minOverlapArea;
+	size_t liveReferences, peakLiveReferences;
+	int binCount, referenceCount, maxReferenceCount, numLeaves;
+
+	static const int SPATIAL_BIN_COUNT = 32;
+	static const int MAX_LEAF_SIZE = 16;
+	static const int MAX_SPATIAL_SPLIT_DEPTH = 48;
+	static const int MAX_SPLIT_DEPTH = 64;
+	static const double TRAVERSAL_COST;
+	static const double INTERSECTION_COST;
+	static const double MAX_DUPLICATION_RATIO;
+	static const double MIN_OVERLAP_RATIO;
+
+	static BoundingBox getBounds(const std::vector<BVHReference> &references);
+
+	// Binned SAH over the references' centroids. Returns the split's cost, and the
+	// bounds of the two children it makes.
+	double findObjectSplit(const std::vector<BVHReference> &references,
+		const BoundingBox &nodeBox, class BVHSplit *split, BoundingBox *leftBox,
+		BoundingBox *rightBox) const;
+
+	// Bins the clipped references along each axis of the node. Returns the cost of the
+	// cheapest plane between two bins, or infinity if there isn't one.
+	double findSpatialSplit(const std::vector<BVHReference> &references,
+		const BoundingBox &nodeBox, Axis *axis, double *position) const;
+
+	// Moves each reference to the side of the plane it's on, and clips references
+	// that straddle it into both sides. Returns false and leaves the lists empty if
+	// that would make too many references or leave a side empty.
+	bool partitionSpatial(const std::vector<BVHReference> &references, Axis axis,
+		double position, std::vector<BVHReference> &left,
+		std::vector<BVHReference> &right);
+	void partitionObject(const std::vector<BVHReference> &references,
+		const class BVHSplit &split, std::vector<BVHReference> &left,
+		std::vector<BVHReference> &right) const;
+
+	void buildLeaf(const std::vector<BVHReference> &references,
+		const BoundingBox &nodeBox);
+
+	// Appends the depth-first nodes for the given references. The references are
+	// released before recursing, so only one path of lists is alive at once.
+	void buildNode(std::vector<BVHReference> &references, int depth);
+
+	// Releases a node's references and appends the node followed by its children.
+	void buildChildren(std::vector<BVHReference> &references,
+		std::vector<BVHReference> &left, std::vector<BVHReference> &right,
+		const BoundingBox &nodeBox, int depth);
+public:
+	SplitBVHBuilder(const std::vector<class Shape*> &shapes, int binCount);
+
+	void build();
+
+	// The leaves' shape indices may repeat a shape, so there can be more of them
+	// than there are shapes.
+	const BVHFlatNodeArray &getNodes() const;
+	const std::vector<uint> &getShapeOrder() const;
+	int getNumLeaves() const;
+
+	// The most bytes held at once by the reference lists, nodes, and shape order.
+	size_t getPeakMemory() const;
+};
+
+#endif
\ No newline at end of file
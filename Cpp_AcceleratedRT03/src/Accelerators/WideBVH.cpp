@@ -0,0 +1,354 @@
+#include <chrono>
+#include <limits>
+#include <utility>
+
+#include "BVHFlatNode.h"
+#include "BVHTraversal.h"
+#include "WideBVH.h"
+#include "WideBVHRay.h"
+#include "../Intersections/Intersection.h"
+#include "../Rays/Ray.h"
+#include "../Shapes/Shape.h"
+
+WideBVH::WideBVH(const std::vector<Shape*> &shapes)
+	: WideBVH(std::unique_ptr<BVH>(new BVH(shapes))) { }
+
+WideBVH::WideBVH(std::unique_ptr<BVH> binaryTree)
+{
+	this->binaryTree = std::move(binaryTree);
+	this->nodes = WideBVHNodeArray();
+	this->collapsedNodes = WideBVHNodeArray();
+	this->collapseToDo = std::vector<std::pair<int, int>>();
+	this->collapseOutdated = false;
+	this->collapse();
+}
+
+WideBVH::~WideBVH()
+{
+
+}
+
+int WideBVH::gatherChildren(int binaryIndex, int *binaryChildren) const
+{
+	const BVHFlatNodeArray &flatTree = this->binaryTree->getFlatTree();
+	const BVHFlatNode &binaryNode = flatTree[binaryIndex];
+
+	binaryChildren[0] = binaryIndex + binaryNode.getChildOffset();
+	binaryChildren[1] = binaryChildren[0] + 1;
+	int childCount = 2;
+
+	while (childCount < WideBVHNode::WIDTH)
+	{
+		// Find the internal child with the largest surface area, since it's the one
+		// most likely to be hit.
+		int largestChild = -1;
+		double largestArea = -1.0;
+		for (int i = 0; i < childCount; i++)
+		{
+			const BVHFlatNode &child = flatTree[binaryChildren[i]];
+			if (!child.isLeaf())
+			{
+				double area = child.getBoundingBox().getSurfaceArea();
+				if (area > largestArea)
+				{
+					largestChild = i;
+					largestArea = area;
+				}
+			}
+		}
+
+		// Stop early if every child is a leaf.
+		if (largestChild < 0)
+		{
+			break;
+		}
+
+		// Replace the child with its own two children.
+		const int openedIndex = binaryChildren[largestChild];
+		const BVHFlatNode &opened = flatTree[openedIndex];
+		binaryChildren[largestChild] = openedIndex + opened.getChildOffset();
+		binaryChildren[childCount] = binaryChildren[largestChild] + 1;
+		childCount++;
+	}
+
+	return childCount;
+}
+
+void WideBVH::startCollapse()
+{
+	const BVHFlatNodeArray &flatTree = this->binaryTree->getFlatTree();
+
+	this->collapsedNodes.clear();
+	this->collapseToDo.clear();
+	if (flatTree.empty())
+	{
+		return;
+	}
+
+	this->collapsedNodes.push_back(WideBVHNode());
+
+	// A root leaf becomes the only child of the wide root.
+	if (flatTree[0].isLeaf())
+	{
+		this->collapsedNodes[0].setChild(0, flatTree[0], flatTree[0].getStartIndex(),
+			flatTree[0].getNumPrimitives());
+		return;
+	}
+
+	// Pairs of binary node indices and the wide nodes they become.
+	this->collapseToDo.push_back(std::make_pair(0, 0));
+}
+
+bool WideBVH::continueCollapse(double seconds)
+{
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	const BVHFlatNodeArray &flatTree = this->binaryTree->getFlatTree();
+	std::vector<std::pair<int, int>> &toDo = this->collapseToDo;
+
+	int nodesSinceTimeCheck = 0;
+	while (!toDo.empty())
+	{
+		nodesSinceTimeCheck++;
+		if (nodesSinceTimeCheck == WideBVH::COLLAPSE_NODES_PER_TIME_CHECK)
+		{
+			nodesSinceTimeCheck = 0;
+			const double elapsed = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - startTime).count();
+			if (elapsed >= seconds)
+			{
+				return false;
+			}
+		}
+
+		const int binaryIndex = toDo.back().first;
+		const int wideIndex = toDo.back().second;
+		toDo.pop_back();
+
+		int binaryChildren[WideBVHNode::WIDTH];
+		const int childCount = this->gatherChildren(binaryIndex, binaryChildren);
+
+		for (int i = 0; i < childCount; i++)
+		{
+			const BVHFlatNode &child = flatTree[binaryChildren[i]];
+			if (child.isLeaf())
+			{
+				this->collapsedNodes[wideIndex].setChild(i, child, child.getStartIndex(),
+					child.getNumPrimitives());
+			}
+			else
+			{
+				const int childWideIndex = static_cast<int>(this->collapsedNodes.size());
+				this->collapsedNodes.push_back(WideBVHNode());
+				this->collapsedNodes[wideIndex].setChild(i, child, childWideIndex,
+					WideBVHNode::INTERNAL_CHILD);
+				toDo.push_back(std::make_pair(binaryChildren[i], childWideIndex));
+			}
+		}
+	}
+
+	this->nodes.swap(this->collapsedNodes);
+	return true;
+}
+
+void WideBVH::collapse()
+{
+	// Any collapse still in progress is for an older binary tree, so it's dropped.
+	this->startCollapse();
+	this->continueCollapse(std::numeric_limits<double>::infinity());
+	this->collapseOutdated = false;
+}
+
+Intersection WideBVH::nearestHit(const Ray &ray) const
+{
+	double nearestT = ray.getTMax();
+	Vector3 nearestPoint;
+	Vector3 nearestNormal;
+	const Shape *nearestShape = nullptr;
+	const Shape *nearestTopLevelShape = nullptr;
+
+	if (this->nodes.empty())
+	{
+		return Intersection();
+	}
+
+	const WideBVHRay wideRay(ray);
+
+	BVHTraversal workArray[WideBVH::MAX_WIDE_BVH_TRAVERSAL_TO_DO];
+	workArray[0] = BVHTraversal(0, ray.getTMin());
+
+	int stackIndex = 0;
+	while (stackIndex >= 0)
+	{
+		BVHTraversal workNode = workArray[stackIndex];
+		stackIndex--;
+
+		// If the current closest intersection is closer than this node, continue.
+		if (nearestT < workNode.getMinT())
+		{
+			continue;
+		}
+
+		const WideBVHNode &node = this->nodes[workNode.getIndex()];
+
+		// Test all four children at once.
+		__declspec(align(16)) float childNearTs[WideBVHNode::WIDTH];
+		const int hitMask = wideRay.intersects(node, static_cast<float>(nearestT),
+			childNearTs);
+		if (hitMask == 0)
+		{
+			continue;
+		}
+
+		// Sort the hit children by where the ray enters them, nearest first.
+		int hitChildren[WideBVHNode::WIDTH];
+		int hitCount = 0;
+		for (int child = 0; child < WideBVHNode::WIDTH; child++)
+		{
+			if ((hitMask & (1 << child)) != 0)
+			{
+				int i = hitCount;
+				while ((i > 0) && (childNearTs[hitChildren[i - 1]] > childNearTs[child]))
+				{
+					hitChildren[i] = hitChildren[i - 1];
+					i--;
+				}
+
+				hitChildren[i] = child;
+				hitCount++;
+			}
+		}
+
+		// Intersect leaf children right away, nearest first, so the nearest T can
+		// cull the internal children before they're pushed.
+		for (int i = 0; i < hitCount; i++)
+		{
+			const int child = hitChildren[i];
+			if (!node.isLeaf(child) || (nearestT < childNearTs[child]))
+			{
+				continue;
+			}
+
+			const int startIndex = node.getChildIndex(child);
+			const int endIndex = startIndex + node.getNumPrimitives(child);
+			for (int j = startIndex; j < endIndex; j++)
+			{
+				Intersection currentTry = this->binaryTree->getPrimitive(j).hit(ray);
+
+				if (currentTry.getT() < nearestT)
+				{
+					nearestT = currentTry.getT();
+					nearestPoint = currentTry.getPoint();
+					nearestNormal = currentTry.getNormal();
+					nearestShape = currentTry.getShape();
+					nearestTopLevelShape = currentTry.getTopLevelShape();
+				}
+			}
+		}
+
+		// Push internal children farthest first, so the nearest one is popped next.
+		for (int i = hitCount - 1; i >= 0; i--)
+		{
+			const int child = hitChildren[i];
+			if (!node.isLeaf(child) && (childNearTs[child] <= nearestT))
+			{
+				stackIndex++;
+				workArray[stackIndex] = BVHTraversal(node.getChildIndex(child),
+					childNearTs[child]);
+			}
+		}
+	}
+
+	return (nearestShape != nullptr) ? Intersection(nearestT, nearestPoint, nearestNormal,
+		nearestShape, nearestTopLevelShape) : Intersection();
+}
+
+bool WideBVH::occluded(const Ray &ray) const
+{
+	if (this->nodes.empty())
+	{
+		return false;
+	}
+
+	const WideBVHRay wideRay(ray);
+	const double tMax = ray.getTMax();
+	const float maxT = static_cast<float>(tMax);
+
+	// Any hit will do, so children don't need sorting.
+	int workArray[WideBVH::MAX_WIDE_BVH_TRAVERSAL_TO_DO];
+	workArray[0] = 0;
+
+	int stackIndex = 0;
+	while (stackIndex >= 0)
+	{
+		const WideBVHNode &node = this->nodes[workArray[stackIndex]];
+		stackIndex--;
+
+		__declspec(align(16)) float childNearTs[WideBVHNode::WIDTH];
+		const int hitMask = wideRay.intersects(node, maxT, childNearTs);
+
+		for (int child = 0; child < WideBVHNode::WIDTH; child++)
+		{
+			if ((hitMask & (1 << child)) == 0)
+			{
+				continue;
+			}
+
+			if (node.isLeaf(child))
+			{
+				const int startIndex = node.getChildIndex(child);
+				const int endIndex = startIndex + node.getNumPrimitives(child);
+				for (int i = startIndex; i < endIndex; i++)
+				{
+					if (this->binaryTree->getPrimitive(i).hit(ray).getT() < tMax)
+					{
+						return true;
+					}
+				}
+			}
+			else
+			{
+				stackIndex++;
+				workArray[stackIndex] = node.getChildIndex(child);
+			}
+		}
+	}
+
+	return false;
+}
+
+bool WideBVH::refit(const std::vector<const Shape*> &movedShapes)
+{
+	// The binary tree is still correct when its refit asks for a rebuild, so the
+	// wide nodes are collapsed again either way.
+	const bool refitted = this->binaryTree->refit(movedShapes);
+	this->collapse();
+	return refitted;
+}
+
+bool WideBVH::optimize(double seconds)
+{
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	// The binary tree stays as it is while a collapse is in progress.
+	if (this->collapseToDo.empty())
+	{
+		this->collapseOutdated |= this->binaryTree->optimize(seconds);
+		if (!this->collapseOutdated || !this->binaryTree->isOptimized())
+		{
+			return false;
+		}
+
+		this->startCollapse();
+		this->collapseOutdated = false;
+	}
+
+	const double elapsed = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - startTime).count();
+	return this->continueCollapse(seconds - elapsed);
+}
+
+size_t WideBVH::getMemoryUsage() const
+{
+	return ((this->nodes.capacity() + this->collapsedNodes.capacity()) *
+		sizeof(WideBVHNode)) + this->binaryTree->getMemoryUsage();
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include <memory>
+#include <vector>
+
+#include "Accelerator.h"
+#include "BVH.h"
+#include "WideBVHNode.h"
+
+// A four-wide BVH, made by collapsing a binary BVH so each node holds up to four of
+// its descendants. A ray is tested against all four children at once with SSE, and
+// the children it hits are visited nearest first.
+
+class WideBVH : public Accelerator
+{
+private:
+	std::unique_ptr<BVH> binaryTree;
+	WideBVHNodeArray nodes;
+
+	// A collapse that's spread over several optimize calls builds into these, and
+	// they replace the traced nodes once it's done. Their memory is reused by the
+	// next collapse.
+	WideBVHNodeArray collapsedNodes;
+	std::vector<std::pair<int, int>> collapseToDo;
+
+	// Whether rotations have changed the binary tree since it was last collapsed.
+	bool collapseOutdated;
+
+	// Each wide level can push three children for every level of the binary tree.
+	static const int MAX_WIDE_BVH_TRAVERSAL_TO_DO = 384;
+
+	// How many wide nodes a timed collapse makes between checks of the clock.
+	static const int COLLAPSE_NODES_PER_TIME_CHECK = 64;
+
+	// Picks up to four descendants of an internal binary node to be the children
+	// of one wide node, by opening the largest internal child until there are four.
+	// Returns how many were picked.
+	int gatherChildren(int binaryIndex, int *binaryChildren) const;
+
+	// Starts rebuilding the wide nodes from the current binary tree. The binary
+	// tree mustn't change until the collapse is finished.
+	void startCollapse();
+
+	// Continues the collapse until it's done or time is up. Returns whether it's
+	// done, in which case the new wide nodes are the ones traced from now on.
+	bool continueCollapse(double seconds);
+
+	// Rebuilds the wide nodes from the current binary tree all at once.
+	void collapse();
+public:
+	WideBVH(const std::vector<class Shape*> &shapes);
+
+	// Collapses an already built binary BVH.
+	WideBVH(std::unique_ptr<BVH> binaryTree);
+	virtual ~WideBVH();
+
+	virtual class Intersection nearestHit(const class Ray &ray) const override;
+	virtual bool occluded(const class Ray &ray) const override;
+
+	// Refits the binary tree, then collapses it again. Collapsing is linear in the
+	// node count, so it's still much cheaper than a rebuild.
+	virtual bool refit(const std::vector<const class Shape*> &movedShapes) override;
+
+	// Optimizes the binary tree, then collapses it again in the time left once
+	// there's nothing left to rotate. Rotations don't move any shapes, so the old
+	// wide nodes are traced until then, and a collapse larger than one call's time
+	// is finished over the next calls. Returns true when the new wide nodes are
+	// swapped in.
+	virtual bool optimize(double seconds) override;
+
+	// Includes the binary tree, which is kept for refitting.
+	virtual size_t getMemoryUsage() const override;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include <limits>
+
+#include "BVHFlatNode.h"
+#include "WideBVHNode.h"
+
+WideBVHNode::WideBVHNode()
+{
+	const float infinity = std::numeric_limits<float>::infinity();
+
+	for (int i = 0; i < WideBVHNode::WIDTH; i++)
+	{
+		for (int plane = 0; plane < 3; plane++)
+		{
+			this->planes[plane][i] = infinity;
+			this->planes[plane + 3][i] = -infinity;
+		}
+
+		this->childIndices[i] = 0;
+		this->childCounts[i] = WideBVHNode::EMPTY_CHILD;
+	}
+}
+
+const float *WideBVHNode::getPlanes() const
+{
+	return this->planes[0];
+}
+
+bool WideBVHNode::isEmpty(int child) const
+{
+	return this->childCounts[child] == WideBVHNode::EMPTY_CHILD;
+}
+
+bool WideBVHNode::isLeaf(int child) const
+{
+	return this->childCounts[child] > 0;
+}
+
+int WideBVHNode::getChildIndex(int child) const
+{
+	return this->childIndices[child];
+}
+
+int WideBVHNode::getNumPrimitives(int child) const
+{
+	return this->childCounts[child];
+}
+
+void WideBVHNode::setChild(int child, const BVHFlatNode &node, int index,
+	int numPrimitives)
+{
+	// The flat node's bounds are already floats, rounded outward.
+	const float *minData = node.getMinData();
+	const float *maxData = node.getMaxData();
+	for (int axis = 0; axis < 3; axis++)
+	{
+		this->planes[axis][child] = minData[axis];
+		this->planes[axis + 3][child] = maxData[axis];
+	}
+
+	this->childIndices[child] = index;
+	this->childCounts[child] = numPrimitives;
+}
\ No newline at end of file
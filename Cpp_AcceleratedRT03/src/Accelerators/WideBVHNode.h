@@ -0,0 +1,41 @@
+#ifndef WIDE_BVH_NODE_H
+#define WIDE_BVH_NODE_H
+
+#include <vector>
+
+#include "../Utilities/AlignedAllocator.h"
+#include "../Utilities/Utility.h"
+
+// A node with up to four children, laid out so one SSE load reads the same bound of
+// all of them. The planes are min x, min y, min z, max x, max y, and max z. An empty
+// child has inverted infinite bounds, so no ray ever hits it. A leaf child stores its
+// first shape index and shape count, and an internal child stores its node index.
+
+class __declspec(align(64)) WideBVHNode
+{
+private:
+	float planes[6][4];
+	int childIndices[4];
+	int childCounts[4];
+public:
+	static const int WIDTH = 4;
+	static const int EMPTY_CHILD = -1;
+	static const int INTERNAL_CHILD = 0;
+
+	WideBVHNode();
+
+	// All six planes in order, four floats each.
+	const float *getPlanes() const;
+	bool isEmpty(int child) const;
+	bool isLeaf(int child) const;
+	int getChildIndex(int child) const;
+	int getNumPrimitives(int child) const;
+
+	// Copies the bounds of a binary node into a child. A primitive count of zero
+	// makes it an internal child, with the index of its wide node.
+	void setChild(int child, const class BVHFlatNode &node, int index, int numPrimitives);
+};
+
+typedef std::vector<WideBVHNode, AlignedAllocator<WideBVHNode, 64>> WideBVHNodeArray;
+
+#endif
\ No newline at end of file
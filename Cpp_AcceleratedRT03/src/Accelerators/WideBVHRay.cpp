@@ -0,0 +1,61 @@
+#include "BVHRay.h"
+#include "WideBVHNode.h"
+#include "WideBVHRay.h"
+#include "../Rays/Ray.h"
+
+WideBVHRay::WideBVHRay(const Ray &ray)
+{
+	const Vector3 &point = ray.getPoint();
+	const Vector3 &direction = ray.getDirection();
+	const float inverseX = 1.0f / static_cast<float>(direction.getX());
+	const float inverseY = 1.0f / static_cast<float>(direction.getY());
+	const float inverseZ = 1.0f / static_cast<float>(direction.getZ());
+
+	this->originX = _mm_set1_ps(static_cast<float>(point.getX()));
+	this->originY = _mm_set1_ps(static_cast<float>(point.getY()));
+	this->originZ = _mm_set1_ps(static_cast<float>(point.getZ()));
+	this->inverseDirectionX = _mm_set1_ps(inverseX);
+	this->inverseDirectionY = _mm_set1_ps(inverseY);
+	this->inverseDirectionZ = _mm_set1_ps(inverseZ);
+	this->minT = _mm_set1_ps(static_cast<float>(ray.getTMin()));
+
+	// The near plane of each axis is the max plane when the ray points toward
+	// negative, and the min plane otherwise. These are offsets into a node's planes.
+	this->nearPlaneX = WideBVHNode::WIDTH * ((inverseX < 0.0f) ? 3 : 0);
+	this->nearPlaneY = WideBVHNode::WIDTH * ((inverseY < 0.0f) ? 4 : 1);
+	this->nearPlaneZ = WideBVHNode::WIDTH * ((inverseZ < 0.0f) ? 5 : 2);
+	this->farPlaneX = WideBVHNode::WIDTH * ((inverseX < 0.0f) ? 0 : 3);
+	this->farPlaneY = WideBVHNode::WIDTH * ((inverseY < 0.0f) ? 1 : 4);
+	this->farPlaneZ = WideBVHNode::WIDTH * ((inverseZ < 0.0f) ? 2 : 5);
+}
+
+int WideBVHRay::intersects(const WideBVHNode &node, float tMax, float *nearTs) const
+{
+	const float *planes = node.getPlanes();
+
+	// The candidate goes first in each max and min, so a NaN lane (a ray lying on
+	// a plane) keeps the running value.
+	__m128 childNearTs = this->minT;
+	__m128 childFarTs = _mm_set1_ps(tMax * BVHRay::FAR_T_SLACK);
+	childNearTs = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(
+		_mm_load_ps(planes + this->nearPlaneX), this->originX),
+		this->inverseDirectionX), childNearTs);
+	childNearTs = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(
+		_mm_load_ps(planes + this->nearPlaneY), this->originY),
+		this->inverseDirectionY), childNearTs);
+	childNearTs = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(
+		_mm_load_ps(planes + this->nearPlaneZ), this->originZ),
+		this->inverseDirectionZ), childNearTs);
+	childFarTs = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(
+		_mm_load_ps(planes + this->farPlaneX), this->originX),
+		this->inverseDirectionX), childFarTs);
+	childFarTs = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(
+		_mm_load_ps(planes + this->farPlaneY), this->originY),
+		this->inverseDirectionY), childFarTs);
+	childFarTs = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(
+		_mm_load_ps(planes + this->farPlaneZ), this->originZ),
+		this->inverseDirectionZ), childFarTs);
+
+	_mm_store_ps(nearTs, childNearTs);
+	return _mm_movemask_ps(_mm_cmple_ps(childNearTs, childFarTs));
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef WIDE_BVH_RAY_H
+#define WIDE_BVH_RAY_H
+
+#include <xmmintrin.h>
+
+#include "../Utilities/Utility.h"
+
+// A ray prepared for testing against the four children of a wide BVH node. Each of
+// its values is broadcast to all four lanes, and the near and far plane of each
+// axis are picked once from the direction's sign. Children are only hit from the
+// ray's min T onward.
+
+class __declspec(align(16)) WideBVHRay
+{
+private:
+	__m128 originX, originY, originZ;
+	__m128 inverseDirectionX, inverseDirectionY, inverseDirectionZ;
+	__m128 minT;
+	int nearPlaneX, nearPlaneY, nearPlaneZ;
+	int farPlaneX, farPlaneY, farPlaneZ;
+public:
+	WideBVHRay(const class Ray &ray);
+
+	// Tests the ray against all four children of the node, up to the given max T.
+	// Returns a mask with one bit per child that was hit, and writes where the ray
+	// enters each child into "nearTs", which must be 16-byte aligned.
+	int intersects(const class WideBVHNode &node, float tMax, float *nearTs) const;
+};
+
+#endif
\ No newline at end of file
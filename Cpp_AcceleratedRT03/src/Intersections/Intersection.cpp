@@ -11,7 +11,11 @@ Intersection::Intersection()
 
 Intersection::Intersection(double t, const Vector3 &point, const Vector3 &normal,
 	const Shape *shape)
-	: point(point), normal(normal), shape(shape)
+	: Intersection(t, point, normal, shape, shape) { }
+
+Intersection::Intersection(double t, const Vector3 &point, const Vector3 &normal,
+	const Shape *shape, const Shape *topLevelShape)
+	: point(point), normal(normal), shape(shape), topLevelShape(topLevelShape)
 {
 	this->t = t;
 }
@@ -34,4 +38,9 @@ const Vector3 &Intersection::getNormal() const
 const Shape *Intersection::getShape() const
 {
 	return this->shape;
+}
+
+const Shape *Intersection::getTopLevelShape() const
+{
+	return this->topLevelShape;
 }
\ No newline at end of file
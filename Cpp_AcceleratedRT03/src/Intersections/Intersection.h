@@ -10,7 +10,7 @@ class Intersection
 private:
 	double t;
 	Vector3 point, normal;
-	const class Shape *shape;
+	const class Shape *shape, *topLevelShape;
 public:
 	static const double T_MAX;
 
@@ -18,10 +18,19 @@ public:
 	Intersection(double t, const Vector3 &point, const Vector3 &normal,
 		const class Shape *shape);
 
+	// For a hit inside an instance, where the shape that was hit belongs to the
+	// instance's group, and the top-level shape is the instance in the world.
+	Intersection(double t, const Vector3 &point, const Vector3 &normal,
+		const class Shape *shape, const class Shape *topLevelShape);
+
 	double getT() const;
 	const Vector3 &getPoint() const;
 	const Vector3 &getNormal() const;
 	const class Shape *getShape() const;
+
+	// The world's shape that was hit, which is the hit shape itself unless it's inside
+	// an instance.
+	const class Shape *getTopLevelShape() const;
 };
 
 #endif
\ No newline at end of file
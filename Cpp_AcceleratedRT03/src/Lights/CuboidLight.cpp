@@ -4,6 +4,7 @@
 #include "../Materials/Flat.h"
 #include "../Materials/Material.h"
 #include "../Rays/Ray.h"
+#include "../Shapes/Primitive.h"
 
 CuboidLight::CuboidLight(const Vector3 &point)
 	: CuboidLight(point, 0.5 + Utility::rand0To1(), 0.5 + Utility::rand0To1(),
@@ -11,7 +12,7 @@ CuboidLight::CuboidLight(const Vector3 &point)
 
 CuboidLight::CuboidLight(const Vector3 &point, double width, double height, double depth,
 	const Vector3 &color)
-	: Light(), Cuboid(point, width, height, depth, new Flat(color)) { }
+	: Light(LightType::Cuboid), Cuboid(point, width, height, depth, new Flat(color)) { }
 
 const Vector3 &CuboidLight::getCentroid() const
 {
@@ -41,5 +42,14 @@ void CuboidLight::moveTo(const Vector3 &point)
 
 Intersection CuboidLight::hit(const Ray &ray) const
 {
-	return Cuboid::hit(ray);
+	// The hit shape is the light's own Shape, not the cuboid's, so it's the same
+	// pointer the light accelerator and grabbing know this light by.
+	return Cuboid::hitCuboid(ray, this->getCentroid(), this->width, this->height,
+		this->depth, static_cast<const Light*>(this));
+}
+
+Primitive CuboidLight::getPrimitive() const
+{
+	return Primitive::cuboid(static_cast<const Light*>(this), this->getCentroid(),
+		this->width, this->height, this->depth);
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include "Light.h"
 #include "../Shapes/Cuboid.h"
 
-class CuboidLight : public Light, public Cuboid
+class CuboidLight final : public Light, public Cuboid
 {
 public:
 	CuboidLight(const Vector3 &point);
@@ -17,6 +17,7 @@ public:
 	virtual class Vector3 randomPoint() const override;
 	virtual void moveTo(const Vector3 &point) override;
 	virtual class Intersection hit(const class Ray &ray) const override;
+	virtual class Primitive getPrimitive() const override;
 };
 
 #endif
\ No newline at end of file
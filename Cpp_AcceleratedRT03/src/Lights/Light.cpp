@@ -1,11 +1,63 @@
+#include "CuboidLight.h"
 #include "Light.h"
+#include "SphereLight.h"
+#include "../Intersections/Intersection.h"
+#include "../Materials/Material.h"
+
+Light::Light(LightType lightType)
+	: Shape(ShapeType::Light)
+{
+	this->lightType = lightType;
+}
 
 Light::Light()
+	: Light(LightType::Other) { }
+
+Light::~Light()
 {
 
 }
 
-Light::~Light()
+LightType Light::getLightType() const
+{
+	return this->lightType;
+}
+
+const Material &Light::findMaterial() const
 {
+	switch (this->lightType)
+	{
+	case LightType::Sphere:
+		return static_cast<const SphereLight*>(this)->SphereLight::getMaterial();
+	case LightType::Cuboid:
+		return static_cast<const CuboidLight*>(this)->CuboidLight::getMaterial();
+	default:
+		return this->getMaterial();
+	}
+}
 
+Vector3 Light::findRandomPoint() const
+{
+	switch (this->lightType)
+	{
+	case LightType::Sphere:
+		return static_cast<const SphereLight*>(this)->SphereLight::randomPoint();
+	case LightType::Cuboid:
+		return static_cast<const CuboidLight*>(this)->CuboidLight::randomPoint();
+	default:
+		return this->randomPoint();
+	}
+}
+
+Intersection Light::findHit(const Ray &ray) const
+{
+	switch (this->lightType)
+	{
+	case LightType::Sphere:
+		return static_cast<const SphereLight*>(this)->SphereLight::hit(ray);
+	case LightType::Cuboid:
+		return static_cast<const CuboidLight*>(this)->CuboidLight::hit(ray);
+	default:
+		return this->hit(ray);
+	}
 }
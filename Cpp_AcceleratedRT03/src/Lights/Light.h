@@ -8,12 +8,30 @@
 // some form of "point" member or "centroid", although a "centroid" is probably
 // outside this ray tracer's scope.
 
+// Lights are indexed by their own Shape, so derived lights report that Shape in
+// their intersections instead of the one from the derived shape.
+
+// The built-in kinds of light, dispatched like the shape tags in "ShapeType".
+enum class LightType { Sphere, Cuboid, Other };
+
 class Light : public Shape
 {
+private:
+	LightType lightType;
 public:
+	Light(LightType lightType);
 	Light();
 	virtual ~Light();
 
+	LightType getLightType() const;
+
+	// Same as "getMaterial", "randomPoint" and "hit", but dispatched on the light
+	// type. "findMaterial" hides the one in Shape on purpose, since a light's
+	// Shape has no material of its own.
+	const class Material &findMaterial() const;
+	class Vector3 findRandomPoint() const;
+	class Intersection findHit(const class Ray &ray) const;
+
 	virtual const class Vector3 &getCentroid() const = 0;
 	virtual class BoundingBox getBoundingBox() const = 0;
 	virtual const class Material &getMaterial() const = 0;
@@ -4,12 +4,13 @@
 #include "../Materials/Flat.h"
 #include "../Materials/Material.h"
 #include "../Rays/Ray.h"
+#include "../Shapes/Primitive.h"
 
 SphereLight::SphereLight(const Vector3 &point)
 	: SphereLight(point, 0.5 + Utility::rand0To1(), Vector3::randomColor()) { }
 
 SphereLight::SphereLight(const Vector3 &point, double radius, const Vector3 &color)
-	: Light(), Sphere(point, radius, new Flat(color)) { }
+	: Light(LightType::Sphere), Sphere(point, radius, new Flat(color)) { }
 
 const Vector3 &SphereLight::getCentroid() const
 {
@@ -39,5 +40,13 @@ void SphereLight::moveTo(const Vector3 &point)
 
 Intersection SphereLight::hit(const Ray &ray) const
 {
-	return Sphere::hit(ray);
+	// The hit shape is the light's own Shape, not the sphere's, so it's the same
+	// pointer the light accelerator and grabbing know this light by.
+	return Sphere::hitSphere(ray, this->getCentroid(), this->radiusSquared,
+		this->radiusRecip, static_cast<const Light*>(this));
+}
+
+Primitive SphereLight::getPrimitive() const
+{
+	return Primitive::sphere(static_cast<const Light*>(this), this->getCentroid(), this->radius);
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include "Light.h"
 #include "../Shapes/Sphere.h"
 
-class SphereLight : public Light, public Sphere
+class SphereLight final : public Light, public Sphere
 {
 public:
 	SphereLight(const Vector3 &point);
@@ -16,6 +16,7 @@ public:
 	virtual class Vector3 randomPoint() const override;
 	virtual void moveTo(const Vector3 &point) override;
 	virtual class Intersection hit(const class Ray &ray) const override;
+	virtual class Primitive getPrimitive() const override;
 };
 
 #endif
\ No newline at end of file
@@ -1,16 +1,36 @@
 #include <iostream>
+#include <string>
 #include <SDL.h>
 
+#include "../Programs/Benchmark.h"
 #include "../Programs/Program.h"
+#include "../Worlds/AcceleratorRebuild.h"
 
 #ifdef __cplusplus
 extern "C"
 #endif
 int main(int argc, char *argv[])
 {
-	(void)argc;
-	(void)argv;
-	
+	// "--benchmark" compares the accelerators on the built-in worlds and quits.
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark"))
+	{
+		Benchmark::runBuiltInWorlds();
+		return EXIT_SUCCESS;
+	}
+
+	// "--bvh-stats" prints the quality of each BVH build method's trees and quits.
+	if ((argc > 1) && (std::string(argv[1]) == "--bvh-stats"))
+	{
+		Benchmark::compareBVHBuildersOnBuiltInWorlds();
+		return EXIT_SUCCESS;
+	}
+
+	// "--cache-bvhs" saves and loads the BVHs of all static scenes, not just big ones.
+	if ((argc > 1) && (std::string(argv[1]) == "--cache-bvhs"))
+	{
+		AcceleratorRebuild::setCacheAllScenes(true);
+	}
+
 	Program p = Program();
 	p.loop();
 
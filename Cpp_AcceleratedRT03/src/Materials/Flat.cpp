@@ -7,7 +7,7 @@ Flat::Flat()
 	: Flat(Vector3::randomColor()) { }
 
 Flat::Flat(const Vector3 &color)
-	: Material(), color(color) { }
+	: Material(MaterialType::Flat), color(color) { }
 
 Vector3 Flat::getBaseColor() const
 {
@@ -3,7 +3,7 @@
 
 #include "Material.h"
 
-class Flat : public Material
+class Flat final : public Material
 {
 private:
 	Vector3 color;
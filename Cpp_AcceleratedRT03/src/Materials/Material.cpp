@@ -1,11 +1,101 @@
+#include "Flat.h"
 #include "Material.h"
+#include "Phong.h"
+#include "../Rays/SecondaryRayBatch.h"
+
+Material::Material(MaterialType materialType)
+{
+	this->materialType = materialType;
+}
 
 Material::Material()
+	: Material(MaterialType::Other) { }
+
+Material::~Material()
 {
 
 }
 
-Material::~Material()
+MaterialType Material::getMaterialType() const
+{
+	return this->materialType;
+}
+
+Vector3 Material::findBaseColor() const
+{
+	switch (this->materialType)
+	{
+	case MaterialType::Flat:
+		return static_cast<const Flat*>(this)->Flat::getBaseColor();
+	case MaterialType::Phong:
+		return static_cast<const Phong*>(this)->Phong::getBaseColor();
+	default:
+		return this->getBaseColor();
+	}
+}
+
+Vector3 Material::findColorAt(const Intersection &intersection, const Ray &ray,
+	const World &world) const
+{
+	switch (this->materialType)
+	{
+	case MaterialType::Flat:
+		return static_cast<const Flat*>(this)->Flat::colorAt(intersection, ray, world);
+	case MaterialType::Phong:
+		return static_cast<const Phong*>(this)->Phong::colorAt(intersection, ray, world);
+	default:
+		return this->colorAt(intersection, ray, world);
+	}
+}
+
+void Material::findSecondaryRays(const Intersection &intersection, const Ray &ray,
+	const World &world, SecondaryRayBatch &batch) const
 {
+	switch (this->materialType)
+	{
+	case MaterialType::Flat:
+		static_cast<const Flat*>(this)->Flat::addSecondaryRays(intersection, ray, world,
+			batch);
+		break;
+	case MaterialType::Phong:
+		static_cast<const Phong*>(this)->Phong::addSecondaryRays(intersection, ray, world,
+			batch);
+		break;
+	default:
+		this->addSecondaryRays(intersection, ray, world, batch);
+		break;
+	}
+}
 
+Vector3 Material::findColorFromBatch(const Intersection &intersection, const Ray &ray,
+	const World &world, const SecondaryRayBatch &batch, int firstRay) const
+{
+	switch (this->materialType)
+	{
+	case MaterialType::Flat:
+		return static_cast<const Flat*>(this)->Flat::colorFromBatch(intersection, ray,
+			world, batch, firstRay);
+	case MaterialType::Phong:
+		return static_cast<const Phong*>(this)->Phong::colorFromBatch(intersection, ray,
+			world, batch, firstRay);
+	default:
+		return this->colorFromBatch(intersection, ray, world, batch, firstRay);
+	}
 }
+
+void Material::addSecondaryRays(const Intersection &intersection, const Ray &ray,
+	const World &world, SecondaryRayBatch &batch) const
+{
+	(void)intersection;
+	(void)ray;
+	(void)world;
+	(void)batch;
+}
+
+Vector3 Material::colorFromBatch(const Intersection &intersection, const Ray &ray,
+	const World &world, const SecondaryRayBatch &batch, int firstRay) const
+{
+	(void)batch;
+	(void)firstRay;
+	return this->findColorAt(intersection, ray, world);
+}
\ No newline at end of file
@@ -3,15 +3,44 @@
 
 #include "../Math/Vector3.h"
 
+// The built-in kinds of material, dispatched like the shape tags in "ShapeType".
+enum class MaterialType { Flat, Phong, Other };
+
 class Material
 {
+private:
+	MaterialType materialType;
 public:
+	Material(MaterialType materialType);
 	Material();
 	virtual ~Material();
 
+	MaterialType getMaterialType() const;
+
+	// Same as "getBaseColor", "colorAt", "addSecondaryRays", and "colorFromBatch",
+	// but dispatched on the material type.
+	Vector3 findBaseColor() const;
+	Vector3 findColorAt(const class Intersection &intersection, const class Ray &ray,
+		const class World &world) const;
+	void findSecondaryRays(const class Intersection &intersection, const class Ray &ray,
+		const class World &world, class SecondaryRayBatch &batch) const;
+	Vector3 findColorFromBatch(const class Intersection &intersection,
+		const class Ray &ray, const class World &world,
+		const class SecondaryRayBatch &batch, int firstRay) const;
+
 	virtual Vector3 getBaseColor() const = 0;
 	virtual Vector3 colorAt(const class Intersection &intersection, const class Ray &ray, 
 		const class World &world) const = 0;
+
+	// A material that traces rays of its own to shade a point can add them to a batch
+	// instead, and read their results back from "firstRay" on once the batch has been
+	// traced. By default, no rays are added and the color comes from "colorAt".
+	virtual void addSecondaryRays(const class Intersection &intersection,
+		const class Ray &ray, const class World &world,
+		class SecondaryRayBatch &batch) const;
+	virtual Vector3 colorFromBatch(const class Intersection &intersection,
+		const class Ray &ray, const class World &world,
+		const class SecondaryRayBatch &batch, int firstRay) const;
 };
 
 #endif
\ No newline at end of file
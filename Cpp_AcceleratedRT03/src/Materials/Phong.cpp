@@ -4,6 +4,7 @@
 #include "../Intersections/Intersection.h"
 #include "../Lights/Light.h"
 #include "../Rays/Ray.h"
+#include "../Rays/SecondaryRayBatch.h"
 #include "../Utilities/Utility.h"
 #include "../Worlds/World.h"
 
@@ -19,7 +20,7 @@ Phong::Phong(const Vector3 &color)
 	Phong::DEFAULT_SHINY) { }
 
 Phong::Phong(const Vector3 &color, double ambient, double specular, double shiny)
-	: Material(), color(color)
+	: Material(MaterialType::Phong), color(color)
 {
 	this->ambient = ambient;
 	this->specular = specular;
@@ -67,38 +68,76 @@ Vector3 Phong::getBaseColor() const
 	return this->color;
 }
 
-double Phong::getAmbientPercent(const Vector3 &point, const Vector3 &normal,
-	const World &world) const
+Vector3 Phong::getLocalNormal(const Intersection &intersection, const Ray &ray)
 {
-	const Vector3 pointNormalEps = point + normal.scaledBy(Utility::EPSILON);
+	// The normal on the same side of the surface as the viewer.
+	double vnDot = -ray.getDirection().dot(intersection.getNormal());
+	double vnSign = vnDot > 0.0 ? 1.0 : ((vnDot < 0.0) ? -1.0 : 0.0);
+	return intersection.getNormal().scaledBy(vnSign);
+}
 
+double Phong::getAmbientPercent(const SecondaryRayBatch &batch, int firstRay) const
+{
 	double percent = 0.0;
 	for (int n = 0; n < Phong::AMBIENT_SAMPLE_COUNT; n++)
 	{
-		Vector3 hemisphereDir = Vector3::randomDirectionInHemisphere(normal);
+		double hitT = batch.getHitT(firstRay + n);
+		percent += (hitT > Phong::MAX_OCCLUSION_DISTANCE) ?
+			1.0 : (hitT / Phong::MAX_OCCLUSION_DISTANCE);
+	}
 
-		Ray hemisphereRay = Ray(pointNormalEps, hemisphereDir, Ray::INITIAL_DEPTH);
-		Intersection currentTry = hemisphereRay.nearestHit(world);
+	return percent / static_cast<double>(Phong::AMBIENT_SAMPLE_COUNT);
+}
 
-		percent += (currentTry.getT() > Phong::MAX_OCCLUSION_DISTANCE) ?
-			1.0 : (currentTry.getT() / Phong::MAX_OCCLUSION_DISTANCE);
+void Phong::addSecondaryRays(const Intersection &intersection, const Ray &ray,
+	const World &world, SecondaryRayBatch &batch) const
+{
+	const Vector3 localNormal = Phong::getLocalNormal(intersection, ray);
+
+	// Ambient occlusion rays. Hits past the occlusion distance don't darken the
+	// point, so the rays stop there.
+	const Vector3 pointNormalEps =
+		intersection.getPoint() + localNormal.scaledBy(2.0 * Utility::EPSILON);
+	for (int n = 0; n < Phong::AMBIENT_SAMPLE_COUNT; n++)
+	{
+		Vector3 hemisphereDir = Vector3::randomDirectionInHemisphere(localNormal);
+		batch.addNearestRay(Ray(pointNormalEps, hemisphereDir, Ray::INITIAL_DEPTH, 0.0,
+			Phong::MAX_OCCLUSION_DISTANCE));
 	}
 
-	return percent / static_cast<double>(Phong::AMBIENT_SAMPLE_COUNT);
+	// Shadow rays, for each light in turn.
+	for (const Light *light : world.getLights())
+	{
+		for (int n = 0; n < Phong::LIGHT_SAMPLE_COUNT; n++)
+		{
+			Vector3 lightDirection =
+				(light->findRandomPoint() - intersection.getPoint()).normalized();
+
+			Ray shadowRay = Ray(
+				intersection.getPoint() + lightDirection.scaledBy(Utility::EPSILON),
+				lightDirection,
+				Ray::INITIAL_DEPTH);
+			Intersection lightTry = light->findHit(shadowRay);
+
+			// Only a shape in front of the light matters, so the shadow ray can stop
+			// at the first one it finds. A ray that misses the light is never lit.
+			batch.addOcclusionRay(Ray(shadowRay.getPoint(), lightDirection,
+				Ray::INITIAL_DEPTH, 0.0,
+				(lightTry.getT() < Intersection::T_MAX) ? lightTry.getT() : 0.0));
+		}
+	}
 }
 
-Vector3 Phong::colorAt(const Intersection &intersection, const Ray &ray,
-	const World &world) const
+Vector3 Phong::colorFromBatch(const Intersection &intersection, const Ray &ray,
+	const World &world, const SecondaryRayBatch &batch, int firstRay) const
 {
 	Vector3 viewVector = -ray.getDirection();
-	double vnDot = viewVector.dot(intersection.getNormal());
-	double vnSign = vnDot > 0.0 ? 1.0 : ((vnDot < 0.0) ? -1.0 : 0.0);
-	Vector3 localNormal = intersection.getNormal().scaledBy(vnSign);
+	Vector3 localNormal = Phong::getLocalNormal(intersection, ray);
 
 	// Percent of the total ambient color visible at a point.
-	double ambientPercent = this->getAmbientPercent(
-		intersection.getPoint() + localNormal.scaledBy(Utility::EPSILON),
-		localNormal, world);
+	int rayIndex = firstRay;
+	double ambientPercent = this->getAmbientPercent(batch, rayIndex);
+	rayIndex += Phong::AMBIENT_SAMPLE_COUNT;
 
 	// Ambient component.
 	Vector3 color = this->color.scaledBy(world.getBackgroundColor())
@@ -107,30 +146,23 @@ Vector3 Phong::colorAt(const Intersection &intersection, const Ray &ray,
 	// Diffuse component.
 	for (const Light *light : world.getLights())
 	{
+		const Vector3 lightColor = light->findMaterial().findBaseColor();
 		Vector3 totalDiffuseColor = Vector3();
 		Vector3 totalHighlightColor = Vector3();
 
 		int visibleSamples = 0;
-		for (int n = 0; n < Phong::LIGHT_SAMPLE_COUNT; n++)
+		for (int n = 0; n < Phong::LIGHT_SAMPLE_COUNT; n++, rayIndex++)
 		{
-			Vector3 lightDirection =
-				(light->randomPoint() - intersection.getPoint()).normalized();
-
-			Ray shadowRay = Ray(
-				intersection.getPoint() + lightDirection.scaledBy(Utility::EPSILON),
-				lightDirection,
-				Ray::INITIAL_DEPTH);
-			Intersection lightTry = light->hit(shadowRay);
-			Intersection shadowTry = shadowRay.nearestShape(world);
-			visibleSamples += (lightTry.getT() < shadowTry.getT());
+			const Vector3 &lightDirection = batch.getRay(rayIndex).getDirection();
+			visibleSamples += batch.isOccluded(rayIndex) ? 0 : 1;
 
 			Vector3 lnReflect = lightDirection.reflect(localNormal).normalized();
 			double lnDot = lightDirection.dot(localNormal);
 			double lnReflectVDot = lnReflect.dot(viewVector);
 
-			Vector3 highlightColor = light->getMaterial().getBaseColor().scaledBy(this->specular)
+			Vector3 highlightColor = lightColor.scaledBy(this->specular)
 				.scaledBy(std::pow(std::max(0.0, lnReflectVDot), this->shiny));
-			Vector3 diffuseColor = this->color.scaledBy(light->getMaterial().getBaseColor())
+			Vector3 diffuseColor = this->color.scaledBy(lightColor)
 				.scaledBy(std::max(0.0, lnDot));
 
 			totalDiffuseColor = totalDiffuseColor + diffuseColor;
@@ -152,4 +184,14 @@ Vector3 Phong::colorAt(const Intersection &intersection, const Ray &ray,
 	}
 
 	return color;
+}
+
+Vector3 Phong::colorAt(const Intersection &intersection, const Ray &ray,
+	const World &world) const
+{
+	// A batch of just this point's rays.
+	SecondaryRayBatch batch = SecondaryRayBatch();
+	this->addSecondaryRays(intersection, ray, world, batch);
+	batch.trace(world);
+	return this->colorFromBatch(intersection, ray, world, batch, 0);
 }
\ No newline at end of file
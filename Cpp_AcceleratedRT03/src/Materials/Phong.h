@@ -5,7 +5,7 @@
 
 // Phong will have the ambient occlusion built in once the Ambient class works.
 
-class Phong : public Material
+class Phong final : public Material
 {
 protected:
 	Vector3 color;
@@ -18,8 +18,11 @@ protected:
 	static int AMBIENT_SAMPLE_COUNT;
 	static int LIGHT_SAMPLE_COUNT;
 
-	double getAmbientPercent(const Vector3 &point, const Vector3 &normal,
-		const class World &world) const;
+	static Vector3 getLocalNormal(const class Intersection &intersection,
+		const class Ray &ray);
+
+	// Averages the visibility of the ambient occlusion rays starting at "firstRay".
+	double getAmbientPercent(const class SecondaryRayBatch &batch, int firstRay) const;
 public:
 	Phong(const Vector3 &color);
 	Phong(const Vector3 &color, double ambient, double specular, double shiny);
@@ -33,8 +36,17 @@ public:
 	static void decrementLightSamples();
 
 	virtual Vector3 getBaseColor() const override;
+	// Traces this point's own rays, one at a time.
 	virtual Vector3 colorAt(const class Intersection &intersection, const class Ray &ray,
 		const class World &world) const override;
+
+	// The ambient occlusion rays come first, then each light's shadow rays.
+	virtual void addSecondaryRays(const class Intersection &intersection,
+		const class Ray &ray, const class World &world,
+		class SecondaryRayBatch &batch) const override;
+	virtual Vector3 colorFromBatch(const class Intersection &intersection,
+		const class Ray &ray, const class World &world,
+		const class SecondaryRayBatch &batch, int firstRay) const override;
 };
 
 #endif
\ No newline at end of file
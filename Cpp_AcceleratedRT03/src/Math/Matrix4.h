@@ -4,10 +4,11 @@
 #include <cmath>
 #include <string>
 
+#include "Vector3.h"
 #include "../Utilities/Utility.h"
 
-// A Vector4 type will probably need to be made to communicate with this class,
-// so transformations can be done.
+// Points and directions are transformed as column vectors with an implied w of one
+// or zero, so affine transforms don't need a Vector4 type.
 
 class Matrix4
 {
@@ -54,9 +55,9 @@ public:
 	static Matrix4 translation(double x, double y, double z)
 	{
 		Matrix4 m = Matrix4::identity();
-		m.x[3] = x;
-		m.y[3] = y;
-		m.z[3] = z;
+		m.w[0] = x;
+		m.w[1] = y;
+		m.w[2] = z;
 		return m;
 	}
 
@@ -219,6 +220,84 @@ public:
 		return p;
 	}
 	
+	Vector3 transformPoint(const Vector3 &point) const
+	{
+		return Vector3(
+			(this->x[0] * point.getX()) + (this->y[0] * point.getY()) +
+			(this->z[0] * point.getZ()) + this->w[0],
+			(this->x[1] * point.getX()) + (this->y[1] * point.getY()) +
+			(this->z[1] * point.getZ()) + this->w[1],
+			(this->x[2] * point.getX()) + (this->y[2] * point.getY()) +
+			(this->z[2] * point.getZ()) + this->w[2]);
+	}
+
+	Vector3 transformDirection(const Vector3 &direction) const
+	{
+		return Vector3(
+			(this->x[0] * direction.getX()) + (this->y[0] * direction.getY()) +
+			(this->z[0] * direction.getZ()),
+			(this->x[1] * direction.getX()) + (this->y[1] * direction.getY()) +
+			(this->z[1] * direction.getZ()),
+			(this->x[2] * direction.getX()) + (this->y[2] * direction.getY()) +
+			(this->z[2] * direction.getZ()));
+	}
+
+	Matrix4 transposed() const
+	{
+		Matrix4 m = Matrix4();
+
+		m.x[0] = this->x[0];
+		m.x[1] = this->y[0];
+		m.x[2] = this->z[0];
+		m.x[3] = this->w[0];
+
+		m.y[0] = this->x[1];
+		m.y[1] = this->y[1];
+		m.y[2] = this->z[1];
+		m.y[3] = this->w[1];
+
+		m.z[0] = this->x[2];
+		m.z[1] = this->y[2];
+		m.z[2] = this->z[2];
+		m.z[3] = this->w[2];
+
+		m.w[0] = this->x[3];
+		m.w[1] = this->y[3];
+		m.w[2] = this->z[3];
+		m.w[3] = this->w[3];
+
+		return m;
+	}
+
+	// Only valid for affine transforms, where the bottom row is (0, 0, 0, 1).
+	Matrix4 affineInverse() const
+	{
+		// The rows of the upper 3x3's inverse are the cross products of its columns,
+		// divided by its determinant.
+		const Vector3 columnX = Vector3(this->x[0], this->x[1], this->x[2]);
+		const Vector3 columnY = Vector3(this->y[0], this->y[1], this->y[2]);
+		const Vector3 columnZ = Vector3(this->z[0], this->z[1], this->z[2]);
+		const Vector3 translation = Vector3(this->w[0], this->w[1], this->w[2]);
+		const double determinantRecip = 1.0 / columnX.dot(columnY.cross(columnZ));
+		const Vector3 rows[3] =
+		{
+			columnY.cross(columnZ).scaledBy(determinantRecip),
+			columnZ.cross(columnX).scaledBy(determinantRecip),
+			columnX.cross(columnY).scaledBy(determinantRecip)
+		};
+
+		Matrix4 m = Matrix4::identity();
+		for (int i = 0; i < 3; i++)
+		{
+			m.x[i] = rows[i].getX();
+			m.y[i] = rows[i].getY();
+			m.z[i] = rows[i].getZ();
+			m.w[i] = -rows[i].dot(translation);
+		}
+
+		return m;
+	}
+
 	std::string toString() const
 	{
 		return std::string("[") +
@@ -68,6 +68,11 @@ public:
 	double getY() const { return this->y; }
 	double getZ() const { return this->z; }
 
+	double getComponent(Axis axis) const
+	{
+		return (axis == Axis::X) ? this->x : ((axis == Axis::Y) ? this->y : this->z);
+	}
+
 	Vector3 operator +(const Vector3 &v) const
 	{
 		return Vector3(this->x + v.x, this->y + v.y, this->z + v.z);
@@ -0,0 +1,160 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <omp.h>
+#include <vector>
+
+#include "Benchmark.h"
+#include "../Accelerators/Accelerator.h"
+#include "../Accelerators/BVH.h"
+#include "../Accelerators/BVHStatistics.h"
+#include "../Cameras/Camera.h"
+#include "../Intersections/Intersection.h"
+#include "../Math/Vector3.h"
+#include "../Rays/Ray.h"
+#include "../Worlds/World.h"
+
+void Benchmark::run(const World &world, const Camera &camera, int width, int height)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<Vector3> imageDirections = std::vector<Vector3>(width * height);
+	camera.calculateImageRays(imageDirections, width, height);
+	const Vector3 eye = camera.getEye();
+	const int rayCount = static_cast<int>(imageDirections.size());
+	const double totalRays = static_cast<double>(rayCount) *
+		static_cast<double>(Benchmark::TRACE_PASSES);
+
+	std::cout << world.getShapes().size() << " shapes, " << rayCount <<
+		" rays per pass, " << Benchmark::TRACE_PASSES << " passes." << "\n";
+
+	const AcceleratorType types[] =
+	{
+		AcceleratorType::BinaryBVH, AcceleratorType::WideBVH, AcceleratorType::Grid,
+		AcceleratorType::KdTree, AcceleratorType::LazyBVH
+	};
+	for (const AcceleratorType type : types)
+	{
+		const Clock::time_point buildStart = Clock::now();
+		std::unique_ptr<Accelerator> accelerator = std::unique_ptr<Accelerator>(
+			Accelerator::make(type, world.getShapes()));
+		const Clock::time_point buildEnd = Clock::now();
+
+		// The hit count keeps the traces from being optimized away, and should be the
+		// same for every accelerator.
+		int hitCount = 0;
+		const Clock::time_point nearestStart = Clock::now();
+		for (int pass = 0; pass < Benchmark::TRACE_PASSES; pass++)
+		{
+#pragma omp parallel for schedule(dynamic, 64) reduction(+: hitCount)
+			for (int i = 0; i < rayCount; i++)
+			{
+				const Ray ray = Ray(eye, imageDirections[i], Ray::INITIAL_DEPTH);
+				const Intersection hit = accelerator->nearestHit(ray);
+				hitCount += (hit.getT() < Intersection::T_MAX) ? 1 : 0;
+			}
+		}
+		const Clock::time_point nearestEnd = Clock::now();
+
+		int occludedCount = 0;
+		for (int pass = 0; pass < Benchmark::TRACE_PASSES; pass++)
+		{
+#pragma omp parallel for schedule(dynamic, 64) reduction(+: occludedCount)
+			for (int i = 0; i < rayCount; i++)
+			{
+				const Ray ray = Ray(eye, imageDirections[i], Ray::INITIAL_DEPTH);
+				occludedCount += accelerator->occluded(ray) ? 1 : 0;
+			}
+		}
+		const Clock::time_point occludedEnd = Clock::now();
+
+		const double buildSeconds =
+			std::chrono::duration<double>(buildEnd - buildStart).count();
+		const double nearestSeconds =
+			std::chrono::duration<double>(nearestEnd - nearestStart).count();
+		const double occludedSeconds =
+			std::chrono::duration<double>(occludedEnd - nearestEnd).count();
+
+		std::cout << std::fixed << std::setprecision(2) <<
+			std::setw(12) << Accelerator::getTypeName(type) << ": " <<
+			"build " << (buildSeconds * 1000.0) << " ms, " <<
+			"memory " << (static_cast<double>(accelerator->getMemoryUsage()) / 1024.0) <<
+			" KB, " <<
+			"nearest " << ((totalRays / nearestSeconds) / 1.0e6) << " Mrays/s, " <<
+			"occluded " << ((totalRays / occludedSeconds) / 1.0e6) << " Mrays/s, " <<
+			"hits " << (hitCount / Benchmark::TRACE_PASSES) << "\n";
+	}
+
+	std::cout << "\n";
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+void Benchmark::runBuiltInWorlds()
+{
+	const int width = Benchmark::DEFAULT_WIDTH;
+	const int height = Benchmark::DEFAULT_HEIGHT;
+	const double aspect = static_cast<double>(width) / static_cast<double>(height);
+	const Camera camera = Camera::defaultCamera(12.0, aspect);
+
+	std::unique_ptr<World> world1 = std::unique_ptr<World>(World::makeWorld1());
+	std::cout << "World 1: ";
+	Benchmark::run(*world1, camera, width, height);
+
+	std::unique_ptr<World> world2 = std::unique_ptr<World>(World::makeWorld2());
+	std::cout << "World 2: ";
+	Benchmark::run(*world2, camera, width, height);
+}
+
+void Benchmark::compareBVHBuilders(const World &world, const Camera &camera, int width,
+	int height)
+{
+	std::vector<Vector3> imageDirections = std::vector<Vector3>(width * height);
+	camera.calculateImageRays(imageDirections, width, height);
+	const Vector3 eye = camera.getEye();
+	const int rayCount = static_cast<int>(imageDirections.size());
+
+	std::cout << world.getShapes().size() << " shapes, " << rayCount << " rays." << "\n";
+
+	const BVHBuildMethod buildMethods[] =
+	{
+		BVHBuildMethod::Midpoint, BVHBuildMethod::BinnedSAH, BVHBuildMethod::SpatialSAH,
+		BVHBuildMethod::Linear
+	};
+	for (const BVHBuildMethod buildMethod : buildMethods)
+	{
+		const BVH bvh(world.getShapes(), buildMethod, BVH::DEFAULT_BIN_COUNT,
+			omp_get_max_threads());
+
+		// Nearest hits and occlusion both count towards the per-ray averages.
+		int hitCount = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+: hitCount)
+		for (int i = 0; i < rayCount; i++)
+		{
+			const Ray ray = Ray(eye, imageDirections[i], Ray::INITIAL_DEPTH);
+			hitCount += (bvh.nearestHit(ray).getT() < Intersection::T_MAX) ? 1 : 0;
+			hitCount += bvh.occluded(ray) ? 1 : 0;
+		}
+
+		std::cout << BVH::getBuildMethodName(buildMethod) << " (hits " <<
+			(hitCount / 2) << "):" << "\n" << BVHStatistics(bvh).toString();
+	}
+
+	std::cout << "\n";
+}
+
+void Benchmark::compareBVHBuildersOnBuiltInWorlds()
+{
+	const int width = Benchmark::DEFAULT_WIDTH;
+	const int height = Benchmark::DEFAULT_HEIGHT;
+	const double aspect = static_cast<double>(width) / static_cast<double>(height);
+	const Camera camera = Camera::defaultCamera(12.0, aspect);
+
+	std::unique_ptr<World> world1 = std::unique_ptr<World>(World::makeWorld1());
+	std::cout << "World 1: ";
+	Benchmark::compareBVHBuilders(*world1, camera, width, height);
+
+	std::unique_ptr<World> world2 = std::unique_ptr<World>(World::makeWorld2());
+	std::cout << "World 2: ";
+	Benchmark::compareBVHBuilders(*world2, camera, width, height);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Compares the accelerator types on the same scene. Each one is built over the
+// world's shapes, then the camera's image rays are traced through it for nearest
+// hits and for occlusion. The build time, memory and rays per second are printed
+// for each.
+
+class Benchmark
+{
+private:
+	static const int TRACE_PASSES = 4;
+	static const int DEFAULT_WIDTH = 960;
+	static const int DEFAULT_HEIGHT = 640;
+public:
+	Benchmark() = delete;
+	Benchmark(const Benchmark&) = delete;
+	~Benchmark() = delete;
+
+	static void run(const class World &world, const class Camera &camera, int width,
+		int height);
+
+	// Runs the benchmark on each of the built-in worlds, for the "--benchmark"
+	// command line option.
+	static void runBuiltInWorlds();
+
+	// Builds a binary BVH with each build method, traces the image rays through it
+	// one at a time, and prints its statistics.
+	static void compareBVHBuilders(const class World &world, const class Camera &camera,
+		int width, int height);
+
+	// Compares the BVH builders on each of the built-in worlds, for the
+	// "--bvh-stats" command line option.
+	static void compareBVHBuildersOnBuiltInWorlds();
+};
+
+#endif
\ No newline at end of file
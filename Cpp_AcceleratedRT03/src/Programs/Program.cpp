@@ -2,7 +2,9 @@
 #include <iostream>
 #include <SDL.h>
 
+#include "Benchmark.h"
 #include "Program.h"
+#include "../Accelerators/Accelerator.h"
 #include "../Cameras/Camera.h"
 #include "../Materials/Phong.h"
 #include "../Math/Vector3.h"
@@ -62,6 +64,10 @@ Program::Program()
 	std::cout << "R to reset camera zoom." << "\n";
 	std::cout << "B to randomize background color." << "\n";
 	std::cout << "N to randomize world." << "\n";
+	std::cout << "M to make a world of instanced shape groups." << "\n";
+	std::cout << "V to switch between the binary BVH, wide BVH, grid and kd-tree." << "\n";
+	std::cout << "L to toggle fast linear BVH rebuilds, for worlds with moving shapes." << "\n";
+	std::cout << "X to benchmark every accelerator on the current view." << "\n";
 	std::cout << "Comma/Period to change resolution quality (pixel size)." << "\n";
 	std::cout << "Left/Right brackets to change lighting and direct shadow quality." << "\n";
 	std::cout << "Semicolon/Apostrophe to change indirect shadow quality (ambient occlusion)." << "\n";
@@ -128,7 +134,10 @@ void Program::updateScreenTitle()
 		std::string("Pixel Size: ") + std::to_string(this->renderer->getPixelSize()) +
 		std::string(", ") + std::string("Light samples: ") + 
 		std::to_string(Phong::getLightSamples()) + std::string(", ") +
-		std::string("Ambient samples: ") + std::to_string(Phong::getAmbientSamples());
+		std::string("Ambient samples: ") + std::to_string(Phong::getAmbientSamples()) +
+		std::string(", ") + std::string("Accelerator: ") +
+		Accelerator::getTypeName(this->world->getAcceleratorType()) +
+		(this->world->isDynamic() ? std::string(" (linear rebuilds)") : std::string());
 	this->renameScreen(fullTitle);
 }
 
@@ -161,9 +170,21 @@ void Program::handleEvents(SDL_Event &sdlEvent)
 		bool randomizeBackground = 
 			((sdlEvent.type == SDL_KEYDOWN) &&
 			(sdlEvent.key.keysym.sym == SDLK_b));
+		bool toggleAccelerator =
+			((sdlEvent.type == SDL_KEYDOWN) &&
+			(sdlEvent.key.keysym.sym == SDLK_v));
+		bool toggleDynamic =
+			((sdlEvent.type == SDL_KEYDOWN) &&
+			(sdlEvent.key.keysym.sym == SDLK_l));
+		bool benchmark =
+			((sdlEvent.type == SDL_KEYDOWN) &&
+			(sdlEvent.key.keysym.sym == SDLK_x));
 		bool randomizeWorld =
 			((sdlEvent.type == SDL_KEYDOWN) &&
 			(sdlEvent.key.keysym.sym == SDLK_n));
+		bool instancedWorld =
+			((sdlEvent.type == SDL_KEYDOWN) &&
+			(sdlEvent.key.keysym.sym == SDLK_m));
 		bool increasePixelSize =
 			((sdlEvent.type == SDL_KEYDOWN) &&
 			(sdlEvent.key.keysym.sym == SDLK_PERIOD));
@@ -225,9 +246,44 @@ void Program::handleEvents(SDL_Event &sdlEvent)
 			this->world->randomizeBackground();
 			this->doneRendering = false;
 		}
+		if (toggleAccelerator)
+		{
+			// Cycle through the accelerator types in order.
+			this->world->setAcceleratorType(static_cast<AcceleratorType>(
+				(static_cast<int>(this->world->getAcceleratorType()) + 1) %
+				Program::ACCELERATOR_TYPE_COUNT));
+			this->updateScreenTitle();
+			this->doneRendering = false;
+		}
+		if (toggleDynamic)
+		{
+			this->world->setDynamic(!this->world->isDynamic());
+			this->updateScreenTitle();
+			this->doneRendering = false;
+		}
+		if (benchmark)
+		{
+			// Use the current view at the current render resolution.
+			Benchmark::run(*this->world, *this->camera, this->renderer->getRenderWidth(),
+				this->renderer->getRenderHeight());
+		}
 		if (randomizeWorld)
 		{
+			// Keep the chosen accelerator in the new world.
+			AcceleratorType acceleratorType = this->world->getAcceleratorType();
+			bool dynamic = this->world->isDynamic();
 			this->world = std::unique_ptr<World>(World::makeWorld1());
+			this->world->setAcceleratorType(acceleratorType);
+			this->world->setDynamic(dynamic);
+			this->doneRendering = false;
+		}
+		if (instancedWorld)
+		{
+			AcceleratorType acceleratorType = this->world->getAcceleratorType();
+			bool dynamic = this->world->isDynamic();
+			this->world = std::unique_ptr<World>(World::makeWorld2());
+			this->world->setAcceleratorType(acceleratorType);
+			this->world->setDynamic(dynamic);
 			this->doneRendering = false;
 		}
 		if (increasePixelSize)
@@ -328,6 +384,7 @@ void Program::handleEvents(SDL_Event &sdlEvent)
 
 void Program::tick()
 {
+	this->world->update();
 	this->world->updateGrabbedShape(*this->camera);
 }
 
@@ -25,6 +25,9 @@ private:
 	static const bool DEFAULT_SCREEN_IS_RESIZABLE;
 	static const int DEFAULT_SCREEN_FLAGS;
 
+	// How many accelerator types the "V" key cycles through.
+	static const int ACCELERATOR_TYPE_COUNT = 5;
+
 	// Ray tracer objects.
 	std::unique_ptr<class Camera> camera;
 	std::unique_ptr<class Renderer> renderer;
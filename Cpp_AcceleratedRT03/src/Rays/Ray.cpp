@@ -1,16 +1,21 @@
 #include "Ray.h"
 #include "../Accelerators/Accelerator.h"
 #include "../Intersections/Intersection.h"
-#include "../Lights/Light.h"
 #include "../Worlds/World.h"
 
-Ray::Ray(const Vector3 &point, const Vector3 &direction, int depth)
+Ray::Ray(const Vector3 &point, const Vector3 &direction, int depth, double tMin,
+	double tMax)
 {
 	this->point = point;
 	this->direction = direction;
+	this->tMin = tMin;
+	this->tMax = tMax;
 	this->depth = depth;
 }
 
+Ray::Ray(const Vector3 &point, const Vector3 &direction, int depth)
+	: Ray(point, direction, depth, 0.0, Intersection::T_MAX) { }
+
 const Vector3 &Ray::getPoint() const
 {
 	return this->point;
@@ -21,11 +26,26 @@ const Vector3 &Ray::getDirection() const
 	return this->direction;
 }
 
+double Ray::getTMin() const
+{
+	return this->tMin;
+}
+
+double Ray::getTMax() const
+{
+	return this->tMax;
+}
+
 int Ray::getDepth() const
 {
 	return this->depth;
 }
 
+bool Ray::contains(double t) const
+{
+	return (t >= this->tMin) && (t <= this->tMax);
+}
+
 Vector3 Ray::pointAt(double t) const
 {
 	return this->point + this->direction.scaledBy(t);
@@ -48,20 +68,12 @@ Intersection Ray::nearestShape(const World &world) const
 	return world.getAccelerator()->nearestHit(*this);
 }
 
-Intersection Ray::nearestLight(const World &world) const
+bool Ray::occluded(const World &world) const
 {
-	Intersection nearestLight = Intersection();
-	Intersection currentTry;
-
-	for (const Light *light : world.getLights())
-	{
-		currentTry = light->hit(*this);
-
-		if (currentTry.getT() < nearestLight.getT())
-		{
-			nearestLight = currentTry;
-		}
-	}
+	return world.occluded(*this);
+}
 
-	return nearestLight;
+Intersection Ray::nearestLight(const World &world) const
+{
+	return world.getLightAccelerator()->nearestHit(*this);
 }
\ No newline at end of file
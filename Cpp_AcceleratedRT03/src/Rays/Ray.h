@@ -3,24 +3,37 @@
 
 #include "../Math/Vector3.h"
 
+// A ray only hits things between its min and max T. Accelerators cull any node
+// the interval doesn't reach, and shapes report hits outside it as misses.
+
 class Ray
 {
 private:
 	Vector3 point, direction;
+	double tMin, tMax;
 	int depth;
 
 public:
 	static const int INITIAL_DEPTH = 0;
 
+	// Reaches from the point out to "Intersection::T_MAX".
 	Ray(const Vector3 &point, const Vector3 &direction, int depth);
+	Ray(const Vector3 &point, const Vector3 &direction, int depth, double tMin,
+		double tMax);
 
 	const Vector3 &getPoint() const;
 	const Vector3 &getDirection() const;
+	double getTMin() const;
+	double getTMax() const;
 	int getDepth() const;
+	bool contains(double t) const;
 	Vector3 pointAt(double t) const;
 	class Intersection nearestHit(const class World &world) const;
 	class Intersection nearestShape(const class World &world) const;
 	class Intersection nearestLight(const class World &world) const;
+
+	// Whether any shape (not light) is hit closer than the ray's max T.
+	bool occluded(const class World &world) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <limits>
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "../Accelerators/BoundingBox.h"
+#include "../Accelerators/BVHRay.h"
+
+RayPacket::RayPacket(const Vector3 &origin, double tMin, double tMax)
+{
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	this->origin = origin;
+	this->minInverseDirection = Vector3(infinity, infinity, infinity);
+	this->maxInverseDirection = Vector3(-infinity, -infinity, -infinity);
+	this->tMin = tMin;
+	this->tMax = tMax;
+	this->negative[0] = false;
+	this->negative[1] = false;
+	this->negative[2] = false;
+	this->size = 0;
+	this->coherent = true;
+}
+
+const Vector3 &RayPacket::getOrigin() const
+{
+	return this->origin;
+}
+
+const Vector3 &RayPacket::getDirection(int index) const
+{
+	return this->directions[index];
+}
+
+double RayPacket::getTMin() const
+{
+	return this->tMin;
+}
+
+double RayPacket::getTMax() const
+{
+	return this->tMax;
+}
+
+Ray RayPacket::getRay(int index) const
+{
+	return Ray(this->origin, this->directions[index], Ray::INITIAL_DEPTH, this->tMin,
+		this->tMax);
+}
+
+int RayPacket::getSize() const
+{
+	return this->size;
+}
+
+bool RayPacket::isCoherent() const
+{
+	return this->coherent;
+}
+
+void RayPacket::addDirection(const Vector3 &direction)
+{
+	this->directions[this->size] = direction;
+	this->size++;
+
+	const Vector3 inverseDirection = Vector3(
+		1.0 / direction.getX(), 1.0 / direction.getY(), 1.0 / direction.getZ());
+
+	this->minInverseDirection = this->minInverseDirection.componentMin(inverseDirection);
+	this->maxInverseDirection = this->maxInverseDirection.componentMax(inverseDirection);
+
+	// The packet stays coherent while no axis has both signs (or a zero, whose
+	// infinite inverse would make the interval meaningless).
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const double component = direction.getComponent(static_cast<Axis>(axis));
+		if (component == 0.0)
+		{
+			this->coherent = false;
+		}
+		else if (this->size == 1)
+		{
+			this->negative[axis] = component < 0.0;
+		}
+		else if (this->negative[axis] != (component < 0.0))
+		{
+			this->coherent = false;
+		}
+	}
+}
+
+bool RayPacket::intersects(const BoundingBox &boundingBox, double tMax,
+	double *tNear) const
+{
+	double nearLow = this->tMin;
+	double farHigh = tMax;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const Axis selectedAxis = static_cast<Axis>(axis);
+		const double minPlane = boundingBox.getMin().getComponent(selectedAxis);
+		const double maxPlane = boundingBox.getMax().getComponent(selectedAxis);
+		const double nearPlane = this->negative[axis] ? maxPlane : minPlane;
+		const double farPlane = this->negative[axis] ? minPlane : maxPlane;
+		const double originPoint = this->origin.getComponent(selectedAxis);
+		const double minInverse = this->minInverseDirection.getComponent(selectedAxis);
+		const double maxInverse = this->maxInverseDirection.getComponent(selectedAxis);
+
+		// Every ray's T for a plane lies between its T for the two ends of the
+		// inverse direction range, since the origin is shared.
+		const double nearDistance = nearPlane - originPoint;
+		const double farDistance = farPlane - originPoint;
+		nearLow = std::max(nearLow,
+			std::min(nearDistance * minInverse, nearDistance * maxInverse));
+		farHigh = std::min(farHigh,
+			std::max(farDistance * minInverse, farDistance * maxInverse));
+	}
+
+	*tNear = nearLow;
+	return nearLow <= (farHigh * BVHRay::FAR_T_SLACK);
+}
\ No newline at end of file
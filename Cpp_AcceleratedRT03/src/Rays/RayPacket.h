@@ -0,0 +1,46 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "../Math/Vector3.h"
+
+// A tile of rays sharing one origin, like the primary rays of a few neighboring
+// pixels. The packet keeps the range of its rays' inverse directions, so a box can
+// be tested against all of them at once with interval arithmetic. That only works
+// while every ray points the same way on each axis, so a packet whose rays don't is
+// marked as incoherent and should be traced one ray at a time. All of the rays
+// share one T interval, too.
+
+class RayPacket
+{
+public:
+	static const int TILE_WIDTH = 8;
+	static const int TILE_HEIGHT = 8;
+	static const int MAX_SIZE = RayPacket::TILE_WIDTH * RayPacket::TILE_HEIGHT;
+private:
+	Vector3 origin;
+	Vector3 directions[RayPacket::MAX_SIZE];
+	Vector3 minInverseDirection, maxInverseDirection;
+	double tMin, tMax;
+	bool negative[3];
+	int size;
+	bool coherent;
+public:
+	RayPacket(const Vector3 &origin, double tMin, double tMax);
+
+	const Vector3 &getOrigin() const;
+	const Vector3 &getDirection(int index) const;
+	double getTMin() const;
+	double getTMax() const;
+	class Ray getRay(int index) const;
+	int getSize() const;
+	bool isCoherent() const;
+	void addDirection(const Vector3 &direction);
+
+	// Returns false only if none of the rays can hit the box between the packet's
+	// min T and "tMax", and otherwise writes the earliest T at which any of them
+	// could enter it. This is only meaningful for a coherent packet.
+	bool intersects(const class BoundingBox &boundingBox, double tMax,
+		double *tNear) const;
+};
+
+#endif
\ No newline at end of file
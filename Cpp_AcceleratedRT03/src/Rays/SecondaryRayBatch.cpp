@@ -0,0 +1,119 @@
+#include <algorithm>
+
+#include "SecondaryRayBatch.h"
+#include "../Accelerators/BoundingBox.h"
+#include "../Intersections/Intersection.h"
+#include "../Worlds/World.h"
+
+SecondaryRayBatch::SecondaryRayBatch()
+{
+	this->rays = std::vector<Ray>();
+	this->occlusionRays = std::vector<bool>();
+	this->results = std::vector<double>();
+	this->sortKeys = std::vector<ullong>();
+}
+
+int SecondaryRayBatch::getSize() const
+{
+	return static_cast<int>(this->rays.size());
+}
+
+const Ray &SecondaryRayBatch::getRay(int index) const
+{
+	return this->rays[index];
+}
+
+void SecondaryRayBatch::clear()
+{
+	this->rays.clear();
+	this->occlusionRays.clear();
+	this->results.clear();
+	this->sortKeys.clear();
+}
+
+int SecondaryRayBatch::addNearestRay(const Ray &ray)
+{
+	this->rays.push_back(ray);
+	this->occlusionRays.push_back(false);
+	return static_cast<int>(this->rays.size()) - 1;
+}
+
+int SecondaryRayBatch::addOcclusionRay(const Ray &ray)
+{
+	this->rays.push_back(ray);
+	this->occlusionRays.push_back(true);
+	return static_cast<int>(this->rays.size()) - 1;
+}
+
+void SecondaryRayBatch::sortRays()
+{
+	const int count = static_cast<int>(this->rays.size());
+
+	BoundingBox originBox = BoundingBox();
+	for (const Ray &ray : this->rays)
+	{
+		originBox.expandToInclude(ray.getPoint());
+	}
+
+	// Scale the origins into the unit cube, keeping flat batches flat.
+	const Vector3 &extent = originBox.getExtent();
+	const double scales[] =
+	{
+		(extent.getX() > 0.0) ? (1.0 / extent.getX()) : 0.0,
+		(extent.getY() > 0.0) ? (1.0 / extent.getY()) : 0.0,
+		(extent.getZ() > 0.0) ? (1.0 / extent.getZ()) : 0.0
+	};
+
+	this->sortKeys.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		const Vector3 &point = this->rays[i].getPoint();
+		const Vector3 &direction = this->rays[i].getDirection();
+		const Vector3 offset = point - originBox.getMin();
+		const ullong octant =
+			((direction.getX() < 0.0) ? 1 : 0) |
+			((direction.getY() < 0.0) ? 2 : 0) |
+			((direction.getZ() < 0.0) ? 4 : 0);
+		const ullong morton = Utility::mortonCode(offset.getX() * scales[0],
+			offset.getY() * scales[1], offset.getZ() * scales[2]) >>
+			SecondaryRayBatch::MORTON_DROPPED_BITS;
+		const ullong key = (octant << SecondaryRayBatch::OCTANT_SHIFT) | morton;
+		this->sortKeys[i] = (key << SecondaryRayBatch::INDEX_BITS) | static_cast<ullong>(i);
+	}
+
+	std::sort(this->sortKeys.begin(), this->sortKeys.end());
+}
+
+void SecondaryRayBatch::trace(const World &world)
+{
+	const int count = static_cast<int>(this->rays.size());
+	this->results.resize(count);
+	this->sortRays();
+
+	const ullong indexMask = (1ULL << SecondaryRayBatch::INDEX_BITS) - 1;
+	for (const ullong sortKey : this->sortKeys)
+	{
+		const int index = static_cast<int>(sortKey & indexMask);
+		const Ray &ray = this->rays[index];
+
+		if (!this->occlusionRays[index])
+		{
+			this->results[index] = ray.nearestHit(world).getT();
+		}
+		else
+		{
+			this->results[index] = ((ray.getTMax() <= ray.getTMin()) ||
+				ray.occluded(world)) ? 1.0 : 0.0;
+		}
+	}
+}
+
+double SecondaryRayBatch::getHitT(int index) const
+{
+	return this->results[index];
+}
+
+bool SecondaryRayBatch::isOccluded(int index) const
+{
+	return this->results[index] != 0.0;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef SECONDARY_RAY_BATCH_H
+#define SECONDARY_RAY_BATCH_H
+
+#include <vector>
+
+#include "Ray.h"
+#include "../Utilities/Utility.h"
+
+// Collects the rays that shading needs, like shadow and ambient occlusion rays,
+// so they can all be traced at once instead of one at a time in between shading
+// work. Before tracing, the rays are sorted by the octant of their direction and
+// then by the Morton code of their origin, so rays traced one after another start
+// near each other and head the same way, and mostly reuse the same BVH nodes.
+// Results are kept in the order the rays were added.
+
+class SecondaryRayBatch
+{
+private:
+	std::vector<Ray> rays;
+
+	// Whether each ray only checks for occlusion, rather than finding its nearest hit.
+	std::vector<bool> occlusionRays;
+
+	// A nearest ray's hit T, or one for an occluded ray and zero for a clear one.
+	std::vector<double> results;
+	std::vector<ullong> sortKeys;
+
+	// The three octant bits go above the top 29 bits of the origin's Morton code,
+	// which fills the upper 32 bits of the sort key, and the ray's index goes in the
+	// low 32 bits.
+	static const int MORTON_DROPPED_BITS = 1;
+	static const int OCTANT_SHIFT = 29;
+	static const int INDEX_BITS = 32;
+
+	void sortRays();
+public:
+	SecondaryRayBatch();
+
+	int getSize() const;
+	const Ray &getRay(int index) const;
+
+	// Removes all rays, keeping the memory for the next batch.
+	void clear();
+
+	// Returns the index of the new ray. A nearest ray finds the closest shape or
+	// light. An occlusion ray only checks for shapes before its max T, and a ray
+	// with an empty interval counts as occluded.
+	int addNearestRay(const Ray &ray);
+	int addOcclusionRay(const Ray &ray);
+
+	void trace(const class World &world);
+
+	// Results of a traced batch.
+	double getHitT(int index) const;
+	bool isOccluded(int index) const;
+};
+
+#endif
\ No newline at end of file
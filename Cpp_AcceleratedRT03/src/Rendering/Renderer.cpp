@@ -6,6 +6,7 @@
 #include "../Intersections/Intersection.h"
 #include "../Math/Vector3.h"
 #include "../Rays/Ray.h"
+#include "../Rays/SecondaryRayBatch.h"
 #include "../Worlds/World.h"
 
 Renderer::Renderer(int width, int height, int pixelSize)
@@ -66,46 +67,76 @@ void Renderer::render(const World &world, const Camera &camera, uint *dst)
 {
 	const int renderWidth = this->getRenderWidth();
 	const int renderHeight = this->getRenderHeight();
-	const int area = renderWidth * renderHeight;
 
 	camera.calculateImageRays(this->imageDirections, renderWidth, renderHeight);
-	world.calculateIntersections(this->imageDirections, camera, this->intersections, area);
+	world.calculateIntersections(this->imageDirections, camera, this->intersections,
+		renderWidth, renderHeight);
 
 	const Vector3 eye = camera.getEye();
+	const int tileSize = Renderer::SHADING_TILE_SIZE;
+	const int tilesWide = (renderWidth + tileSize - 1) / tileSize;
+	const int tilesHigh = (renderHeight + tileSize - 1) / tileSize;
+	const int tileCount = tilesWide * tilesHigh;
 
-	if (this->pixelSize == 1)
+#pragma omp parallel
 	{
-#pragma omp parallel for
-		for (int i = 0; i < area; i++)
-		{
-			dst[i] = world.colorAt(Ray(eye, this->imageDirections[i], Ray::INITIAL_DEPTH), 
-				this->intersections[i]).clamp().toRGB();
-		}
-	}
-	else
-	{
-#pragma omp parallel for
-		for (int j = 0; j < renderHeight; j++)
+		// Each thread reuses one batch for all of its tiles.
+		SecondaryRayBatch batch = SecondaryRayBatch();
+		int firstRays[Renderer::SHADING_TILE_SIZE * Renderer::SHADING_TILE_SIZE];
+
+#pragma omp for schedule(dynamic)
+		for (int tile = 0; tile < tileCount; tile++)
 		{
-			for (int i = 0; i < renderWidth; i++)
+			const int startX = (tile % tilesWide) * tileSize;
+			const int startY = (tile / tilesWide) * tileSize;
+			const int endX = std::min(startX + tileSize, renderWidth);
+			const int endY = std::min(startY + tileSize, renderHeight);
+
+			// Gather the shading rays of every pixel in the tile first.
+			batch.clear();
+			int pixel = 0;
+			for (int y = startY; y < endY; y++)
 			{
-				int renderIndex = i + (j * renderWidth);
+				for (int x = startX; x < endX; x++, pixel++)
+				{
+					const int renderIndex = x + (y * renderWidth);
+					firstRays[pixel] = world.addSecondaryRays(
+						Ray(eye, this->imageDirections[renderIndex], Ray::INITIAL_DEPTH),
+						this->intersections[renderIndex], batch);
+				}
+			}
 
-				uint colorRGB = world.colorAt(
-					Ray(eye, this->imageDirections[renderIndex], Ray::INITIAL_DEPTH),
-					this->intersections[renderIndex]).clamp().toRGB();
+			// Then trace them all, and shade each pixel with its rays' results.
+			batch.trace(world);
 
-				for (int y = 0; y < this->pixelSize; y++)
+			pixel = 0;
+			for (int y = startY; y < endY; y++)
+			{
+				for (int x = startX; x < endX; x++, pixel++)
 				{
-					for (int x = 0; x < this->pixelSize; x++)
-					{
-						int index =
-							std::min((x + (i * this->pixelSize)), this->width - 1) +
-							std::min((y + (j * this->pixelSize)), this->height - 1) * this->width;
-						dst[index] = colorRGB;
-					}
+					const int renderIndex = x + (y * renderWidth);
+					uint colorRGB = world.colorAt(
+						Ray(eye, this->imageDirections[renderIndex], Ray::INITIAL_DEPTH),
+						this->intersections[renderIndex], batch, firstRays[pixel])
+						.clamp().toRGB();
+					this->writePixel(dst, x, y, colorRGB);
 				}
 			}
 		}
 	}
+}
+
+void Renderer::writePixel(uint *dst, int x, int y, uint colorRGB) const
+{
+	// Fill the block of screen pixels covered by the render pixel.
+	for (int j = 0; j < this->pixelSize; j++)
+	{
+		for (int i = 0; i < this->pixelSize; i++)
+		{
+			int index =
+				std::min((i + (x * this->pixelSize)), this->width - 1) +
+				std::min((j + (y * this->pixelSize)), this->height - 1) * this->width;
+			dst[index] = colorRGB;
+		}
+	}
 }
\ No newline at end of file
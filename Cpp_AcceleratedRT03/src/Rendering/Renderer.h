@@ -21,12 +21,18 @@ private:
 	static const int MIN_PIXEL_SIZE = 1;
 	static const int MAX_PIXEL_SIZE = 16;
 
-	int getRenderWidth() const;
-	int getRenderHeight() const;
+	// Pixels are shaded in square tiles, and the shadow and ambient occlusion rays of
+	// a whole tile are traced together.
+	static const int SHADING_TILE_SIZE = 32;
+
 	void rebuildBuffers();
+	void writePixel(uint *dst, int x, int y, uint colorRGB) const;
 public:
 	Renderer(int width, int height, int pixelSize);
 
+	// The screen size divided by the pixel size.
+	int getRenderWidth() const;
+	int getRenderHeight() const;
 	int getPixelSize() const;
 	void incrementPixelSize();
 	void decrementPixelSize();
@@ -4,6 +4,7 @@
 #include "../Materials/Material.h"
 #include "../Materials/Phong.h"
 #include "../Rays/Ray.h"
+#include "Primitive.h"
 
 Cuboid::Cuboid(const Vector3 &point)
 	: Cuboid(point, 0.5 + Utility::rand0To1(), 0.5 + Utility::rand0To1(),
@@ -11,7 +12,7 @@ Cuboid::Cuboid(const Vector3 &point)
 
 Cuboid::Cuboid(const Vector3 &point, double width, double height, double depth,
 	Material *material)
-	: Shape(), point(point)
+	: Shape(ShapeType::Cuboid), point(point)
 {
 	this->width = width;
 	this->height = height;
@@ -31,10 +32,8 @@ const Vector3 &Cuboid::getCentroid() const
 
 BoundingBox Cuboid::getBoundingBox() const
 {
-	Vector3 halfDiagonal = Vector3(
-		this->width * 0.5,
-		this->height * 0.5,
-		this->depth * 0.5);
+	// The width, height, and depth are half-extents, as in "Cuboid::hit".
+	Vector3 halfDiagonal = Vector3(this->width, this->height, this->depth);
 	Vector3 minPoint = this->getCentroid() - halfDiagonal;
 	Vector3 maxPoint = this->getCentroid() + halfDiagonal;
 	return BoundingBox(minPoint, maxPoint);
@@ -51,12 +50,25 @@ void Cuboid::moveTo(const Vector3 &point)
 }
 
 Intersection Cuboid::hit(const Ray &ray) const
+{
+	return Cuboid::hitCuboid(ray, this->getCentroid(), this->width, this->height,
+		this->depth, this);
+}
+
+Primitive Cuboid::getPrimitive() const
+{
+	return Primitive::cuboid(this, this->getCentroid(), this->width, this->height,
+		this->depth);
+}
+
+Intersection Cuboid::hitCuboid(const Ray &ray, const Vector3 &center, double width,
+	double height, double depth, const Shape *shape)
 {
 	double nMinX, nMinY, nMinZ, nMaxX, nMaxY, nMaxZ;
 	double tMin, tMax;
-	double tX1 = (-width + this->getCentroid().getX() - ray.getPoint().getX()) /
+	double tX1 = (-width + center.getX() - ray.getPoint().getX()) /
 		ray.getDirection().getX();
-	double tX2 = (width + this->getCentroid().getX() - ray.getPoint().getX()) /
+	double tX2 = (width + center.getX() - ray.getPoint().getX()) /
 		ray.getDirection().getX();
 
 	if (tX1 < tX2)
@@ -87,9 +99,9 @@ Intersection Cuboid::hit(const Ray &ray) const
 		return Intersection();
 	}
 
-	double tY1 = (-height + this->getCentroid().getY() - ray.getPoint().getY()) /
+	double tY1 = (-height + center.getY() - ray.getPoint().getY()) /
 		ray.getDirection().getY();
-	double tY2 = (height + this->getCentroid().getY() - ray.getPoint().getY()) /
+	double tY2 = (height + center.getY() - ray.getPoint().getY()) /
 		ray.getDirection().getY();
 
 	if (tY1 < tY2)
@@ -132,9 +144,9 @@ Intersection Cuboid::hit(const Ray &ray) const
 		return Intersection();
 	}
 
-	double tZ1 = (-depth + this->getCentroid().getZ() - ray.getPoint().getZ()) /
+	double tZ1 = (-depth + center.getZ() - ray.getPoint().getZ()) /
 		ray.getDirection().getZ();
-	double tZ2 = (depth + this->getCentroid().getZ() - ray.getPoint().getZ()) /
+	double tZ2 = (depth + center.getZ() - ray.getPoint().getZ()) /
 		ray.getDirection().getZ();
 
 	if (tZ1 < tZ2)
@@ -177,7 +189,8 @@ Intersection Cuboid::hit(const Ray &ray) const
 		return Intersection();
 	}
 
-	if (tMin < 0.0)
+	// Where the ray leaves, if it enters before its interval starts.
+	if (tMin < ray.getTMin())
 	{
 		tMin = tMax;
 		nMinX = nMaxX;
@@ -185,10 +198,10 @@ Intersection Cuboid::hit(const Ray &ray) const
 		nMinZ = nMaxZ;
 	}
 
-	if (tMin >= 0.0)
+	if (ray.contains(tMin))
 	{
 		return Intersection(tMin, ray.pointAt(tMin),
-			Vector3(nMinX, nMinY, nMinZ).normalized(), this);
+			Vector3(nMinX, nMinY, nMinZ).normalized(), shape);
 	}
 	else { return Intersection(); }
 }
\ No newline at end of file
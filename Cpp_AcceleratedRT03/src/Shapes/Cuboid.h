@@ -21,6 +21,11 @@ public:
 	virtual const class Material &getMaterial() const override;
 	virtual void moveTo(const Vector3 &point) override;
 	virtual class Intersection hit(const class Ray &ray) const override;
+	virtual class Primitive getPrimitive() const override;
+
+	// The cuboid intersection, given its geometry and the shape to report as hit.
+	static class Intersection hitCuboid(const class Ray &ray, const Vector3 &center,
+		double width, double height, double depth, const class Shape *shape);
 };
 
 #endif
\ No newline at end of file
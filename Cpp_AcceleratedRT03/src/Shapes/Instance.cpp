@@ -0,0 +1,86 @@
+#include "Instance.h"
+#include "ShapeGroup.h"
+#include "../Accelerators/Accelerator.h"
+#include "../Intersections/Intersection.h"
+#include "../Rays/Ray.h"
+
+Instance::Instance(const std::shared_ptr<const ShapeGroup> &group, const Matrix4 &transform)
+	: Shape(), group(group), transform(transform)
+{
+	this->updateTransform();
+}
+
+void Instance::updateTransform()
+{
+	this->inverseTransform = this->transform.affineInverse();
+	this->normalTransform = this->inverseTransform.transposed();
+
+	// Bound the transformed corners of the group's local box.
+	const BoundingBox &localBox = this->group->getBoundingBox();
+	const Vector3 &localMin = localBox.getMin();
+	const Vector3 &localMax = localBox.getMax();
+	this->boundingBox = BoundingBox();
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const Vector3 localCorner = Vector3(
+			((corner & 1) != 0) ? localMax.getX() : localMin.getX(),
+			((corner & 2) != 0) ? localMax.getY() : localMin.getY(),
+			((corner & 4) != 0) ? localMax.getZ() : localMin.getZ());
+		this->boundingBox.expandToInclude(this->transform.transformPoint(localCorner));
+	}
+
+	this->centroid = this->transform.transformPoint(localBox.getCentroid());
+}
+
+const Matrix4 &Instance::getTransform() const
+{
+	return this->transform;
+}
+
+const Vector3 &Instance::getCentroid() const
+{
+	return this->centroid;
+}
+
+BoundingBox Instance::getBoundingBox() const
+{
+	return this->boundingBox;
+}
+
+const Material &Instance::getMaterial() const
+{
+	return this->group->getShapes().front()->getMaterial();
+}
+
+void Instance::moveTo(const Vector3 &point)
+{
+	const Vector3 offset = point - this->centroid;
+	this->transform = Matrix4::translation(offset.getX(), offset.getY(), offset.getZ()) *
+		this->transform;
+	this->updateTransform();
+}
+
+Intersection Instance::hit(const Ray &ray) const
+{
+	// Shapes expect a unit direction, so the local direction is normalized, and
+	// T values are scaled by its length between the two spaces.
+	const Vector3 localDirection = this->inverseTransform.transformDirection(
+		ray.getDirection());
+	const double localLength = localDirection.length();
+	const double localTMax = (ray.getTMax() < Intersection::T_MAX) ?
+		(ray.getTMax() * localLength) : Intersection::T_MAX;
+	const Ray localRay = Ray(this->inverseTransform.transformPoint(ray.getPoint()),
+		localDirection.scaledBy(1.0 / localLength), ray.getDepth(),
+		ray.getTMin() * localLength, localTMax);
+
+	const Intersection localHit = this->group->getAccelerator().nearestHit(localRay);
+	if ((localHit.getShape() == nullptr) || (localHit.getT() >= Intersection::T_MAX))
+	{
+		return Intersection();
+	}
+
+	const double t = localHit.getT() / localLength;
+	const Vector3 normal = this->normalTransform.transformDirection(
+		localHit.getNormal()).normalized();
+	return Intersection(t, ray.pointAt(t), normal, localHit.getShape(), this);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <memory>
+
+#include "Shape.h"
+#include "../Accelerators/BoundingBox.h"
+#include "../Math/Matrix4.h"
+#include "../Math/Vector3.h"
+
+// A shape group placed in the world by an affine transform. Rays are moved into the
+// group's local space and traced through its bottom-level accelerator, so the world
+// accelerator only needs to know about the instance. A hit reports the group's shape
+// that was hit, so its material is used, with the point and normal in world space,
+// and reports the instance as the top-level shape.
+
+class Instance : public Shape
+{
+private:
+	std::shared_ptr<const class ShapeGroup> group;
+	Matrix4 transform, inverseTransform, normalTransform;
+	Vector3 centroid;
+	BoundingBox boundingBox;
+
+	// Updates everything derived from the transform.
+	void updateTransform();
+public:
+	Instance(const std::shared_ptr<const class ShapeGroup> &group, const Matrix4 &transform);
+
+	const Matrix4 &getTransform() const;
+	virtual const class Vector3 &getCentroid() const override;
+	virtual class BoundingBox getBoundingBox() const override;
+
+	// An instance has no single material, so this is the first shape's.
+	virtual const class Material &getMaterial() const override;
+
+	// Translates the instance so its centroid is at the given point.
+	virtual void moveTo(const Vector3 &point) override;
+	virtual class Intersection hit(const class Ray &ray) const override;
+};
+
+#endif
\ No newline at end of file
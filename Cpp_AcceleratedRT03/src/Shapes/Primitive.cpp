@@ -0,0 +1,59 @@
+#include "Cuboid.h"
+#include "Primitive.h"
+#include "Shape.h"
+#include "Sphere.h"
+#include "../Intersections/Intersection.h"
+
+Primitive::Primitive(PrimitiveType type, const Shape *shape, const Vector3 &center,
+	const Vector3 &sizes)
+	: center(center), sizes(sizes)
+{
+	this->shape = shape;
+	this->type = type;
+}
+
+Primitive::Primitive(const Shape *shape)
+	: Primitive(PrimitiveType::Shape, shape, Vector3(), Vector3()) { }
+
+Primitive::Primitive()
+	: Primitive(nullptr) { }
+
+Primitive Primitive::sphere(const Shape *shape, const Vector3 &center, double radius)
+{
+	const double radiusSquared = radius > 0.0 ? (radius * radius) : 0.0;
+	const double radiusRecip = radius > 0.0 ? (1.0 / radius) : 0.0;
+	return Primitive(PrimitiveType::Sphere, shape, center,
+		Vector3(radiusSquared, radiusRecip, 0.0));
+}
+
+Primitive Primitive::cuboid(const Shape *shape, const Vector3 &center, double width,
+	double height, double depth)
+{
+	return Primitive(PrimitiveType::Cuboid, shape, center,
+		Vector3(width, height, depth));
+}
+
+PrimitiveType Primitive::getType() const
+{
+	return this->type;
+}
+
+const Shape *Primitive::getShape() const
+{
+	return this->shape;
+}
+
+Intersection Primitive::hit(const Ray &ray) const
+{
+	switch (this->type)
+	{
+	case PrimitiveType::Sphere:
+		return Sphere::hitSphere(ray, this->center, this->sizes.getX(),
+			this->sizes.getY(), this->shape);
+	case PrimitiveType::Cuboid:
+		return Cuboid::hitCuboid(ray, this->center, this->sizes.getX(),
+			this->sizes.getY(), this->sizes.getZ(), this->shape);
+	default:
+		return this->shape->hit(ray);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef PRIMITIVE_H
+#define PRIMITIVE_H
+
+#include "../Math/Vector3.h"
+
+// A flat copy of a shape's geometry, so accelerators can keep their shapes packed
+// together in traversal order and intersect them without following pointers or
+// making virtual calls. Shapes with no flat form keep a pointer to themselves and
+// are intersected through their own "hit" instead.
+
+enum class PrimitiveType { Sphere, Cuboid, Shape };
+
+class Primitive
+{
+private:
+	// A sphere stores its squared and reciprocal radius in the first two sizes, and
+	// a cuboid stores its half-extents.
+	Vector3 center, sizes;
+	const class Shape *shape;
+	PrimitiveType type;
+
+	Primitive(PrimitiveType type, const class Shape *shape, const Vector3 &center,
+		const Vector3 &sizes);
+public:
+	// Intersected through the shape's own "hit".
+	Primitive(const class Shape *shape);
+
+	// An empty placeholder with no shape, to be assigned over.
+	Primitive();
+
+	static Primitive sphere(const class Shape *shape, const Vector3 &center,
+		double radius);
+	static Primitive cuboid(const class Shape *shape, const Vector3 &center,
+		double width, double height, double depth);
+
+	PrimitiveType getType() const;
+	const class Shape *getShape() const;
+
+	// Gives the same intersection as the shape's "hit", including the shape pointer.
+	class Intersection hit(const class Ray &ray) const;
+};
+
+#endif
\ No newline at end of file
@@ -1,11 +1,43 @@
+#include "Cuboid.h"
+#include "Primitive.h"
 #include "Shape.h"
+#include "Sphere.h"
+#include "../Lights/Light.h"
+
+Shape::Shape(ShapeType shapeType)
+{
+	this->shapeType = shapeType;
+}
 
 Shape::Shape()
+	: Shape(ShapeType::Other) { }
+
+Shape::~Shape()
 {
 
 }
 
-Shape::~Shape()
+Primitive Shape::getPrimitive() const
 {
+	return Primitive(this);
+}
 
+ShapeType Shape::getShapeType() const
+{
+	return this->shapeType;
+}
+
+const Material &Shape::findMaterial() const
+{
+	switch (this->shapeType)
+	{
+	case ShapeType::Sphere:
+		return static_cast<const Sphere*>(this)->Sphere::getMaterial();
+	case ShapeType::Cuboid:
+		return static_cast<const Cuboid*>(this)->Cuboid::getMaterial();
+	case ShapeType::Light:
+		return static_cast<const Light*>(this)->findMaterial();
+	default:
+		return this->getMaterial();
+	}
 }
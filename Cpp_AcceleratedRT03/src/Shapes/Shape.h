@@ -4,17 +4,43 @@
 // Shape is going to act as an interface this time. Derived shapes and lights
 // will be the the implementation.
 
+// The built-in kinds of shape, so hot code can call their methods directly instead
+// of through the vtable. Shapes made some other way are "Other", and always go
+// through their virtual methods. Lights and materials have tags of their own that
+// work the same way.
+//
+// A tag names the exact class whose methods get called, so an override in a
+// subclass would be skipped. The tagged lights and materials are final for that
+// reason. Sphere and Cuboid can't be, since the lights derive from them, but the
+// lights are reached through their Light base, which has its own tag. Any other
+// subclass of Sphere or Cuboid keeps its base's tag, so "findMaterial" ignores its
+// "getMaterial", and accelerators test the base's primitive from "getPrimitive"
+// instead of calling its "hit" unless it overrides "getPrimitive" too.
+enum class ShapeType { Sphere, Cuboid, Light, Other };
+
 class Shape
 {
+private:
+	ShapeType shapeType;
 public:
+	Shape(ShapeType shapeType);
 	Shape();
 	virtual ~Shape();
 
+	ShapeType getShapeType() const;
+
+	// Same as "getMaterial", but dispatched on the shape type.
+	const class Material &findMaterial() const;
+
 	virtual const class Vector3 &getCentroid() const = 0;
 	virtual class BoundingBox getBoundingBox() const = 0;
 	virtual const class Material &getMaterial() const = 0;
 	virtual void moveTo(const Vector3 &point) = 0;
 	virtual class Intersection hit(const class Ray &ray) const = 0;
+
+	// A flat copy of this shape for accelerators to store. By default it just
+	// refers back to this shape.
+	virtual class Primitive getPrimitive() const;
 };
 
 #endif
\ No newline at end of file
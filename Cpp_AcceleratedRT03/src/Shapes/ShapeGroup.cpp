@@ -0,0 +1,43 @@
+#include "Shape.h"
+#include "ShapeGroup.h"
+#include "../Accelerators/Accelerator.h"
+#include "../Accelerators/BVH.h"
+
+ShapeGroup::ShapeGroup(const std::vector<Shape*> &shapes)
+{
+	this->shapes = shapes;
+	this->boundingBox = BoundingBox();
+
+	for (const Shape *shape : this->shapes)
+	{
+		this->boundingBox.expandToInclude(shape->getBoundingBox());
+	}
+
+	// The group's shapes never change, so the accelerator is never refit, and it can
+	// afford the spatial split build.
+	this->accelerator = std::unique_ptr<Accelerator>(new BVH(this->shapes,
+		BVHBuildMethod::SpatialSAH, BVH::DEFAULT_BIN_COUNT, 1));
+}
+
+ShapeGroup::~ShapeGroup()
+{
+	for (Shape *shape : this->shapes)
+	{
+		delete shape;
+	}
+}
+
+const std::vector<Shape*> &ShapeGroup::getShapes() const
+{
+	return this->shapes;
+}
+
+const Accelerator &ShapeGroup::getAccelerator() const
+{
+	return *this->accelerator.get();
+}
+
+const BoundingBox &ShapeGroup::getBoundingBox() const
+{
+	return this->boundingBox;
+}
\ No newline at end of file
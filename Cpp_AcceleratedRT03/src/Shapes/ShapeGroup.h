@@ -0,0 +1,29 @@
+#ifndef SHAPE_GROUP_H
+#define SHAPE_GROUP_H
+
+#include <memory>
+#include <vector>
+
+#include "../Accelerators/BoundingBox.h"
+
+// A set of shapes in their own local space, with a bottom-level accelerator built
+// over them once. Instances place a group in the world with a transform, so any
+// number of copies share the group's shapes and its accelerator.
+
+class ShapeGroup
+{
+private:
+	std::vector<class Shape*> shapes;
+	std::unique_ptr<class Accelerator> accelerator;
+	BoundingBox boundingBox;
+public:
+	// The group takes ownership of the shapes.
+	ShapeGroup(const std::vector<class Shape*> &shapes);
+	~ShapeGroup();
+
+	const std::vector<class Shape*> &getShapes() const;
+	const class Accelerator &getAccelerator() const;
+	const BoundingBox &getBoundingBox() const;
+};
+
+#endif
\ No newline at end of file
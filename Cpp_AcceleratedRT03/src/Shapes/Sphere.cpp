@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Sphere.h"
 #include "../Accelerators/BoundingBox.h"
 #include "../Intersections/Intersection.h"
@@ -5,12 +7,13 @@
 #include "../Materials/Phong.h"
 #include "../Rays/Ray.h"
 #include "../Utilities/Utility.h"
+#include "Primitive.h"
 
 Sphere::Sphere(const Vector3 &point)
 	: Sphere(point, 0.5 + Utility::rand0To1(), new Phong(Phong::randomPhong())) { }
 
 Sphere::Sphere(const Vector3 &point, double radius, Material *material)
-	: Shape(), point(point)
+	: Shape(ShapeType::Sphere), point(point)
 {
 	this->radius = radius;
 	this->radiusRecip = radius > 0.0 ? (1.0 / radius) : 0.0;
@@ -58,9 +61,21 @@ void Sphere::moveTo(const Vector3 &point)
 
 Intersection Sphere::hit(const Ray &ray) const
 {
-	Vector3 op = this->point - ray.getPoint();
+	return Sphere::hitSphere(ray, this->getCentroid(), this->radiusSquared,
+		this->radiusRecip, this);
+}
+
+Primitive Sphere::getPrimitive() const
+{
+	return Primitive::sphere(this, this->getCentroid(), this->radius);
+}
+
+Intersection Sphere::hitSphere(const Ray &ray, const Vector3 &center,
+	double radiusSquared, double radiusRecip, const Shape *shape)
+{
+	Vector3 op = center - ray.getPoint();
 	double b = op.dot(ray.getDirection());
-	double determinant = (b * b) - op.dot(op) + this->radiusSquared;
+	double determinant = (b * b) - op.dot(op) + radiusSquared;
 
 	if (determinant < 0.0)
 	{
@@ -68,11 +83,17 @@ Intersection Sphere::hit(const Ray &ray) const
 	}
 	else
 	{
+		// The near root, unless it's before the ray's interval.
 		determinant = sqrt(determinant);
-		double t = ((b - determinant) > Utility::EPSILON) ? (b - determinant) :
-			(((b + determinant) > Utility::EPSILON) ? (b + determinant) : Intersection::T_MAX);
+		const double tMin = std::max(ray.getTMin(), Utility::EPSILON);
+		const double t = ((b - determinant) > tMin) ? (b - determinant) : (b + determinant);
+		if ((t <= tMin) || (t > ray.getTMax()))
+		{
+			return Intersection();
+		}
+
 		Vector3 point = ray.pointAt(t);
-		Vector3 normal = (point - this->getCentroid()).scaledBy(this->radiusRecip);
-		return Intersection(t, point, normal, this);
+		Vector3 normal = (point - center).scaledBy(radiusRecip);
+		return Intersection(t, point, normal, shape);
 	}
 }
\ No newline at end of file
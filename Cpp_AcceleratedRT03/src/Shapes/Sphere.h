@@ -23,6 +23,11 @@ public:
 	virtual const class Material &getMaterial() const override;
 	virtual void moveTo(const Vector3 &point) override;
 	virtual class Intersection hit(const class Ray &ray) const override;
+	virtual class Primitive getPrimitive() const override;
+
+	// The sphere intersection, given its geometry and the shape to report as hit.
+	static class Intersection hitSphere(const class Ray &ray, const Vector3 &center,
+		double radiusSquared, double radiusRecip, const class Shape *shape);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// A standard allocator that aligns its storage, for std::vectors of types that
+// should start on a cache line boundary. The default allocator only guarantees
+// the alignment of the fundamental types.
+
+template <typename T, size_t Alignment>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() { }
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) { }
+
+	T *allocate(size_t count)
+	{
+		if (count == 0)
+		{
+			return nullptr;
+		}
+
+#ifdef _WIN32
+		void *memory = _aligned_malloc(count * sizeof(T), Alignment);
+#else
+		void *memory = nullptr;
+		if (posix_memalign(&memory, Alignment, count * sizeof(T)) != 0)
+		{
+			memory = nullptr;
+		}
+#endif
+
+		if (memory == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T *memory, size_t)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		free(memory);
+#endif
+	}
+
+	template <typename U>
+	bool operator ==(const AlignedAllocator<U, Alignment>&) const
+	{
+		return true;
+	}
+
+	template <typename U>
+	bool operator !=(const AlignedAllocator<U, Alignment>&) const
+	{
+		return false;
+	}
+};
+
+#endif
\ No newline at end of file
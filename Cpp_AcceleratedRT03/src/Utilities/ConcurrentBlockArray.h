@@ -0,0 +1,82 @@
+#ifndef CONCURRENT_BLOCK_ARRAY_H
+#define CONCURRENT_BLOCK_ARRAY_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+// A fixed-length array whose storage is allocated one block at a time, the first
+// time an element in the block is asked for, so a huge array that's mostly unused
+// costs little. Blocks are published with a compare-and-swap, so any number of
+// threads can ask for elements at once without locking. A thread that loses the
+// race for a block frees its own copy and uses the winner's. Elements are default
+// constructed along with their block.
+
+template <typename T, int BlockSize>
+class ConcurrentBlockArray
+{
+private:
+	typedef std::vector<T, AlignedAllocator<T, 64>> Block;
+
+	std::vector<std::atomic<Block*>> blocks;
+public:
+	ConcurrentBlockArray(int count)
+		: blocks((count + BlockSize - 1) / BlockSize) { }
+
+	ConcurrentBlockArray(const ConcurrentBlockArray&) = delete;
+
+	~ConcurrentBlockArray()
+	{
+		for (std::atomic<Block*> &block : this->blocks)
+		{
+			delete block.load();
+		}
+	}
+
+	ConcurrentBlockArray &operator=(const ConcurrentBlockArray&) = delete;
+
+	// Gets an element for writing, allocating its block if it doesn't have one yet.
+	T &at(int index)
+	{
+		std::atomic<Block*> &slot = this->blocks[index / BlockSize];
+		Block *block = slot.load(std::memory_order_acquire);
+		if (block == nullptr)
+		{
+			Block *newBlock = new Block(BlockSize);
+			if (slot.compare_exchange_strong(block, newBlock, std::memory_order_acq_rel))
+			{
+				block = newBlock;
+			}
+			else
+			{
+				delete newBlock;
+			}
+		}
+
+		return (*block)[index % BlockSize];
+	}
+
+	// Gets an element whose block was already allocated, by this thread or by one
+	// whose writes this thread has since seen.
+	const T &operator[](int index) const
+	{
+		const Block *block =
+			this->blocks[index / BlockSize].load(std::memory_order_acquire);
+		return (*block)[index % BlockSize];
+	}
+
+	size_t getMemoryUsage() const
+	{
+		size_t bytes = this->blocks.capacity() * sizeof(std::atomic<Block*>);
+		for (const std::atomic<Block*> &block : this->blocks)
+		{
+			bytes += (block.load() != nullptr) ? (BlockSize * sizeof(T)) : 0;
+		}
+
+		return bytes;
+	}
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const std::string &filename)
+{
+	this->data = nullptr;
+	this->size = 0;
+	this->fileHandle = nullptr;
+	this->mappingHandle = nullptr;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	this->fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0))
+	{
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		return;
+	}
+
+	this->mappingHandle = mapping;
+
+	const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view != nullptr)
+	{
+		this->data = static_cast<const uchar*>(view);
+		this->size = static_cast<size_t>(fileSize.QuadPart);
+	}
+#else
+	const int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return;
+	}
+
+	// The mapping keeps the file alive on its own, so the descriptor can be closed
+	// right away.
+	struct stat fileStat;
+	if ((fstat(file, &fileStat) == 0) && (fileStat.st_size > 0))
+	{
+		void *view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ,
+			MAP_PRIVATE, file, 0);
+		if (view != MAP_FAILED)
+		{
+			this->data = static_cast<const uchar*>(view);
+			this->size = static_cast<size_t>(fileStat.st_size);
+		}
+	}
+
+	close(file);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (this->data != nullptr)
+	{
+		UnmapViewOfFile(this->data);
+	}
+
+	if (this->mappingHandle != nullptr)
+	{
+		CloseHandle(this->mappingHandle);
+	}
+
+	if (this->fileHandle != nullptr)
+	{
+		CloseHandle(this->fileHandle);
+	}
+#else
+	if (this->data != nullptr)
+	{
+		munmap(const_cast<uchar*>(this->data), this->size);
+	}
+#endif
+}
+
+bool MappedFile::isOpen() const
+{
+	return this->data != nullptr;
+}
+
+const uchar *MappedFile::getData() const
+{
+	return this->data;
+}
+
+size_t MappedFile::getSize() const
+{
+	return this->size;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#include "Utility.h"
+
+// A whole file mapped read-only into memory. Pages are only read from disk as
+// they're touched, so "opening" a large file costs next to nothing. The mapping
+// lasts as long as the object does.
+
+class MappedFile
+{
+private:
+	const uchar *data;
+	size_t size;
+
+	// The Windows file and mapping handles. POSIX only needs the mapping itself.
+	void *fileHandle, *mappingHandle;
+public:
+	MappedFile(const std::string &filename);
+	MappedFile(const MappedFile&) = delete;
+	~MappedFile();
+
+	MappedFile &operator=(const MappedFile&) = delete;
+
+	// False if the file couldn't be opened or mapped, or is empty.
+	bool isOpen() const;
+	const uchar *getData() const;
+	size_t getSize() const;
+};
+
+#endif
\ No newline at end of file
@@ -1,7 +1,12 @@
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <random>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "Utility.h"
 
 const double Utility::PI = 3.1415926535897932;
@@ -36,4 +41,53 @@ double Utility::rand0To1()
 double Utility::fastRand0To1()
 {
 	return static_cast<double>(xorshf96()) / static_cast<double>(0xFFFFFFFF);
+}
+
+uint Utility::expandBits(uint value)
+{
+	value = (value * 0x00010001u) & 0xFF0000FFu;
+	value = (value * 0x00000101u) & 0x0F00F00Fu;
+	value = (value * 0x00000011u) & 0xC30C30C3u;
+	value = (value * 0x00000005u) & 0x49249249u;
+	return value;
+}
+
+uint Utility::mortonCode(double x, double y, double z)
+{
+	const double scale = 1024.0;
+	const uint ix = static_cast<uint>(std::min(std::max(x * scale, 0.0), scale - 1.0));
+	const uint iy = static_cast<uint>(std::min(std::max(y * scale, 0.0), scale - 1.0));
+	const uint iz = static_cast<uint>(std::min(std::max(z * scale, 0.0), scale - 1.0));
+	return (Utility::expandBits(ix) << 2) | (Utility::expandBits(iy) << 1) |
+		Utility::expandBits(iz);
+}
+
+int Utility::countLeadingZeros(ullong value)
+{
+	if (value == 0)
+	{
+		return 64;
+	}
+
+	// The compilers' bit scans are one instruction, where a loop would branch on
+	// every bit it halves.
+#if defined(_M_X64)
+	unsigned long highestBit;
+	_BitScanReverse64(&highestBit, value);
+	return 63 - static_cast<int>(highestBit);
+#elif defined(_MSC_VER)
+	// 32-bit targets only have the 32-bit scan, so scan the high half first.
+	unsigned long highestBit;
+	const unsigned long high = static_cast<unsigned long>(value >> 32);
+	if (high != 0)
+	{
+		_BitScanReverse(&highestBit, high);
+		return 31 - static_cast<int>(highestBit);
+	}
+
+	_BitScanReverse(&highestBit, static_cast<unsigned long>(value));
+	return 63 - static_cast<int>(highestBit);
+#else
+	return __builtin_clzll(value);
+#endif
 }
\ No newline at end of file
@@ -14,6 +14,9 @@ enum class Axis { X = 0, Y = 1, Z = 2 };
 
 class Utility
 {
+private:
+	// Spreads the low 10 bits of a value out to every third bit.
+	static uint expandBits(uint value);
 public:
 	static const double PI;
 	static const double EPSILON;
@@ -24,6 +27,13 @@ public:
 
 	static double rand0To1();
 	static double fastRand0To1();
+
+	// Interleaves 10 bits of each coordinate, which are clamped to [0, 1], into a
+	// 30-bit code that orders points along a Z-order curve.
+	static uint mortonCode(double x, double y, double z);
+
+	// The number of zero bits above the highest set bit, or 64 for zero.
+	static int countLeadingZeros(ullong value);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <omp.h>
+
+#include "AcceleratorRebuild.h"
+#include "../Accelerators/BVH.h"
+#include "../Accelerators/BVHCache.h"
+#include "../Accelerators/WideBVH.h"
+#include "../Shapes/Shape.h"
+
+bool AcceleratorRebuild::CACHE_ALL_SCENES = false;
+
+AcceleratorRebuild::AcceleratorRebuild(const std::vector<Shape*> &shapes,
+	const std::vector<Shape*> &lightShapes, AcceleratorType acceleratorType,
+	bool dynamic, bool useCache)
+	: shapes(shapes), lightShapes(lightShapes)
+{
+	this->accelerator = nullptr;
+	this->lightAccelerator = nullptr;
+	this->done = false;
+	this->acceleratorType = acceleratorType;
+	this->dynamic = dynamic;
+	this->useCache = useCache;
+
+	// The thread starts last, once everything it reads is set.
+	this->thread = std::thread(&AcceleratorRebuild::build, this);
+}
+
+AcceleratorRebuild::~AcceleratorRebuild()
+{
+	if (this->thread.joinable())
+	{
+		this->thread.join();
+	}
+}
+
+void AcceleratorRebuild::build()
+{
+	// Frames keep rendering on every thread in the meantime, so one is left for them.
+	// This only limits the parallel loops started from this thread.
+	const int threadCount = std::max(1, omp_get_max_threads() - 1);
+	omp_set_num_threads(threadCount);
+
+	// Lights get their own BVH, since shadow rays must not be blocked by them.
+	this->lightAccelerator = std::unique_ptr<Accelerator>(new BVH(this->lightShapes));
+
+	const bool isBVH = (this->acceleratorType == AcceleratorType::BinaryBVH) ||
+		(this->acceleratorType == AcceleratorType::WideBVH);
+	if (!isBVH)
+	{
+		this->accelerator = std::unique_ptr<Accelerator>(
+			Accelerator::make(this->acceleratorType, this->shapes));
+		this->done = true;
+		return;
+	}
+
+	// Both BVH types start from a binary BVH, which big static scenes try to load
+	// from the cache first.
+	const bool cached = this->useCache && !this->dynamic &&
+		(AcceleratorRebuild::CACHE_ALL_SCENES ||
+		(static_cast<int>(this->shapes.size()) >= AcceleratorRebuild::MIN_CACHED_SHAPE_COUNT));
+	const ullong sceneHash = cached ? BVHCache::hashScene(this->shapes) : 0;
+	std::unique_ptr<BVH> binaryTree = nullptr;
+	if (cached)
+	{
+		binaryTree = BVHCache::load(this->shapes, sceneHash);
+	}
+
+	if (binaryTree == nullptr)
+	{
+		const BVHBuildMethod buildMethod = this->dynamic ?
+			BVHBuildMethod::Linear : BVH::DEFAULT_BUILD_METHOD;
+		binaryTree = std::unique_ptr<BVH>(new BVH(this->shapes, buildMethod,
+			BVH::DEFAULT_BIN_COUNT, threadCount));
+
+		if (cached)
+		{
+			BVHCache::save(*binaryTree, this->shapes, sceneHash);
+		}
+	}
+
+	if (this->acceleratorType == AcceleratorType::WideBVH)
+	{
+		this->accelerator = std::unique_ptr<Accelerator>(new WideBVH(std::move(binaryTree)));
+	}
+	else
+	{
+		this->accelerator = std::move(binaryTree);
+	}
+
+	// Everything written above is visible to whoever sees this.
+	this->done = true;
+}
+
+void AcceleratorRebuild::setCacheAllScenes(bool cacheAllScenes)
+{
+	AcceleratorRebuild::CACHE_ALL_SCENES = cacheAllScenes;
+}
+
+bool AcceleratorRebuild::isDone() const
+{
+	return this->done;
+}
+
+std::unique_ptr<Accelerator> AcceleratorRebuild::takeAccelerator()
+{
+	if (this->thread.joinable())
+	{
+		this->thread.join();
+	}
+
+	return std::move(this->accelerator);
+}
+
+std::unique_ptr<Accelerator> AcceleratorRebuild::takeLightAccelerator()
+{
+	if (this->thread.joinable())
+	{
+		this->thread.join();
+	}
+
+	return std::move(this->lightAccelerator);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef ACCELERATOR_REBUILD_H
+#define ACCELERATOR_REBUILD_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../Accelerators/Accelerator.h"
+
+// Builds a world's shape and light accelerators on a thread of its own, so frames
+// can keep rendering with the old ones in the meantime. The old accelerators stay
+// consistent on their own, since they trace copies of the shapes made when they
+// were built or last refit. The shapes themselves must not change until the
+// rebuild is done, because it reads them as it goes. The build uses one thread
+// fewer than OpenMP would, so it doesn't crowd out the frames being rendered.
+
+class AcceleratorRebuild
+{
+private:
+	const std::vector<class Shape*> &shapes, &lightShapes;
+	std::unique_ptr<class Accelerator> accelerator, lightAccelerator;
+	std::thread thread;
+	std::atomic<bool> done;
+	AcceleratorType acceleratorType;
+	bool dynamic, useCache;
+
+	// Scenes with at least this many shapes save their BVH to disk, and load it back
+	// instead of building it when the same scene is made again.
+	static const int MIN_CACHED_SHAPE_COUNT = 65536;
+
+	// Whether every static scene uses the cache regardless of its size, so the
+	// cache can be tried out on the built-in worlds.
+	static bool CACHE_ALL_SCENES;
+
+	void build();
+public:
+	// Starts building right away. Dynamic scenes use the linear BVH build, and
+	// never use the cache.
+	AcceleratorRebuild(const std::vector<class Shape*> &shapes,
+		const std::vector<class Shape*> &lightShapes, AcceleratorType acceleratorType,
+		bool dynamic, bool useCache);
+	AcceleratorRebuild(const AcceleratorRebuild&) = delete;
+	~AcceleratorRebuild();
+
+	AcceleratorRebuild &operator=(const AcceleratorRebuild&) = delete;
+
+	static void setCacheAllScenes(bool cacheAllScenes);
+
+	bool isDone() const;
+
+	// Waits for the build to finish, then hands over the new accelerators.
+	std::unique_ptr<class Accelerator> takeAccelerator();
+	std::unique_ptr<class Accelerator> takeLightAccelerator();
+};
+
+#endif
\ No newline at end of file
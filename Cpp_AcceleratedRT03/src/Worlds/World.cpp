@@ -1,21 +1,36 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+
 #include "World.h"
+#include "AcceleratorRebuild.h"
 #include "../Accelerators/Accelerator.h"
-#include "../Accelerators/BVH.h"
 #include "../Cameras/Camera.h"
 #include "../Intersections/Intersection.h"
 #include "../Lights/CuboidLight.h"
 #include "../Lights/Light.h"
 #include "../Lights/SphereLight.h"
 #include "../Materials/Material.h"
+#include "../Math/Matrix4.h"
 #include "../Math/Vector3.h"
 #include "../Rays/Ray.h"
+#include "../Rays/RayPacket.h"
+#include "../Rays/SecondaryRayBatch.h"
 #include "../Shapes/Cuboid.h"
+#include "../Shapes/Instance.h"
 #include "../Shapes/Shape.h"
+#include "../Shapes/ShapeGroup.h"
 #include "../Shapes/Sphere.h"
 #include "../Utilities/Utility.h"
 
 const double World::DEFAULT_FOG_DENSITY = 0.025;
 
+// Well under one step of an 8-bit color channel.
+const double World::FOG_CLIP_PERCENT = 1.0 / 1024.0;
+const double World::OPTIMIZE_SECONDS_PER_FRAME = 0.002;
+const AcceleratorType World::DEFAULT_ACCELERATOR_TYPE = AcceleratorType::BinaryBVH;
+
 World::World(const Vector3 &backgroundColor, double fogDensity)
 {
 	this->backgroundColor = backgroundColor;
@@ -23,12 +38,23 @@ World::World(const Vector3 &backgroundColor, double fogDensity)
 
 	this->shapes = std::vector<Shape*>();
 	this->lights = std::vector<Light*>();
+	this->lightShapes = std::vector<Shape*>();
 	this->accelerator = nullptr;
+	this->lightAccelerator = nullptr;
+	this->acceleratorType = World::DEFAULT_ACCELERATOR_TYPE;
 	this->grabbedShape = nullptr;
+	this->editDepth = 0;
+	this->acceleratorIsStale = false;
+	this->dynamic = false;
+	this->rebuild = nullptr;
+	this->pendingMoveShape = nullptr;
 }
 
 World::~World()
 {
+	// A rebuild still reading the shapes has to finish before they're deleted.
+	this->finishRebuild();
+
 	for (Shape *shape : this->shapes)
 	{
 		delete shape;
@@ -40,6 +66,7 @@ World::~World()
 	}
 
 	delete this->accelerator;
+	delete this->lightAccelerator;
 }
 
 World *World::makeWorld1()
@@ -48,6 +75,8 @@ World *World::makeWorld1()
 
 	double worldRadius = 12.0;
 
+	w->beginEdit();
+
 	const int SPHERE_COUNT = 10;
 	const int CUBOID_COUNT = 10;
 	for (int i = 0; i < SPHERE_COUNT; i++)
@@ -74,7 +103,71 @@ World *World::makeWorld1()
 			Vector3::randomPointInSphere(Vector3(), worldRadius)));
 	}
 
-	w->rebuildAccelerator();
+	w->commitEdit();
+
+	return w;
+}
+
+World *World::makeWorld2()
+{
+	World *w = new World(Vector3::randomColor(), World::DEFAULT_FOG_DENSITY);
+
+	double worldRadius = 40.0;
+	double groupRadius = 2.0;
+
+	// Each group is a small cluster of shapes around its own origin.
+	const int GROUP_COUNT = 3;
+	const int GROUP_SHAPE_COUNT = 8;
+	std::vector<std::shared_ptr<const ShapeGroup>> groups;
+	for (int i = 0; i < GROUP_COUNT; i++)
+	{
+		std::vector<Shape*> groupShapes;
+		for (int j = 0; j < GROUP_SHAPE_COUNT; j++)
+		{
+			Vector3 point = Vector3::randomPointInSphere(Vector3(), groupRadius);
+			if ((j % 2) == 0)
+			{
+				groupShapes.push_back(new Sphere(point));
+			}
+			else
+			{
+				groupShapes.push_back(new Cuboid(point));
+			}
+		}
+
+		groups.push_back(std::shared_ptr<const ShapeGroup>(new ShapeGroup(groupShapes)));
+	}
+
+	w->beginEdit();
+
+	// Place copies of the groups with random turns and sizes. They all share the
+	// groups' shapes and bottom-level accelerators.
+	const int INSTANCE_COUNT = 500;
+	for (int i = 0; i < INSTANCE_COUNT; i++)
+	{
+		Vector3 point = Vector3::randomPointInSphere(Vector3(), worldRadius);
+		double turn = 2.0 * Utility::PI * Utility::rand0To1();
+		double size = 0.5 + Utility::rand0To1();
+		Matrix4 transform = Matrix4::translation(point.getX(), point.getY(), point.getZ()) *
+			Matrix4::yRotation(turn) * Matrix4::scale(size, size, size);
+
+		w->addShape(new Instance(groups[i % GROUP_COUNT], transform));
+	}
+
+	const int SPHERE_LIGHT_COUNT = 2;
+	const int CUBOID_LIGHT_COUNT = 2;
+	for (int i = 0; i < SPHERE_LIGHT_COUNT; i++)
+	{
+		w->addLight(new SphereLight(
+			Vector3::randomPointInSphere(Vector3(), worldRadius)));
+	}
+	for (int i = 0; i < CUBOID_LIGHT_COUNT; i++)
+	{
+		w->addLight(new CuboidLight(
+			Vector3::randomPointInSphere(Vector3(), worldRadius)));
+	}
+
+	w->commitEdit();
 
 	return w;
 }
@@ -84,6 +177,18 @@ const Vector3 &World::getBackgroundColor() const
 	return this->backgroundColor;
 }
 
+double World::getFarClip() const
+{
+	// Fog keeps exp(-(distance * density)^2) of a shape's color, which drops to the
+	// clip percent at this distance. Without fog, nothing is clipped.
+	if (this->fogDensity <= 0.0)
+	{
+		return Intersection::T_MAX;
+	}
+
+	return std::sqrt(-std::log(World::FOG_CLIP_PERCENT)) / this->fogDensity;
+}
+
 const std::vector<Shape*> &World::getShapes() const
 {
 	return this->shapes;
@@ -99,16 +204,71 @@ const Accelerator *World::getAccelerator() const
 	return this->accelerator;
 }
 
+const Accelerator *World::getLightAccelerator() const
+{
+	return this->lightAccelerator;
+}
+
+AcceleratorType World::getAcceleratorType() const
+{
+	return this->acceleratorType;
+}
+
+void World::setAcceleratorType(AcceleratorType acceleratorType)
+{
+	if (acceleratorType != this->acceleratorType)
+	{
+		this->acceleratorType = acceleratorType;
+		this->startRebuild(true);
+	}
+}
+
+bool World::isDynamic() const
+{
+	return this->dynamic;
+}
+
+void World::setDynamic(bool dynamic)
+{
+	if (dynamic != this->dynamic)
+	{
+		this->dynamic = dynamic;
+		this->startRebuild(true);
+	}
+}
+
+void World::beginEdit()
+{
+	// The shape lists can't change under a rebuild that's reading them.
+	this->finishRebuild();
+	this->editDepth++;
+}
+
+void World::commitEdit()
+{
+	this->editDepth--;
+
+	if ((this->editDepth == 0) && this->acceleratorIsStale)
+	{
+		this->rebuildAccelerator(true);
+	}
+}
+
 void World::addShape(Shape *shape)
 {
+	this->beginEdit();
 	this->shapes.push_back(shape);
-	this->rebuildAccelerator();
+	this->acceleratorIsStale = true;
+	this->commitEdit();
 }
 
 void World::addLight(Light *light)
 {
+	this->beginEdit();
 	this->lights.push_back(light);
-	this->rebuildAccelerator();
+	this->lightShapes.push_back(light);
+	this->acceleratorIsStale = true;
+	this->commitEdit();
 }
 
 void World::randomizeBackground()
@@ -120,12 +280,15 @@ void World::grabShape(const Camera &camera)
 {
 	if (this->holdingShape()) { return; }
 
-	Intersection nearestHit =
-		Ray(camera.getEye(), camera.getForward(), Ray::INITIAL_DEPTH).nearestHit(*this);
+	const Ray ray = Ray(camera.getEye(), camera.getForward(), Ray::INITIAL_DEPTH, 0.0,
+		camera.getGrabDistance());
+	Intersection nearestHit = ray.nearestHit(*this);
 
 	if (nearestHit.getT() < camera.getGrabDistance())
 	{
-		this->grabbedShape = const_cast<Shape*>(nearestHit.getShape());
+		// A hit inside an instance reports a shape shared by every copy, so grab
+		// the instance that was hit instead.
+		this->grabbedShape = const_cast<Shape*>(nearestHit.getTopLevelShape());
 	}
 }
 
@@ -142,47 +305,185 @@ bool World::holdingShape() const
 	return this->grabbedShape != nullptr;
 }
 
+void World::update()
+{
+	if ((this->rebuild != nullptr) && this->rebuild->isDone())
+	{
+		this->finishRebuild();
+	}
+
+	// A move made during a rebuild waits for that rebuild, and any started after it.
+	if ((this->rebuild == nullptr) && (this->pendingMoveShape != nullptr))
+	{
+		Shape *shape = this->pendingMoveShape;
+		this->pendingMoveShape = nullptr;
+		this->moveShape(shape, this->pendingMovePoint);
+	}
+
+	// Repeated refits wear down the tree, so some of each frame goes to undoing it.
+	this->accelerator->optimize(World::OPTIMIZE_SECONDS_PER_FRAME);
+}
+
 void World::updateGrabbedShape(const Camera &camera)
 {
 	if (!this->holdingShape()) { return; }
 
-	this->grabbedShape->moveTo(camera.getEye() + camera.getForward().normalized()
-		.scaledBy(camera.getHoldDistance()));
-	this->rebuildAccelerator();
+	const Vector3 point = camera.getEye() + camera.getForward().normalized()
+		.scaledBy(camera.getHoldDistance());
+
+	// The shape stays put while a rebuild reads it. The latest move is kept, so the
+	// shape still ends up there if it's let go before the rebuild is done.
+	if (this->rebuild != nullptr)
+	{
+		this->pendingMoveShape = this->grabbedShape;
+		this->pendingMovePoint = point;
+		return;
+	}
+
+	this->moveShape(this->grabbedShape, point);
+}
+
+void World::moveShape(Shape *shape, const Vector3 &point)
+{
+	shape->moveTo(point);
+
+	// Only this shape moved, so the accelerators can usually just be refit. The
+	// shape is in one of them, and the other one ignores it.
+	const std::vector<const Shape*> movedShapes = { shape };
+	const bool shapesRefit = this->accelerator->refit(movedShapes);
+	const bool lightsRefit = this->lightAccelerator->refit(movedShapes);
+	if (!shapesRefit || !lightsRefit)
+	{
+		this->startRebuild(false);
+	}
+}
+
+void World::startRebuild(bool useCache)
+{
+	// Only one rebuild runs at a time, and a newer one replaces its result anyway.
+	this->finishRebuild();
+
+	this->acceleratorIsStale = false;
+	this->rebuild = std::unique_ptr<AcceleratorRebuild>(new AcceleratorRebuild(
+		this->shapes, this->lightShapes, this->acceleratorType, this->dynamic, useCache));
 }
 
-void World::rebuildAccelerator()
+void World::finishRebuild()
 {
-	if (this->accelerator != nullptr)
+	if (this->rebuild == nullptr)
 	{
-		delete this->accelerator;
+		return;
 	}
 
-	this->accelerator = new BVH(this->shapes);
+	// Swap the new accelerators in between frames, so no frame mixes old and new.
+	std::unique_ptr<Accelerator> newAccelerator = this->rebuild->takeAccelerator();
+	std::unique_ptr<Accelerator> newLightAccelerator = this->rebuild->takeLightAccelerator();
+	this->rebuild = nullptr;
+
+	delete this->accelerator;
+	delete this->lightAccelerator;
+	this->accelerator = newAccelerator.release();
+	this->lightAccelerator = newLightAccelerator.release();
+}
+
+void World::rebuildAccelerator(bool useCache)
+{
+	this->startRebuild(useCache);
+	this->finishRebuild();
 }
 
 void World::calculateIntersections(const std::vector<Vector3> &imageDirections,
 	const Camera &camera, std::vector<Intersection> &intersections,
-	int area) const
+	int width, int height) const
 {
 	const Vector3 eye = camera.getEye();
+	const double farClip = this->getFarClip();
+	const int tilesWide = (width + RayPacket::TILE_WIDTH - 1) / RayPacket::TILE_WIDTH;
+	const int tilesHigh = (height + RayPacket::TILE_HEIGHT - 1) / RayPacket::TILE_HEIGHT;
+	const int tileCount = tilesWide * tilesHigh;
 
-#pragma omp parallel for
-	for (int i = 0; i < area; i++)
+#pragma omp parallel for schedule(dynamic)
+	for (int tile = 0; tile < tileCount; tile++)
 	{
-		intersections[i] = Ray(eye, imageDirections[i], Ray::INITIAL_DEPTH).nearestHit(*this);
+		const int startX = (tile % tilesWide) * RayPacket::TILE_WIDTH;
+		const int startY = (tile / tilesWide) * RayPacket::TILE_HEIGHT;
+		const int endX = std::min(startX + RayPacket::TILE_WIDTH, width);
+		const int endY = std::min(startY + RayPacket::TILE_HEIGHT, height);
+
+		RayPacket packet = RayPacket(eye, 0.0, farClip);
+		for (int y = startY; y < endY; y++)
+		{
+			for (int x = startX; x < endX; x++)
+			{
+				packet.addDirection(imageDirections[x + (y * width)]);
+			}
+		}
+
+		Intersection shapeHits[RayPacket::MAX_SIZE];
+		Intersection lightHits[RayPacket::MAX_SIZE];
+		this->accelerator->nearestHits(packet, shapeHits);
+		this->lightAccelerator->nearestHits(packet, lightHits);
+
+		// Keep the closer of each ray's shape and light hits, like "Ray::nearestHit".
+		int packetIndex = 0;
+		for (int y = startY; y < endY; y++)
+		{
+			for (int x = startX; x < endX; x++)
+			{
+				const Intersection &shapeHit = shapeHits[packetIndex];
+				const Intersection &lightHit = lightHits[packetIndex];
+				intersections[x + (y * width)] =
+					(shapeHit.getT() < lightHit.getT()) ? shapeHit : lightHit;
+				packetIndex++;
+			}
+		}
 	}
 }
 
+bool World::occluded(const Ray &ray) const
+{
+	return this->accelerator->occluded(ray);
+}
+
+Vector3 World::applyFog(const Vector3 &color, double distance) const
+{
+	double percent =
+		(1.0 / std::exp((distance * this->fogDensity) * (distance * this->fogDensity)));
+	return color.scaledBy(percent) + this->backgroundColor.scaledBy(1.0 - percent);
+}
+
 Vector3 World::colorAt(const Ray &ray, const Intersection &intersection) const
 {
 	if (intersection.getT() < Intersection::T_MAX)
 	{
-		double distance = intersection.getT();
-		double percent =
-			(1.0 / std::exp((distance * this->fogDensity) * (distance * this->fogDensity)));
-		Vector3 color = intersection.getShape()->getMaterial().colorAt(intersection, ray, *this);
-		return color.scaledBy(percent) + this->backgroundColor.scaledBy(1.0 - percent);
+		Vector3 color = intersection.getShape()->findMaterial()
+			.findColorAt(intersection, ray, *this);
+		return this->applyFog(color, intersection.getT());
+	}
+	else { return this->backgroundColor; }
+}
+
+int World::addSecondaryRays(const Ray &ray, const Intersection &intersection,
+	SecondaryRayBatch &batch) const
+{
+	const int firstRay = batch.getSize();
+	if (intersection.getT() < Intersection::T_MAX)
+	{
+		intersection.getShape()->findMaterial()
+			.findSecondaryRays(intersection, ray, *this, batch);
+	}
+
+	return firstRay;
+}
+
+Vector3 World::colorAt(const Ray &ray, const Intersection &intersection,
+	const SecondaryRayBatch &batch, int firstRay) const
+{
+	if (intersection.getT() < Intersection::T_MAX)
+	{
+		Vector3 color = intersection.getShape()->findMaterial()
+			.findColorFromBatch(intersection, ray, *this, batch, firstRay);
+		return this->applyFog(color, intersection.getT());
 	}
 	else { return this->backgroundColor; }
 }
\ No newline at end of file
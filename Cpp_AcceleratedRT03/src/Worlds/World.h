@@ -1,46 +1,116 @@
 #ifndef WORLD_H
 #define WORLD_H
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "../Accelerators/Accelerator.h"
 #include "../Math/Vector3.h"
 
 class World
 {
 private:
-	class Accelerator *accelerator;
+	class Accelerator *accelerator, *lightAccelerator;
+	AcceleratorType acceleratorType;
 	std::vector<class Shape*> shapes;
 	std::vector<class Light*> lights;
+	std::vector<class Shape*> lightShapes;
 	class Shape *grabbedShape;
+
+	// The rebuild in progress, if any. Frames keep using the current accelerators
+	// until it's done. It reads the shapes as it goes, so a grabbed shape can't move
+	// in the meantime, and only its latest move is kept, to be made once it's done.
+	std::unique_ptr<class AcceleratorRebuild> rebuild;
+	class Shape *pendingMoveShape;
+	Vector3 pendingMovePoint;
 	Vector3 backgroundColor;
 	double fogDensity;
+	int editDepth;
+	bool acceleratorIsStale;
+
+	// Dynamic worlds expect their shapes to move a lot, so they rebuild their BVH
+	// with the fast linear build and don't cache it.
+	bool dynamic;
 
 	static const double DEFAULT_FOG_DENSITY;
+	static const double FOG_CLIP_PERCENT;
+	static const double OPTIMIZE_SECONDS_PER_FRAME;
+	static const AcceleratorType DEFAULT_ACCELERATOR_TYPE;
 
 	World(const Vector3 &backgroundColor, double fogDensity);
 
+	// Scene edits between "beginEdit" and "commitEdit" defer the accelerator rebuild
+	// until the outermost commit, so bulk loading only builds it once.
+	void beginEdit();
+	void commitEdit();
 	void addShape(class Shape *shape);
 	void addLight(class Light *light);
-	void rebuildAccelerator();
+	// Interactive edits skip the cache, since they'd only leave stale files behind.
+	void startRebuild(bool useCache);
+
+	// Waits for the rebuild in progress, if any, and swaps in its accelerators.
+	void finishRebuild();
+
+	// Builds new accelerators and waits for them, for when there aren't any yet.
+	void rebuildAccelerator(bool useCache);
+
+	// Moves a shape and refits the accelerators, or starts a rebuild if they've
+	// degraded too far. There must be no rebuild in progress.
+	void moveShape(class Shape *shape, const Vector3 &point);
+
+	// Blends a shape's color into the background by its distance.
+	Vector3 applyFog(const Vector3 &color, double distance) const;
 public:
 	~World();
 
 	static World *makeWorld1();
 
+	// Many transformed copies of a few small shape groups.
+	static World *makeWorld2();
+
 	const Vector3 &getBackgroundColor() const;
+
+	// How far primary rays are traced. Fog leaves too little of anything past it
+	// to show in the image.
+	double getFarClip() const;
 	const std::vector<class Shape*> &getShapes() const;
 	const std::vector<class Light*> &getLights() const;
 	const class Accelerator *getAccelerator() const;
+	const class Accelerator *getLightAccelerator() const;
+	AcceleratorType getAcceleratorType() const;
+	void setAcceleratorType(AcceleratorType acceleratorType);
+	bool isDynamic() const;
+	void setDynamic(bool dynamic);
 	void randomizeBackground();
+
+	// Swaps in the accelerators from a finished background rebuild, makes the move
+	// the grabbed shape was waiting on, and spends a little time optimizing the
+	// current accelerator after refits. Called once per frame, before anything moves.
+	void update();
 	void grabShape(const class Camera &camera);
 	void releaseShape();
 	bool holdingShape() const;
+
+	// Keeps the grabbed shape in front of the camera. While a rebuild is running, the
+	// shape stays put, and only moves to where the camera last put it once the
+	// rebuild is done.
 	void updateGrabbedShape(const class Camera &camera);
+	// Traces the image's rays in packets of neighboring pixels.
 	void calculateIntersections(const std::vector<Vector3> &imageRays,
 		const class Camera &camera, std::vector<class Intersection> &intersections,
-		int area) const;
+		int width, int height) const;
+	bool occluded(const class Ray &ray) const;
 	Vector3 colorAt(const class Ray &ray, const class Intersection &intersection) const;
+
+	// Shades in two steps, so the rays of many pixels can be traced together in
+	// between. The first adds the rays needed to shade the hit to the batch and
+	// returns the index of the first one, and the second shades it once the batch
+	// has been traced.
+	int addSecondaryRays(const class Ray &ray, const class Intersection &intersection,
+		class SecondaryRayBatch &batch) const;
+	Vector3 colorAt(const class Ray &ray, const class Intersection &intersection,
+		const class SecondaryRayBatch &batch, int firstRay) const;
 };
 
 #endif
\ No newline at end of file